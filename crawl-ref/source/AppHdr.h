@@ -321,6 +321,9 @@ static inline double pow(int x, double y) { return std::pow((double)x, y); }
     #define DEBUG_MONS_SCAN
 
     #define DEBUG_BONES
+
+    // Check cached LOS results against a fresh computation (slow).
+    #define DEBUG_LOS
 #endif
 
 // on by default (and has been for ~10 years)
@@ -403,6 +406,24 @@ static inline double pow(int x, double y) { return std::pow((double)x, y); }
 // Uncomment these if you can't find these functions on your system
 // #define NEED_USLEEP
 
+// Number of threads used to compute the LOS of all awake monsters at
+// the start of each turn; 1 computes it on the main thread.
+#ifndef LOS_THREADS
+#define LOS_THREADS 1
+#endif
+
+// Whether pregenerating the dungeon compresses each level it saves on
+// another thread, while it goes on to build the next ones.
+#ifndef PREGEN_COMPRESSION_THREADS
+#define PREGEN_COMPRESSION_THREADS 1
+#endif
+
+// Whether the Abyss samples the terrain of the area shifts the player could
+// set off next on another thread, while the game waits for input.
+#ifndef ABYSS_PREFETCH_THREADS
+#define ABYSS_PREFETCH_THREADS 1
+#endif
+
 #ifdef __cplusplus
 
 template < class T >
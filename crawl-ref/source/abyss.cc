@@ -50,6 +50,9 @@
 #include "stairs.h"
 #include "stringutil.h"
 #include "terrain.h"
+#if ABYSS_PREFETCH_THREADS
+# include "threads.h"
+#endif
 #include "rltiles/tiledef-dngn.h"
 #include "tileview.h"
 #include "timed-effects.h"
@@ -1118,36 +1121,256 @@ const static RiverLayout rivers(1800, baseLayout);
 // This one is not fixed: [0] is a level pulled from the current game
 static vector<const ProceduralLayout*> complex_vec(2);
 
+static void _init_abyss_layout()
+{
+    if (abyssLayout != nullptr)
+        return;
+
+    const level_id lid = _get_random_level();
+    levelLayout = new LevelLayout(lid, 5, rivers);
+    complex_vec[0] = levelLayout;
+    complex_vec[1] = &rivers; // const
+    abyssLayout = new WorleyLayout(23571113, complex_vec, 6.1);
+    if (is_existing_level(lid))
+    {
+        auto &vault_list =  you.vault_list[level_id::current()];
+        vault_list.push_back("base: " + lid.describe(false));
+    }
+}
+
 static ProceduralSample _abyss_grid(const coord_def &p)
 {
     const coord_def pt = p + abyssal_state.major_coord;
 
     if (_in_wastes(pt))
+        return wastes(pt, abyssal_state.depth);
+
+    _init_abyss_layout();
+
+    const ProceduralSample sample = (*abyssLayout)(pt, abyssal_state.depth);
+    ASSERT(sample.feat() > DNGN_UNSEEN);
+    return sample;
+}
+
+// Samples the layout at all of squares for the given major_coord and depth.
+// Only looks at layouts, which are never changed while they exist, so this
+// is safe to call off the main thread once _init_abyss_layout() has run.
+static vector<ProceduralSample> _abyss_samples(const vector<coord_def> &squares,
+                                               const coord_def &major_coord,
+                                               uint32_t depth)
+{
+    vector<coord_def> waste_pts, layout_pts;
+    for (const coord_def &p : squares)
     {
-        ProceduralSample sample = wastes(pt, abyssal_state.depth);
-        abyss_sample_queue.push(sample);
-        return sample;
+        const coord_def pt = p + major_coord;
+        (_in_wastes(pt) ? waste_pts : layout_pts).push_back(pt);
     }
 
-    if (abyssLayout == nullptr)
+    vector<ProceduralSample> waste_samples, layout_samples;
+    wastes.sample(waste_pts, depth, waste_samples);
+    if (!layout_pts.empty())
+        abyssLayout->sample(layout_pts, depth, layout_samples);
+
+    vector<ProceduralSample> samples;
+    samples.reserve(squares.size());
+    size_t next_waste = 0, next_layout = 0;
+    for (const coord_def &p : squares)
     {
-        const level_id lid = _get_random_level();
-        levelLayout = new LevelLayout(lid, 5, rivers);
-        complex_vec[0] = levelLayout;
-        complex_vec[1] = &rivers; // const
-        abyssLayout = new WorleyLayout(23571113, complex_vec, 6.1);
-        if (is_existing_level(lid))
+        if (_in_wastes(p + major_coord))
+            samples.push_back(waste_samples[next_waste++]);
+        else
         {
-            auto &vault_list =  you.vault_list[level_id::current()];
-            vault_list.push_back("base: " + lid.describe(false));
+            samples.push_back(layout_samples[next_layout++]);
+            ASSERT(samples.back().feat() > DNGN_UNSEEN);
         }
     }
+    return samples;
+}
 
-    const ProceduralSample sample = (*abyssLayout)(pt, abyssal_state.depth);
-    ASSERT(sample.feat() > DNGN_UNSEEN);
+#if ABYSS_PREFETCH_THREADS
+// Layout samples for the area shifts the player could set off with their
+// next step, worked out on another thread between turns. Each job samples
+// every square inside MAPGEN_BORDER for one possible major_coord, in
+// rectangle_iterator order. The samples only depend on the layouts, the
+// major_coord and the depth, so a job that matches the shift that happens
+// gives exactly what sampling at the time of the shift would.
+struct abyss_prefetch_job
+{
+    coord_def major_coord;
+    uint32_t depth;
+    vector<ProceduralSample> samples;
+    bool done;
+};
 
-    abyss_sample_queue.push(sample);
-    return sample;
+// How many rows a job samples between checks for being cancelled.
+static const int PREFETCH_ROWS = 8;
+
+static vector<abyss_prefetch_job> prefetch_jobs;
+static thread_t prefetch_thread;
+static bool prefetch_running = false;
+// Guards prefetch_cancel and prefetch_keep.
+static mutex_t prefetch_mutex;
+static bool prefetch_cancel = false;
+// The job to finish anyway when cancelled, or -1.
+static int prefetch_keep = -1;
+
+static void *_abyss_prefetch_worker(void *)
+{
+    vector<coord_def> rows;
+    for (size_t j = 0; j < prefetch_jobs.size(); ++j)
+    {
+        abyss_prefetch_job &job = prefetch_jobs[j];
+        for (int y = MAPGEN_BORDER; y < GYM - MAPGEN_BORDER;
+             y += PREFETCH_ROWS)
+        {
+            mutex_lock(prefetch_mutex);
+            const bool stop = prefetch_cancel && prefetch_keep != (int) j;
+            mutex_unlock(prefetch_mutex);
+            if (stop)
+                return nullptr;
+
+            rows.clear();
+            const int last = min(y + PREFETCH_ROWS, GYM - MAPGEN_BORDER);
+            for (int ry = y; ry < last; ++ry)
+                for (int x = MAPGEN_BORDER; x < GXM - MAPGEN_BORDER; ++x)
+                    rows.emplace_back(x, ry);
+
+            const vector<ProceduralSample> samples =
+                _abyss_samples(rows, job.major_coord, job.depth);
+            job.samples.insert(job.samples.end(), samples.begin(),
+                               samples.end());
+        }
+        job.done = true;
+    }
+    return nullptr;
+}
+
+// Stops the prefetch thread and drops its jobs. If one of them is for
+// major_coord and depth, the thread is allowed to finish that one, and its
+// samples are returned in samples.
+static bool _abyss_prefetch_stop(const coord_def &major_coord = coord_def(),
+                                 uint32_t depth = 0,
+                                 vector<ProceduralSample> *samples = nullptr)
+{
+    if (!prefetch_running)
+        return false;
+
+    int keep = -1;
+    if (samples)
+    {
+        for (size_t j = 0; j < prefetch_jobs.size(); ++j)
+        {
+            if (prefetch_jobs[j].major_coord == major_coord
+                && prefetch_jobs[j].depth == depth)
+            {
+                keep = j;
+            }
+        }
+    }
+
+    mutex_lock(prefetch_mutex);
+    prefetch_cancel = true;
+    prefetch_keep = keep;
+    mutex_unlock(prefetch_mutex);
+    thread_join(prefetch_thread);
+    prefetch_running = false;
+
+    const bool found = keep >= 0 && prefetch_jobs[keep].done;
+    if (found)
+        samples->swap(prefetch_jobs[keep].samples);
+    prefetch_jobs.clear();
+    return found;
+}
+
+// Starts sampling, on another thread, the areas that a shift would bring
+// in if the player stepped out of the shift margin next turn.
+static void _abyss_prefetch_shifts()
+{
+    _abyss_prefetch_stop();
+    if (!abyssLayout)
+        return;
+
+    const int margin = MAPGEN_BORDER + ABYSS_AREA_SHIFT_RADIUS + 1;
+    if (!map_bounds_with_margin(you.pos(), margin))
+        return;
+
+    for (adjacent_iterator ai(you.pos()); ai; ++ai)
+    {
+        if (in_bounds(*ai) && !map_bounds_with_margin(*ai, margin))
+        {
+            abyss_prefetch_job job;
+            job.major_coord = abyssal_state.major_coord + (*ai - ABYSS_CENTRE);
+            job.depth = abyssal_state.depth;
+            job.done = false;
+            prefetch_jobs.push_back(job);
+        }
+    }
+    if (prefetch_jobs.empty())
+        return;
+
+    static bool mutex_ready = false;
+    if (!mutex_ready)
+    {
+        mutex_init(prefetch_mutex);
+        mutex_ready = true;
+    }
+    prefetch_cancel = false;
+    prefetch_keep = -1;
+    prefetch_running = !thread_create_joinable(&prefetch_thread,
+                                               _abyss_prefetch_worker,
+                                               nullptr);
+    if (!prefetch_running)
+        prefetch_jobs.clear();
+}
+
+// Takes the samples for squares from a finished prefetch job, if there's
+// one for the current major_coord and depth.
+static bool _abyss_prefetched(const vector<coord_def> &squares,
+                              vector<ProceduralSample> &samples)
+{
+    vector<ProceduralSample> area;
+    if (!_abyss_prefetch_stop(abyssal_state.major_coord, abyssal_state.depth,
+                              &area))
+    {
+        return false;
+    }
+
+    const int width = GXM - 2 * MAPGEN_BORDER;
+    samples.reserve(squares.size());
+    for (const coord_def &p : squares)
+    {
+        if (p.x < MAPGEN_BORDER || p.x >= GXM - MAPGEN_BORDER
+            || p.y < MAPGEN_BORDER || p.y >= GYM - MAPGEN_BORDER)
+        {
+            samples.clear();
+            return false;
+        }
+        samples.push_back(area[(p.y - MAPGEN_BORDER) * width
+                               + p.x - MAPGEN_BORDER]);
+    }
+    return true;
+}
+#endif
+
+// Samples the layout at all of squares in one batch. Gives the same as
+// calling _abyss_grid() on each.
+static vector<ProceduralSample> _abyss_grid(const vector<coord_def> &squares)
+{
+#if ABYSS_PREFETCH_THREADS
+    vector<ProceduralSample> prefetched;
+    if (_abyss_prefetched(squares, prefetched))
+        return prefetched;
+#endif
+
+    for (const coord_def &p : squares)
+        if (!_in_wastes(p + abyssal_state.major_coord))
+        {
+            _init_abyss_layout();
+            break;
+        }
+
+    return _abyss_samples(squares, abyssal_state.major_coord,
+                          abyssal_state.depth);
 }
 
 static cloud_type _cloud_from_feat(const dungeon_feature_type &ft)
@@ -1198,41 +1421,54 @@ static dungeon_feature_type _veto_dangerous_terrain(dungeon_feature_type feat)
     return feat;
 }
 
-static void _update_abyss_terrain(const coord_def &p,
+// Will _update_abyss_terrain() resample the layout at this square?
+static bool _abyss_terrain_updates(const coord_def &rp,
     const map_bitmask &abyss_genlevel_mask, bool morph)
 {
-    const coord_def rp = p - abyssal_state.major_coord;
     // ignore dead coordinates
     if (!in_bounds(rp))
-        return;
+        return false;
 
     const dungeon_feature_type currfeat = grd(rp);
 
     // Don't decay vaults.
     if (map_masked(rp, MMT_VAULT))
-        return;
+        return false;
 
     switch (currfeat)
     {
         case DNGN_EXIT_ABYSS:
         case DNGN_ABYSSAL_STAIR:
-            return;
+            return false;
         default:
             break;
     }
 
     if (feat_is_altar(currfeat))
-        return;
+        return false;
 
     if (!abyss_genlevel_mask(rp))
-        return;
+        return false;
 
-    if (currfeat != DNGN_UNSEEN && !morph)
+    return currfeat == DNGN_UNSEEN || morph;
+}
+
+// If presampled is given, it's the layout sample for this square.
+static void _update_abyss_terrain(const coord_def &p,
+    const map_bitmask &abyss_genlevel_mask, bool morph,
+    const ProceduralSample *presampled = nullptr)
+{
+    const coord_def rp = p - abyssal_state.major_coord;
+    if (!_abyss_terrain_updates(rp, abyss_genlevel_mask, morph))
         return;
 
+    const dungeon_feature_type currfeat = grd(rp);
+
     // What should have been there previously?  It might not be because
     // of external changes such as digging.
-    const ProceduralSample sample = _abyss_grid(rp);
+    const ProceduralSample sample = presampled ? *presampled
+                                               : _abyss_grid(rp);
+    abyss_sample_queue.push(sample);
 
     // Enqueue the update, but don't morph.
     if (_abyssal_rune_at(rp))
@@ -1326,6 +1562,23 @@ static void _abyss_apply_terrain(const map_bitmask &abyss_genlevel_mask,
 */
     }
 
+    // Sample the layout in one batch for the squares this pass is sure to
+    // regenerate. The rest are left to chance, so are sampled as needed.
+    vector<coord_def> batch;
+    for (rectangle_iterator ri(MAPGEN_BORDER); ri; ++ri)
+    {
+        const bool turned_to_floor = map_masked(*ri, MMT_TURNED_TO_FLOOR);
+        if ((turned_to_floor ? now : !used_queue)
+            && _abyss_terrain_updates(*ri, abyss_genlevel_mask, morph))
+        {
+            batch.push_back(*ri);
+        }
+    }
+    const vector<ProceduralSample> batch_samples = _abyss_grid(batch);
+    FixedArray<int, GXM, GYM> batch_index(-1);
+    for (size_t i = 0; i < batch.size(); ++i)
+        batch_index(batch[i]) = i;
+
     int ii = 0;
     int delta = you.time_taken * (you.abyss_speed + 40) / 200;
     for (rectangle_iterator ri(MAPGEN_BORDER); ri; ++ri)
@@ -1340,7 +1593,10 @@ static void _abyss_apply_terrain(const map_bitmask &abyss_genlevel_mask,
             || !turned_to_floor && !used_queue)
         {
             ++ii;
-            _update_abyss_terrain(abyss_coord, abyss_genlevel_mask, morph);
+            _update_abyss_terrain(abyss_coord, abyss_genlevel_mask, morph,
+                                  batch_index(p) >= 0
+                                      ? &batch_samples[batch_index(p)]
+                                      : nullptr);
             env.level_map_mask(p) &= ~MMT_TURNED_TO_FLOOR;
         }
         if (morph)
@@ -1518,6 +1774,9 @@ static void abyss_area_shift()
 
 void destroy_abyss()
 {
+#if ABYSS_PREFETCH_THREADS
+    _abyss_prefetch_stop();
+#endif
     if (abyssLayout)
     {
         delete abyssLayout;
@@ -1694,6 +1953,9 @@ void abyss_morph()
     _push_items();
     // TODO: does gozag gold detection need to be here too?
     los_changed();
+#if ABYSS_PREFETCH_THREADS
+    _abyss_prefetch_shifts();
+#endif
 }
 
 // Force the player one level deeper in the abyss during an abyss teleport with
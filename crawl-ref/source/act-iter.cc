@@ -64,8 +64,11 @@ bool actor_near_iterator::valid(const actor* a) const
 void actor_near_iterator::advance()
 {
     do
-         if (++i >= MAX_MONSTERS)
+         if (++i >= env.mons_used)
+         {
+             i = MAX_MONSTERS;
              return;
+         }
     while (!valid(**this));
 }
 
@@ -154,18 +157,24 @@ bool monster_near_iterator::valid(const monster* a) const
 void monster_near_iterator::advance()
 {
     do
-         if (++i >= MAX_MONSTERS)
+         if (++i >= env.mons_used)
+         {
+             i = MAX_MONSTERS;
              return;
+         }
     while (!valid(**this));
 }
 
 //////////////////////////////////////////////////////////////////////////
 
+// Slots from env.mons_used on are all empty, so stop there.
 monster_iterator::monster_iterator()
     : i(0)
 {
-    while (i < MAX_MONSTERS && !menv[i].alive())
+    while (i < env.mons_used && !menv[i].alive())
         i++;
+    if (i >= env.mons_used)
+        i = MAX_MONSTERS;
 }
 
 monster_iterator::operator bool() const
@@ -188,9 +197,10 @@ monster* monster_iterator::operator->() const
 
 monster_iterator& monster_iterator::operator++()
 {
-    while (++i < MAX_MONSTERS)
+    while (++i < env.mons_used)
         if (menv[i].alive())
-            break;
+            return *this;
+    i = MAX_MONSTERS;
     return *this;
 }
 
@@ -204,7 +214,10 @@ monster_iterator monster_iterator::operator++(int)
 void monster_iterator::advance()
 {
     do
-         if (++i >= MAX_MONSTERS)
+         if (++i >= env.mons_used)
+         {
+             i = MAX_MONSTERS;
              return;
+         }
     while (!(*this)->alive());
 }
@@ -876,7 +876,7 @@ string actor::describe_props() const
  */
 bool actor::torpor_slowed() const
 {
-    if (!props.exists(TORPOR_SLOWED_KEY) || is_sanctuary(pos())
+    if (!props.exists(prop_key::torpor_slowed) || is_sanctuary(pos())
         || is_stationary()
         || stasis())
     {
@@ -66,6 +66,7 @@ LOCAL_SRC_FILES := $(SDL_PATH)/src/main/android/SDL_android_main.c \
     $(CRAWL_PATH)/dgn-irregular-box.cc \
     $(CRAWL_PATH)/dgn-layouts.cc \
     $(CRAWL_PATH)/dgn-overview.cc \
+    $(CRAWL_PATH)/dgn-profile.cc \
     $(CRAWL_PATH)/dgn-proclayouts.cc \
     $(CRAWL_PATH)/dgn-shoals.cc \
     $(CRAWL_PATH)/dgn-swamp.cc \
@@ -216,6 +217,7 @@ LOCAL_SRC_FILES := $(SDL_PATH)/src/main/android/SDL_android_main.c \
     $(CRAWL_PATH)/ray.cc \
     $(CRAWL_PATH)/rot.cc \
     $(CRAWL_PATH)/religion.cc \
+    $(CRAWL_PATH)/seed-survey.cc \
     $(CRAWL_PATH)/shopping.cc \
     $(CRAWL_PATH)/shout.cc \
     $(CRAWL_PATH)/show.cc \
@@ -260,6 +262,7 @@ LOCAL_SRC_FILES := $(SDL_PATH)/src/main/android/SDL_android_main.c \
     $(CRAWL_PATH)/transform.cc \
     $(CRAWL_PATH)/traps.cc \
     $(CRAWL_PATH)/travel.cc \
+    $(CRAWL_PATH)/travel-field.cc \
     $(CRAWL_PATH)/tutorial.cc \
     $(CRAWL_PATH)/uncancel.cc \
     $(CRAWL_PATH)/unicode.cc \
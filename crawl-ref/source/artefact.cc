@@ -977,10 +977,10 @@ void artefact_known_properties(const item_def &item,
                                artefact_known_props_t &known)
 {
     ASSERT(is_artefact(item));
-    if (!item.props.exists(KNOWN_PROPS_KEY)) // randbooks
+    if (!item.props.exists(prop_key::artefact_known_props)) // randbooks
         return;
 
-    const CrawlStoreValue &_val = item.props[KNOWN_PROPS_KEY];
+    const CrawlStoreValue &_val = item.props[prop_key::artefact_known_props];
     ASSERT(_val.get_type() == SV_VEC);
     const CrawlVector &known_vec = _val.get_vector();
     ASSERT(known_vec.get_type()     == SV_BOOL);
@@ -1003,12 +1003,13 @@ void artefact_properties(const item_def &item,
                          artefact_properties_t  &proprt)
 {
     ASSERT(is_artefact(item));
-    ASSERT(item.props.exists(ARTEFACT_PROPS_KEY) || is_unrandom_artefact(item));
+    ASSERT(item.props.exists(prop_key::artefact_props)
+           || is_unrandom_artefact(item));
 
-    if (item.props.exists(ARTEFACT_PROPS_KEY))
+    if (item.props.exists(prop_key::artefact_props))
     {
         const CrawlVector &rap_vec =
-            item.props[ARTEFACT_PROPS_KEY].get_vector();
+            item.props[prop_key::artefact_props].get_vector();
         ASSERT(rap_vec.get_type()     == SV_SHORT);
         ASSERT(rap_vec.size()         == ART_PROPERTIES);
         ASSERT(rap_vec.get_max_size() == ART_PROPERTIES);
@@ -1028,12 +1029,13 @@ void artefact_properties(const item_def &item,
 int artefact_property(const item_def &item, artefact_prop_type prop)
 {
     ASSERT(is_artefact(item));
-    ASSERT(item.props.exists(ARTEFACT_PROPS_KEY) || is_unrandom_artefact(item));
+    ASSERT(item.props.exists(prop_key::artefact_props)
+           || is_unrandom_artefact(item));
 
-    if (item.props.exists(ARTEFACT_PROPS_KEY))
+    if (item.props.exists(prop_key::artefact_props))
     {
         const CrawlVector &rap_vec =
-            item.props[ARTEFACT_PROPS_KEY].get_vector();
+            item.props[prop_key::artefact_props].get_vector();
         return rap_vec[prop].get_short();
     }
     else // if (is_unrandom_artefact(item))
@@ -1053,10 +1055,11 @@ bool artefact_property_known(const item_def &item, artefact_prop_type prop)
     if (item_ident(item, ISFLAG_KNOW_PROPERTIES))
         return true;
 
-    if (!item.props.exists(KNOWN_PROPS_KEY)) // randbooks
+    if (!item.props.exists(prop_key::artefact_known_props)) // randbooks
         return false;
 
-    const CrawlVector &known_vec = item.props[KNOWN_PROPS_KEY].get_vector();
+    const CrawlVector &known_vec =
+        item.props[prop_key::artefact_known_props].get_vector();
     ASSERT(known_vec.get_type()     == SV_BOOL);
     ASSERT(known_vec.size()         == ART_PROPERTIES);
 
@@ -1029,21 +1029,47 @@ void bolt::affect_cell()
         affect_ground();
 }
 
-static void _undo_tracer(bolt &orig, bolt &copy)
+// The fields a tracer may change and which fire() puts back afterwards.
+// Saving just these is much cheaper than copying the whole bolt.
+struct tracer_saved_fields
 {
     // FIXME: we should have a better idea of what gets changed!
-    orig.target           = copy.target;
-    orig.source           = copy.source;
-    orig.aimed_at_spot    = copy.aimed_at_spot;
-    orig.extra_range_used = copy.extra_range_used;
-    orig.auto_hit         = copy.auto_hit;
-    orig.ray              = copy.ray;
-    orig.colour           = copy.colour;
-    orig.flavour          = copy.flavour;
-    orig.real_flavour     = copy.real_flavour;
-    orig.bounces          = copy.bounces;
-    orig.bounce_pos       = copy.bounce_pos;
-}
+    coord_def target;
+    coord_def source;
+    bool aimed_at_spot;
+    int extra_range_used;
+    bool auto_hit;
+    ray_def ray;
+    colour_t colour;
+    beam_type flavour;
+    beam_type real_flavour;
+    int bounces;
+    coord_def bounce_pos;
+
+    tracer_saved_fields(const bolt &b)
+        : target(b.target), source(b.source), aimed_at_spot(b.aimed_at_spot),
+          extra_range_used(b.extra_range_used), auto_hit(b.auto_hit),
+          ray(b.ray), colour(b.colour), flavour(b.flavour),
+          real_flavour(b.real_flavour), bounces(b.bounces),
+          bounce_pos(b.bounce_pos)
+    {
+    }
+
+    void restore(bolt &b) const
+    {
+        b.target           = target;
+        b.source           = source;
+        b.aimed_at_spot    = aimed_at_spot;
+        b.extra_range_used = extra_range_used;
+        b.auto_hit         = auto_hit;
+        b.ray              = ray;
+        b.colour           = colour;
+        b.flavour          = flavour;
+        b.real_flavour     = real_flavour;
+        b.bounces          = bounces;
+        b.bounce_pos       = bounce_pos;
+    }
+};
 
 // This saves some important things before calling fire().
 void bolt::fire()
@@ -1055,19 +1081,18 @@ void bolt::fire()
 
     if (is_tracer)
     {
-        bolt boltcopy = *this;
-        if (special_explosion != nullptr)
-            boltcopy.special_explosion = new bolt(*special_explosion);
+        const tracer_saved_fields saved(*this);
+        bolt *const explosion = special_explosion;
+        unique_ptr<tracer_saved_fields> saved_explosion;
+        if (explosion != nullptr)
+            saved_explosion.reset(new tracer_saved_fields(*explosion));
 
         do_fire();
 
-        if (special_explosion != nullptr)
-        {
-            _undo_tracer(*special_explosion, *boltcopy.special_explosion);
-            delete boltcopy.special_explosion;
-        }
+        if (explosion != nullptr)
+            saved_explosion->restore(*explosion);
 
-        _undo_tracer(*this, boltcopy);
+        saved.restore(*this);
     }
     else
         do_fire();
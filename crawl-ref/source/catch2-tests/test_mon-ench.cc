@@ -0,0 +1,125 @@
+#include "catch.hpp"
+
+#include "AppHdr.h"
+
+#include <chrono>
+
+#include "mon-ench.h"
+
+// A spread of enchantments, deliberately out of order, and more of them
+// than fit inline.
+static const enchant_type test_enchs[] =
+{
+    ENCH_POISON, ENCH_SLOW, ENCH_HASTE, ENCH_CONFUSION, ENCH_INVIS,
+    ENCH_ABJ, ENCH_BERSERK, ENCH_FEAR, ENCH_CHARM, ENCH_STICKY_FLAME,
+};
+
+static bool _in_order(const mon_enchant_list &list)
+{
+    int last = -1;
+    for (const mon_enchant &me : list)
+    {
+        if (me.ench <= last)
+            return false;
+        last = me.ench;
+    }
+    return true;
+}
+
+TEST_CASE( "Monster enchantment lists stay sorted", "[single-file]" ) {
+    mon_enchant_list list;
+    REQUIRE(list.empty());
+
+    int n = 0;
+    for (enchant_type ench : test_enchs)
+    {
+        list.insert(mon_enchant(ench, 1, nullptr, 10 * ++n));
+        REQUIRE(list.size() == n);
+        REQUIRE(list.contains(ench));
+        REQUIRE(_in_order(list));
+    }
+
+    n = 0;
+    for (enchant_type ench : test_enchs)
+    {
+        const mon_enchant *me = list.find(ench);
+        REQUIRE(me);
+        REQUIRE(me->ench == ench);
+        REQUIRE(me->duration == 10 * ++n);
+    }
+    REQUIRE_FALSE(list.find(ENCH_PETRIFIED));
+
+    // Copies are independent, whether inline or not.
+    mon_enchant_list copy = list;
+    for (enchant_type ench : test_enchs)
+    {
+        REQUIRE(list.erase(ench));
+        REQUIRE_FALSE(list.contains(ench));
+        REQUIRE_FALSE(list.erase(ench));
+        REQUIRE(_in_order(list));
+        REQUIRE(copy.contains(ench));
+    }
+    REQUIRE(list.empty());
+    REQUIRE(copy.size() == (int) ARRAYSZ(test_enchs));
+
+    copy.clear();
+    REQUIRE(copy.empty());
+    REQUIRE(copy.begin() == copy.end());
+}
+
+// Not run by default: ./catch2-tests-executable "[bench]"
+TEST_CASE( "Monster enchantment lookup speed", "[.bench]" ) {
+    const int iters = 2000000;
+    const int held = 4;
+
+    map<enchant_type, mon_enchant> old_list;
+    mon_enchant_list new_list;
+    for (int i = 0; i < held; ++i)
+    {
+        old_list[test_enchs[i]] = mon_enchant(test_enchs[i], 1, nullptr, 10);
+        new_list.insert(mon_enchant(test_enchs[i], 1, nullptr, 10));
+    }
+
+    // Mostly misses, as with the has_ench() checks sprinkled through the
+    // movement and combat code, plus the get_ench() that follows a hit.
+    int found = 0;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < iters; ++i)
+    {
+        const auto ench = static_cast<enchant_type>(i % NUM_ENCHANTMENTS);
+        auto it = old_list.find(ench);
+        if (it != old_list.end())
+            found += it->second.duration;
+    }
+    auto mid = chrono::steady_clock::now();
+    for (int i = 0; i < iters; ++i)
+    {
+        const auto ench = static_cast<enchant_type>(i % NUM_ENCHANTMENTS);
+        if (new_list.contains(ench))
+            found -= new_list.find(ench)->duration;
+    }
+    auto mid2 = chrono::steady_clock::now();
+
+    // Copying, as the polymorph and transformation code does.
+    for (int i = 0; i < iters / 10; ++i)
+    {
+        map<enchant_type, mon_enchant> copy = old_list;
+        found += copy.size();
+    }
+    auto mid3 = chrono::steady_clock::now();
+    for (int i = 0; i < iters / 10; ++i)
+    {
+        mon_enchant_list copy = new_list;
+        found -= copy.size();
+    }
+    auto end = chrono::steady_clock::now();
+    REQUIRE(found == 0);
+
+    const auto ms = [](chrono::steady_clock::duration d) {
+        return chrono::duration<double, milli>(d).count();
+    };
+    WARN("lookups: " << ms(mid - start) << " ms map, "
+         << ms(mid2 - mid) << " ms list");
+    WARN("copies: " << ms(mid3 - mid2) << " ms map, "
+         << ms(end - mid3) << " ms list");
+}
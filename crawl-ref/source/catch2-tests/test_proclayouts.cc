@@ -0,0 +1,95 @@
+#include "catch.hpp"
+
+#include "AppHdr.h"
+
+#include <chrono>
+
+#include "coordit.h"
+#include "dgn-proclayouts.h"
+
+// The abyss's fixed layouts, nested as they are there.
+static const WastesLayout wastes;
+static const DiamondLayout diamond30(3,0);
+static const DiamondLayout diamond21(2,1);
+static const ColumnLayout column2(2);
+static const ColumnLayout column26(2,6);
+static const vector<const ProceduralLayout*> layout_vec =
+    { &diamond30, &diamond21, &column2, &column26 };
+static const WorleyLayout worleyL(123456, layout_vec);
+static const RoilingChaosLayout chaosA(8675309, 450);
+static const RoilingChaosLayout chaosB(7654321, 400);
+static const NewAbyssLayout newAbyssLayout(7629);
+static const vector<const ProceduralLayout*> mixed_vec =
+    { &chaosA, &worleyL, &chaosB, &newAbyssLayout };
+static const WorleyLayout layout(4321, mixed_vec);
+static const vector<const ProceduralLayout*> base_vec =
+    { &newAbyssLayout, &layout };
+static const WorleyLayout baseLayout(314159, base_vec, 5.0);
+static const RiverLayout rivers(1800, baseLayout);
+
+static const ProceduralLayout *const tested_layouts[] =
+    { &wastes, &worleyL, &chaosA, &newAbyssLayout, &layout, &rivers };
+
+// A level-sized patch of the abyss, somewhere well away from the origin.
+static vector<coord_def> _patch(const coord_def &corner)
+{
+    vector<coord_def> points;
+    for (rectangle_iterator ri(0); ri; ++ri)
+        points.push_back(corner + *ri);
+    return points;
+}
+
+TEST_CASE( "Batch layout samples match single samples", "[single-file]" ) {
+    const coord_def corners[] =
+        { coord_def(1000, 1000), coord_def(0x1234567, 0x7654321) };
+    const uint32_t offsets[] = { 0, 12345, 1000000 };
+
+    for (const ProceduralLayout *lay : tested_layouts)
+        for (const coord_def &corner : corners)
+            for (uint32_t offset : offsets)
+            {
+                const vector<coord_def> points = _patch(corner);
+                vector<ProceduralSample> batch;
+                lay->sample(points, offset, batch);
+                REQUIRE(batch.size() == points.size());
+
+                for (size_t i = 0; i < points.size(); ++i)
+                {
+                    const ProceduralSample single = (*lay)(points[i], offset);
+                    CAPTURE(points[i].x, points[i].y, offset);
+                    REQUIRE(batch[i].coord() == single.coord());
+                    REQUIRE(batch[i].feat() == single.feat());
+                    REQUIRE(batch[i].changepoint() == single.changepoint());
+                }
+            }
+}
+
+// Not run by default: ./catch2-tests-executable "[bench]"
+TEST_CASE( "Batch layout sampling speed", "[.bench]" ) {
+    const int iters = 20;
+    const vector<coord_def> points = _patch(coord_def(0x1234567, 0x7654321));
+
+    for (size_t l = 0; l < ARRAYSZ(tested_layouts); ++l)
+    {
+        const ProceduralLayout *lay = tested_layouts[l];
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < iters; ++i)
+            for (const coord_def &p : points)
+                (*lay)(p, i * 100);
+        auto mid = chrono::steady_clock::now();
+        for (int i = 0; i < iters; ++i)
+        {
+            vector<ProceduralSample> batch;
+            lay->sample(points, i * 100, batch);
+        }
+        auto end = chrono::steady_clock::now();
+
+        const double single_ms =
+            chrono::duration<double, milli>(mid - start).count() / iters;
+        const double batch_ms =
+            chrono::duration<double, milli>(end - mid).count() / iters;
+        WARN("layout " << l << ": "
+             << single_ms << " ms/level single, "
+             << batch_ms << " ms/level batched");
+    }
+}
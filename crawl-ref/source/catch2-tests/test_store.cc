@@ -0,0 +1,41 @@
+#include "catch.hpp"
+
+#include "AppHdr.h"
+
+#include "artefact.h"
+#include "store.h"
+
+TEST_CASE( "Interned property keys follow string-keyed changes",
+           "[single-file]" ) {
+    CrawlHashTable props;
+    REQUIRE_FALSE(props.exists(prop_key::artefact_props));
+
+    props[ARTEFACT_PROPS_KEY] = 3;
+    props["unrelated"] = true;
+    REQUIRE(props.exists(prop_key::artefact_props));
+    REQUIRE_FALSE(props.exists(prop_key::artefact_known_props));
+    REQUIRE(props[prop_key::artefact_props].get_int() == 3);
+
+    props[prop_key::artefact_known_props] = 4;
+    REQUIRE(props.exists(KNOWN_PROPS_KEY));
+    REQUIRE(props[KNOWN_PROPS_KEY].get_int() == 4);
+
+    // Copies and swaps carry the interned keys along.
+    CrawlHashTable copy = props;
+    CrawlHashTable other;
+    other.swap(copy);
+    REQUIRE(copy.empty());
+    REQUIRE_FALSE(copy.exists(prop_key::artefact_props));
+    REQUIRE(other.exists(prop_key::artefact_props));
+
+    props.erase(ARTEFACT_PROPS_KEY);
+    REQUIRE_FALSE(props.exists(prop_key::artefact_props));
+    REQUIRE(props.exists(prop_key::artefact_known_props));
+
+    props.erase(props.find(KNOWN_PROPS_KEY));
+    REQUIRE_FALSE(props.exists(prop_key::artefact_known_props));
+    REQUIRE(props.exists("unrelated"));
+
+    other.clear();
+    REQUIRE_FALSE(other.exists(prop_key::artefact_props));
+}
@@ -0,0 +1,159 @@
+#include "catch.hpp"
+
+#include "AppHdr.h"
+
+#include <memory>
+
+#include "coord.h"
+#include "coordit.h"
+#include "random.h"
+#include "travel-field.h"
+
+// The grids of a made-up level, which the fields are built from.
+struct test_grid
+{
+    bool passable;
+    int cost;
+    int source;
+};
+
+static void _build(travel_field &field,
+                   const FixedArray<test_grid, GXM, GYM> &grids,
+                   const vector<pair<coord_def, coord_def>> &links)
+{
+    for (rectangle_iterator ri(0); ri; ++ri)
+    {
+        const test_grid &g = grids(*ri);
+        field.set_grid(*ri, g.passable, g.cost, g.source);
+    }
+    field.set_links(links);
+    field.repair();
+}
+
+TEST_CASE( "travel_field finds the cheapest walk to a source",
+           "[single-file]" ) {
+    unique_ptr<travel_field> field(new travel_field);
+
+    // A corridor along y = 10 with a door at x = 12 and a source at x = 15.
+    for (int x = 5; x <= 15; ++x)
+        field->set_grid(coord_def(x, 10), true, x == 12 ? 2 : 1);
+    field->set_grid(coord_def(15, 10), true, 1, 0);
+    field->repair();
+
+    REQUIRE( field->distance(coord_def(15, 10)) == 0 );
+    REQUIRE( field->distance(coord_def(14, 10)) == 1 );
+    REQUIRE( field->distance(coord_def(11, 10)) == 5 );
+    REQUIRE( field->distance(coord_def(5, 10)) == 11 );
+    REQUIRE( field->distance(coord_def(5, 11)) == INFINITE_DISTANCE );
+    REQUIRE( field->next(coord_def(15, 10)) == coord_def(15, 10) );
+    REQUIRE( field->next(coord_def(11, 10)) == coord_def(12, 10) );
+    REQUIRE( field->next(coord_def(5, 11)).origin() );
+
+    // Opening a way round the door only touches the grids it improves.
+    field->set_grid(coord_def(12, 11), true, 1);
+    field->repair();
+    REQUIRE( field->distance(coord_def(11, 10)) == 4 );
+    REQUIRE( field->next(coord_def(11, 10)) == coord_def(12, 11) );
+    REQUIRE( field->repaired() < 10 );
+
+    // A nearer source, then a link past the corridor.
+    field->set_grid(coord_def(5, 10), true, 1, 3);
+    field->repair();
+    REQUIRE( field->distance(coord_def(6, 10)) == 4 );
+    REQUIRE( field->next(coord_def(5, 10)) == coord_def(5, 10) );
+
+    field->set_grid(coord_def(30, 30), true, 1);
+    field->set_links({ { coord_def(30, 30), coord_def(14, 10) } });
+    field->repair();
+    REQUIRE( field->distance(coord_def(30, 30)) == 2 );
+    REQUIRE( field->next(coord_def(30, 30)) == coord_def(14, 10) );
+
+    field->set_links({});
+    field->repair();
+    REQUIRE( field->distance(coord_def(30, 30)) == INFINITE_DISTANCE );
+}
+
+TEST_CASE( "travel_field repairs agree with building from scratch",
+           "[single-file]" ) {
+    rng::subgenerator subgen(0x5eed, 0x7a5e1);
+
+    FixedArray<test_grid, GXM, GYM> grids;
+    for (rectangle_iterator ri(0); ri; ++ri)
+    {
+        test_grid &g = grids(*ri);
+        g.passable = x_chance_in_y(3, 4);
+        g.cost = one_chance_in(8) ? 2 + random2(2) : 1;
+        g.source = one_chance_in(150) ? random2(12) : INFINITE_DISTANCE;
+    }
+    vector<pair<coord_def, coord_def>> links;
+
+    unique_ptr<travel_field> kept(new travel_field);
+    _build(*kept, grids, links);
+
+    for (int round = 0; round < 40; ++round)
+    {
+        // Mostly small changes in one place, as when the player looks
+        // around; sometimes a change anywhere.
+        const coord_def centre(random_range(X_BOUND_1, X_BOUND_2),
+                               random_range(Y_BOUND_1, Y_BOUND_2));
+        const int changes = one_chance_in(5) ? 200 : 1 + random2(30);
+        for (int i = 0; i < changes; ++i)
+        {
+            coord_def c = centre + coord_def(random_range(-8, 8),
+                                             random_range(-8, 8));
+            if (one_chance_in(10))
+            {
+                c = coord_def(random_range(X_BOUND_1, X_BOUND_2),
+                              random_range(Y_BOUND_1, Y_BOUND_2));
+            }
+            if (!map_bounds(c))
+                continue;
+
+            test_grid &g = grids(c);
+            switch (random2(3))
+            {
+            case 0:
+                g.passable = !g.passable;
+                break;
+            case 1:
+                g.cost = 1 + random2(3);
+                break;
+            default:
+                g.source = coinflip() ? random2(12) : INFINITE_DISTANCE;
+                break;
+            }
+            kept->set_grid(c, g.passable, g.cost, g.source);
+        }
+
+        if (one_chance_in(4))
+        {
+            links.emplace_back(coord_def(random_range(1, 30),
+                                         random_range(1, 30)),
+                               coord_def(random_range(40, 70),
+                                         random_range(20, 60)));
+            if (links.size() > 3)
+                links.erase(links.begin());
+            kept->set_links(links);
+        }
+        kept->repair();
+
+        unique_ptr<travel_field> fresh(new travel_field);
+        _build(*fresh, grids, links);
+
+        for (rectangle_iterator ri(0); ri; ++ri)
+        {
+            const coord_def c = *ri;
+            const int d = kept->distance(c);
+            REQUIRE( d == fresh->distance(c) );
+
+            // The kept walks must still be walks of that length.
+            const coord_def next = kept->next(c);
+            if (d == INFINITE_DISTANCE)
+                REQUIRE( next.origin() );
+            else if (next == c)
+                REQUIRE( grids(c).source == d );
+            else
+                REQUIRE( kept->distance(next) + grids(next).cost == d );
+        }
+    }
+}
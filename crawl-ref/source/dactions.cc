@@ -23,6 +23,7 @@
 #include "mon-transit.h"
 #include "religion.h"
 #include "state.h"
+#include "terrain.h"
 #include "view.h"
 
 static void _daction_hog_to_human(monster *mon, bool in_transit);
@@ -307,7 +308,10 @@ static void _apply_daction(daction_type act)
         for (rectangle_iterator ri(1); ri; ++ri)
         {
             if (grd(*ri) == DNGN_ALTAR_JIYVA)
+            {
                 grd(*ri) = DNGN_FLOOR;
+                set_terrain_changed(*ri);
+            }
         }
         break;
     case DACT_ROT_CORPSES:
@@ -330,6 +334,7 @@ static void _apply_daction(daction_type act)
             {
                 // TODO: clear shop data out?
                 grd(feat->pos) = DNGN_ABANDONED_SHOP;
+                set_terrain_changed(feat->pos);
                 view_update_at(feat->pos);
                 env.markers.remove(feat);
             }
@@ -401,7 +406,6 @@ static void _daction_hog_to_human(monster *mon, bool in_transit)
         mon->flags & ~(MF_JUST_SUMMONED | MF_WAS_IN_VIEW);
     // Preserve enchantments.
     mon_enchant_list enchantments = mon->enchantments;
-    FixedBitVector<NUM_ENCHANTMENTS> ench_cache = mon->ench_cache;
 
     // Restore original monster.
     *mon = orig;
@@ -417,7 +421,6 @@ static void _daction_hog_to_human(monster *mon, bool in_transit)
     // "else {mon->position = pos}" is unnecessary because the transit code will
     // ignore the old position anyway.
     mon->enchantments = enchantments;
-    mon->ench_cache = ench_cache;
     mon->hit_points   = max(1, (int) (mon->max_hit_points * hp));
     mon->flags        = mon->flags | preserve_flags;
 
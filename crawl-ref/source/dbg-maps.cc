@@ -7,10 +7,17 @@
 
 #include "dbg-maps.h"
 
+#ifndef TARGET_OS_WINDOWS
+# include <cerrno>
+# include <sys/wait.h>
+# include <unistd.h>
+#endif
+
 #include "branch.h"
 #include "chardump.h"
 #include "crash.h"
 #include "dbg-objstat.h"
+#include "dgn-profile.h"
 #include "dungeon.h"
 #include "env.h"
 #include "initfile.h"
@@ -22,6 +29,8 @@
 #include "shopping.h"
 #include "state.h"
 #include "stringutil.h"
+#include "syscalls.h"
+#include "tags.h"
 #include "view.h"
 
 #ifdef DEBUG_STATISTICS
@@ -229,12 +238,259 @@ static bool _build_dungeon()
     return true;
 }
 
+// Build one iteration, seeded by its number so jobs give the same results.
+static bool _build_iteration(int i)
+{
+    rng::seed(crawl_state.seed + i);
+    dlua.callfn("dgn_clear_data", "");
+    you.uniq_map_tags.clear();
+    you.uniq_map_names.clear();
+    you.uniq_map_tags_abyss.clear();
+    you.uniq_map_names_abyss.clear();
+    you.unique_creatures.reset();
+    initialise_branch_depths();
+    init_level_connectivity();
+    if (!_build_dungeon())
+        return false;
+    if (crawl_state.obj_stat_gen)
+        objstat_iteration_stats();
+    return true;
+}
+
+#ifndef TARGET_OS_WINDOWS
+static void _save_counts(writer &outf, const map<string, int> &counts)
+{
+    marshallInt(outf, counts.size());
+    for (const auto &entry : counts)
+    {
+        marshallString(outf, entry.first);
+        marshallInt(outf, entry.second);
+    }
+}
+
+static void _merge_counts(reader &inf, map<string, int> &counts)
+{
+    for (int i = unmarshallInt(inf); i > 0; --i)
+    {
+        const string name = unmarshallString(inf);
+        counts[name] += unmarshallInt(inf);
+    }
+}
+
+static void _save_job_stats(writer &outf)
+{
+    marshallInt(outf, levels_tried);
+    marshallInt(outf, levels_failed);
+    marshallInt(outf, build_attempts);
+    marshallInt(outf, level_vetoes);
+    marshallString(outf, last_error);
+
+    _save_counts(outf, try_count);
+    _save_counts(outf, use_count);
+    _save_counts(outf, success_count);
+    _save_counts(outf, veto_messages);
+
+    marshallInt(outf, level_mapcounts.size());
+    for (const auto &entry : level_mapcounts)
+    {
+        marshall_level_id(outf, entry.first);
+        marshallInt(outf, entry.second);
+    }
+
+    marshallInt(outf, map_builds.size());
+    for (const auto &entry : map_builds)
+    {
+        marshall_level_id(outf, entry.first);
+        marshallInt(outf, entry.second.first);
+        marshallInt(outf, entry.second.second);
+    }
+
+    marshallInt(outf, level_mapsused.size());
+    for (const auto &entry : level_mapsused)
+    {
+        marshall_level_id(outf, entry.first);
+        marshallInt(outf, entry.second.size());
+        for (const string &name : entry.second)
+            marshallString(outf, name);
+    }
+
+    marshallInt(outf, map_levelsused.size());
+    for (const auto &entry : map_levelsused)
+    {
+        marshallString(outf, entry.first);
+        marshallInt(outf, entry.second.size());
+        for (const level_id &lid : entry.second)
+            marshall_level_id(outf, lid);
+    }
+
+    marshallInt(outf, errors.size());
+    for (const auto &entry : errors)
+    {
+        marshallString(outf, entry.first);
+        marshallString(outf, entry.second);
+    }
+
+    builder_profile_save(outf);
+
+    if (crawl_state.obj_stat_gen)
+        objstat_save_job_stats(outf);
+}
+
+static void _merge_job_stats(reader &inf)
+{
+    levels_tried += unmarshallInt(inf);
+    levels_failed += unmarshallInt(inf);
+    build_attempts += unmarshallInt(inf);
+    level_vetoes += unmarshallInt(inf);
+    const string error = unmarshallString(inf);
+    if (!error.empty())
+        last_error = error;
+
+    _merge_counts(inf, try_count);
+    _merge_counts(inf, use_count);
+    _merge_counts(inf, success_count);
+    _merge_counts(inf, veto_messages);
+
+    for (int i = unmarshallInt(inf); i > 0; --i)
+    {
+        const level_id lid = unmarshall_level_id(inf);
+        level_mapcounts[lid] += unmarshallInt(inf);
+    }
+
+    for (int i = unmarshallInt(inf); i > 0; --i)
+    {
+        const level_id lid = unmarshall_level_id(inf);
+        map_builds[lid].first += unmarshallInt(inf);
+        map_builds[lid].second += unmarshallInt(inf);
+    }
+
+    for (int i = unmarshallInt(inf); i > 0; --i)
+    {
+        set<string> &maps = level_mapsused[unmarshall_level_id(inf)];
+        for (int j = unmarshallInt(inf); j > 0; --j)
+            maps.insert(unmarshallString(inf));
+    }
+
+    for (int i = unmarshallInt(inf); i > 0; --i)
+    {
+        set<level_id> &levels = map_levelsused[unmarshallString(inf)];
+        for (int j = unmarshallInt(inf); j > 0; --j)
+            levels.insert(unmarshall_level_id(inf));
+    }
+
+    for (int i = unmarshallInt(inf); i > 0; --i)
+    {
+        const string name = unmarshallString(inf);
+        errors[name] = unmarshallString(inf);
+    }
+
+    builder_profile_merge(inf);
+
+    if (crawl_state.obj_stat_gen)
+        objstat_merge_job_stats(inf);
+}
+
+static string _job_stats_file(int job)
+{
+    return make_stringf("mapstat-job%d.tmp", job);
+}
+
+// Build this job's share of the iterations, in a child process, and save
+// its statistics for the parent. Like a serial run, it stops at the first
+// iteration that fails, but still saves what it counted until then.
+static bool _run_job(int job, int jobs)
+{
+    no_messages mx;
+    const int first = SysEnv.map_gen_iters * job / jobs;
+    const int last = SysEnv.map_gen_iters * (job + 1) / jobs;
+    bool built = true;
+    for (int i = first; built && i < last; ++i)
+        built = _build_iteration(i);
+
+    const string filename = _job_stats_file(job);
+    FILE *fp = fopen_u(filename.c_str(), "wb");
+    if (!fp)
+        return false;
+    {
+        writer outf(filename, fp);
+        _save_job_stats(outf);
+    }
+    if (fclose(fp))
+    {
+        // Don't leave the parent half a file.
+        unlink_u(filename.c_str());
+        return false;
+    }
+    return built;
+}
+
+static bool _build_levels_in_jobs()
+{
+    const int jobs = min(SysEnv.map_gen_jobs, SysEnv.map_gen_iters);
+    printf("Running %d job(s)...\n", jobs);
+    fflush(stdout);
+    fflush(stderr);
+
+    vector<pid_t> pids;
+    for (int job = 0; job < jobs; ++job)
+    {
+        const pid_t pid = fork();
+        if (pid == -1)
+        {
+            fprintf(stderr, "Couldn't fork: %s\n", strerror(errno));
+            break;
+        }
+        if (!pid)
+            _exit(_run_job(job, jobs) ? 0 : 1);
+        pids.push_back(pid);
+    }
+
+    bool ok = (int)pids.size() == jobs;
+    vector<bool> exited;
+    vector<bool> finished;
+    for (pid_t pid : pids)
+    {
+        int status;
+        exited.push_back(waitpid(pid, &status, 0) != -1 && WIFEXITED(status));
+        finished.push_back(exited.back() && !WEXITSTATUS(status));
+        if (!finished.back())
+            ok = false;
+    }
+
+    // Merge in job order, so that the totals don't depend on which job
+    // finished first. A serial run stops counting at its first failed
+    // iteration, so stop merging after the first job that failed: it
+    // saved what it counted up to its failure, if it could. Later jobs
+    // built iterations a serial run wouldn't have reached.
+    bool merging = true;
+    for (int job = 0; job < (int)pids.size(); ++job)
+    {
+        const string filename = _job_stats_file(job);
+        if (merging && exited[job])
+        {
+            reader inf(filename);
+            if (inf.valid())
+                _merge_job_stats(inf);
+            else
+                ok = false;
+        }
+        merging = merging && finished[job];
+        unlink_u(filename.c_str());
+    }
+
+    printf(ok ? "Finished.\n" : "A job failed.\n");
+    fflush(stdout);
+    return ok;
+}
+#endif
+
 /**
  * Build dungeon levels for mapstat or objstat.
  *
  * The exact branches/levels built and number of build iterations is set by the
- * command-line options for mapstat/objstat.
-
+ * command-line options for mapstat/objstat. With -jobs, the iterations are
+ * split between that many child processes, whose statistics are added up.
+ *
  * @returns True if all iterations built successfully. For mapstat, this can
  * return false if an iteration produced a disconnected level, since for
  * diagnostic purposes we record the map in detail to a file and exit. For
@@ -246,6 +502,10 @@ bool mapstat_build_levels()
 {
     if (!generated_levels.size())
         _dungeon_places();
+#ifndef TARGET_OS_WINDOWS
+    if (SysEnv.map_gen_jobs > 1)
+        return _build_levels_in_jobs();
+#endif
     printf("Iteration: ");
     fflush(stdout);
     for (int i = 0; i < SysEnv.map_gen_iters; ++i)
@@ -260,18 +520,8 @@ bool mapstat_build_levels()
              build_attempts ? level_vetoes * 100.0 / build_attempts : 0.0);
         printf("%d..", i + 1);
         fflush(stdout);
-        dlua.callfn("dgn_clear_data", "");
-        you.uniq_map_tags.clear();
-        you.uniq_map_names.clear();
-        you.uniq_map_tags_abyss.clear();
-        you.uniq_map_names_abyss.clear();
-        you.unique_creatures.reset();
-        initialise_branch_depths();
-        init_level_connectivity();
-        if (!_build_dungeon())
+        if (!_build_iteration(i))
             return false;
-        if (crawl_state.obj_stat_gen)
-            objstat_iteration_stats();
     }
     printf("Finished.\n");
     fflush(stdout);
@@ -538,6 +788,11 @@ void mapstat_generate_stats()
     mapstat_build_levels();
 
     _write_map_stats();
+
+    const char *profile_file = "mapstat-profile.json";
+    printf("Writing level builder profile to %s...\n", profile_file);
+    if (!builder_profile_write_json(profile_file))
+        printf("Couldn't write %s.\n", profile_file);
     printf("Map stats complete.\n");
 }
 
@@ -9,6 +9,7 @@
 
 #include <cerrno>
 #include <cmath>
+#include <cstring>
 #include <sstream>
 
 #include "artefact.h"
@@ -34,6 +35,7 @@
 #include "state.h"
 #include "stepdown.h"
 #include "stringutil.h"
+#include "tags.h"
 #include "version.h"
 
 #ifdef DEBUG_STATISTICS
@@ -918,6 +920,99 @@ void objstat_iteration_stats()
     }
 }
 
+static void _save_stats(writer &outf, const map<string, double> &stats)
+{
+    marshallInt(outf, stats.size());
+    for (const auto &entry : stats)
+    {
+        marshallString(outf, entry.first);
+        uint64_t bits;
+        memcpy(&bits, &entry.second, sizeof(bits));
+        marshallUnsigned(outf, bits);
+    }
+}
+
+// Add a job's stats to ours: the minimum and maximum fields take the
+// smaller or larger value, all the others are totals.
+static void _merge_stats(reader &inf, map<string, double> &stats)
+{
+    for (int i = unmarshallInt(inf); i > 0; --i)
+    {
+        const string field = unmarshallString(inf);
+        const uint64_t bits = unmarshallUnsigned(inf);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+
+        auto it = stats.find(field);
+        if (it == stats.end())
+            stats[field] = value;
+        else if (ends_with(field, "Min"))
+            it->second = min(it->second, value);
+        else if (ends_with(field, "Max"))
+            it->second = max(it->second, value);
+        else
+            it->second += value;
+    }
+}
+
+// The record maps were all set up by _init_stats() before the jobs were
+// forked, so only the stats themselves need to be keyed.
+void objstat_save_job_stats(writer &outf)
+{
+    for (const auto &entry : item_recs)
+        for (const auto &base_recs : entry.second)
+            for (const auto &stats : base_recs)
+                _save_stats(outf, stats);
+
+    for (const brand_records *brands : { &weapon_brands, &armour_brands })
+        for (const auto &entry : *brands)
+            for (const auto &sub_brands : entry.second)
+                for (const auto &antiq_brands : sub_brands)
+                    for (int count : antiq_brands)
+                        marshallInt(outf, count);
+
+    for (const auto &entry : missile_brands)
+        for (const auto &sub_brands : entry.second)
+            for (int count : sub_brands)
+                marshallInt(outf, count);
+
+    for (const auto &entry : monster_recs)
+        for (const auto &mentry : entry.second)
+            _save_stats(outf, mentry.second);
+
+    for (const auto &entry : feature_recs)
+        for (const auto &fentry : entry.second)
+            _save_stats(outf, fentry.second);
+}
+
+void objstat_merge_job_stats(reader &inf)
+{
+    for (auto &entry : item_recs)
+        for (auto &base_recs : entry.second)
+            for (auto &stats : base_recs)
+                _merge_stats(inf, stats);
+
+    for (brand_records *brands : { &weapon_brands, &armour_brands })
+        for (auto &entry : *brands)
+            for (auto &sub_brands : entry.second)
+                for (auto &antiq_brands : sub_brands)
+                    for (int &count : antiq_brands)
+                        count += unmarshallInt(inf);
+
+    for (auto &entry : missile_brands)
+        for (auto &sub_brands : entry.second)
+            for (int &count : sub_brands)
+                count += unmarshallInt(inf);
+
+    for (auto &entry : monster_recs)
+        for (auto &mentry : entry.second)
+            _merge_stats(inf, mentry.second);
+
+    for (auto &entry : feature_recs)
+        for (auto &fentry : entry.second)
+            _merge_stats(inf, fentry.second);
+}
+
 static void _write_stat_headers(const vector<string> &fields, string desc)
 {
     fprintf(stat_outf, "%s\tLevel", desc.c_str());
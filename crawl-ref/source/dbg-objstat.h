@@ -11,4 +11,8 @@ void objstat_generate_stats();
 void objstat_record_monster(const monster *mons);
 void objstat_record_feature(dungeon_feature_type feat_type, bool vault);
 void objstat_iteration_stats();
+class writer;
+class reader;
+void objstat_save_job_stats(writer &outf);
+void objstat_merge_job_stats(reader &inf);
 #endif
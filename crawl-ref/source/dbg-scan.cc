@@ -313,6 +313,16 @@ void debug_mons_scan()
     ASSERT(you.type == MONS_PLAYER);
     ASSERT(you.mid == MID_PLAYER);
 
+    for (int i = env.mons_used; i < MAX_MONSTERS; ++i)
+    {
+        if (menv[i].type != MONS_NO_MONSTER)
+        {
+            mprf(MSGCH_ERROR, "Monster %s in slot %d, past the last slot in "
+                              "use (%d)",
+                 menv[i].name(DESC_PLAIN, true).c_str(), i, env.mons_used);
+        }
+    }
+
     vector<int> floating_mons;
     bool             is_floating[MAX_MONSTERS];
 
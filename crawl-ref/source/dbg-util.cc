@@ -8,11 +8,14 @@
 #include "dbg-util.h"
 
 #include "artefact.h"
+#include "dgn-profile.h"
 #include "directn.h"
 #include "dungeon.h"
 #include "format.h"
 #include "item-name.h"
 #include "libutil.h"
+#include "los.h"
+#include "losglobal.h"
 #include "macro.h"
 #include "message.h"
 #include "options.h"
@@ -142,6 +145,39 @@ void debug_show_builder_logs()
     log_scroller.show();
 }
 
+static string _percent(uint64_t part, uint64_t whole)
+{
+    return whole ? make_stringf("%.1f%%", 100.0 * part / whole) : "n/a";
+}
+
+static void _show_cache_stats(const char *what, const los_cache_stats &st)
+{
+    mprf("%s: %" PRIu64" hits, %" PRIu64" misses (%s hit rate), "
+         "%" PRIu64" invalidations",
+         what, st.hits, st.misses,
+         _percent(st.hits, st.hits + st.misses).c_str(), st.invalidations);
+}
+
+void debug_los_stats()
+{
+    _show_cache_stats("cell_see_cell", get_los_cache_stats());
+    _show_cache_stats("find_ray", get_ray_cache_stats());
+}
+
+void debug_builder_profile()
+{
+    const char *filename = "builder-profile.json";
+    formatted_scroller profile_scroller;
+    profile_scroller.set_more();
+    profile_scroller.add_text(builder_profile_summary());
+    profile_scroller.show();
+
+    if (builder_profile_write_json(filename))
+        mprf("Wrote the level builder profile to %s.", filename);
+    else
+        mprf(MSGCH_ERROR, "Couldn't write %s.", filename);
+}
+
 string debug_coord_str(const coord_def &pos)
 {
     return make_stringf("(%d, %d)%s", pos.x, pos.y,
@@ -1034,6 +1034,7 @@ static void _shaft_card(int power)
         {
             place_specific_trap(you.pos(), TRAP_SHAFT);
             trap_at(you.pos())->reveal();
+            set_terrain_changed(you.pos());
             mpr("A shaft materialises beneath you!");
             did_something = true;
         }
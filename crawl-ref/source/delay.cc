@@ -830,6 +830,7 @@ void PasswallDelay::finish()
     case DNGN_RUNED_CLEAR_DOOR:
         // Once opened, former runed doors become normal doors.
         dgn_open_door(dest);
+        set_terrain_changed(dest);
         break;
     }
 
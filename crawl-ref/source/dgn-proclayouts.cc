@@ -31,6 +31,54 @@ static dungeon_feature_type _pick_pseudorandom_wall(uint64_t val)
     return features[val%9];
 }
 
+void ProceduralLayout::sample(const vector<coord_def> &points,
+                              const uint32_t offset,
+                              vector<ProceduralSample> &out) const
+{
+    out.reserve(out.size() + points.size());
+    for (const coord_def &p : points)
+        out.push_back((*this)(p, offset));
+}
+
+// Evaluates worley noise for all of points in one batch, at the
+// coordinates at() gives for each point.
+template <class coords>
+static vector<worley::noise_datum> _batch_noise(
+    const vector<coord_def> &points, coords at)
+{
+    const size_t n = points.size();
+    vector<double> x(n), y(n), z(n);
+    for (size_t i = 0; i < n; ++i)
+        at(points[i], x[i], y[i], z[i]);
+
+    vector<worley::noise_datum> noise(n);
+    worley::noise(x.data(), y.data(), z.data(), n, noise.data());
+    return noise;
+}
+
+// Samples each point from the layout chosen for it, in one batch per layout.
+static vector<ProceduralSample> _batch_sample(
+    const vector<const ProceduralLayout*> &layouts,
+    const vector<coord_def> &points, const vector<int> &chosen,
+    const uint32_t offset)
+{
+    vector<vector<coord_def>> batches(layouts.size());
+    for (size_t i = 0; i < points.size(); ++i)
+        batches[chosen[i]].push_back(points[i]);
+
+    vector<vector<ProceduralSample>> samples(layouts.size());
+    for (size_t l = 0; l < layouts.size(); ++l)
+        if (!batches[l].empty())
+            layouts[l]->sample(batches[l], offset, samples[l]);
+
+    vector<ProceduralSample> out;
+    out.reserve(points.size());
+    vector<size_t> next(layouts.size(), 0);
+    for (size_t i = 0; i < points.size(); ++i)
+        out.push_back(samples[chosen[i]][next[chosen[i]]++]);
+    return out;
+}
+
 ProceduralSample
 ColumnLayout::operator()(const coord_def &p, const uint32_t offset) const
 {
@@ -88,6 +136,50 @@ WorleyLayout::operator()(const coord_def &p, const uint32_t offset) const
                 min(changepoint, sample.changepoint()));
 }
 
+void WorleyLayout::sample(const vector<coord_def> &points,
+                          const uint32_t offset,
+                          vector<ProceduralSample> &out) const
+{
+    const double offset_scale = 5000.0;
+    const vector<worley::noise_datum> noise = _batch_noise(points,
+        [&](const coord_def &p, double &x, double &y, double &z)
+        {
+            x = p.x / scale;
+            y = p.y / scale;
+            z = offset / offset_scale + seed;
+        });
+
+    const uint8_t size = layouts.size();
+    vector<coord_def> shifted;
+    vector<int> chosen;
+    vector<uint32_t> changepoints;
+    shifted.reserve(points.size());
+    chosen.reserve(points.size());
+    changepoints.reserve(points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        const worley::noise_datum &n = noise[i];
+        changepoints.push_back(offset + _get_changepoint(n, offset_scale));
+        bool parity = n.id[0] % 4;
+        uint32_t id = n.id[0] / 4;
+        const uint8_t choice = parity
+            ? id % size
+            : min(id % size, (id / size) % size);
+        shifted.push_back(points[i] + id);
+        chosen.push_back((choice + seed) % size);
+    }
+
+    const vector<ProceduralSample> samples =
+        _batch_sample(layouts, shifted, chosen, offset);
+
+    out.reserve(out.size() + points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        out.emplace_back(points[i], samples[i].feat(),
+                         min(changepoints[i], samples[i].changepoint()));
+    }
+}
+
 ProceduralSample
 ChaosLayout::operator()(const coord_def &p, const uint32_t offset) const
 {
@@ -111,6 +203,32 @@ RoilingChaosLayout::operator()(const coord_def &p, const uint32_t offset) const
     return ProceduralSample(p, sample.feat(), min(sample.changepoint(), changepoint));
 }
 
+void RoilingChaosLayout::sample(const vector<coord_def> &points,
+                                const uint32_t offset,
+                                vector<ProceduralSample> &out) const
+{
+    const double scale = (density - 350) + 4800;
+    const vector<worley::noise_datum> noise = _batch_noise(points,
+        [&](const coord_def &p, double &x, double &y, double &z)
+        {
+            x = p.x;
+            y = p.y;
+            z = offset / scale;
+        });
+
+    out.reserve(out.size() + points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        const coord_def &p = points[i];
+        const uint32_t changepoint = offset
+                                     + _get_changepoint(noise[i], scale);
+        ProceduralSample sample =
+            ChaosLayout(noise[i].id[0] + seed, density)(p, offset);
+        out.emplace_back(p, sample.feat(),
+                         min(sample.changepoint(), changepoint));
+    }
+}
+
 ProceduralSample
 WastesLayout::operator()(const coord_def &p, const uint32_t offset) const
 {
@@ -125,6 +243,30 @@ WastesLayout::operator()(const coord_def &p, const uint32_t offset) const
     return ProceduralSample(p, feat, min(sample.changepoint(), changepoint));
 }
 
+void WastesLayout::sample(const vector<coord_def> &points,
+                          const uint32_t offset,
+                          vector<ProceduralSample> &out) const
+{
+    const vector<worley::noise_datum> noise = _batch_noise(points,
+        [&](const coord_def &p, double &x, double &y, double &z)
+        {
+            x = p.x;
+            y = p.y;
+            z = offset / 3;
+        });
+
+    out.reserve(out.size() + points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        const coord_def &p = points[i];
+        const uint32_t changepoint = offset + _get_changepoint(noise[i], 3);
+        ProceduralSample sample = ChaosLayout(noise[i].id[0], 10)(p, offset);
+        dungeon_feature_type feat = feat_is_solid(sample.feat())
+            ? DNGN_ROCK_WALL : DNGN_FLOOR;
+        out.emplace_back(p, feat, min(sample.changepoint(), changepoint));
+    }
+}
+
 ProceduralSample
 RiverLayout::operator()(const coord_def &p, const uint32_t offset) const
 {
@@ -151,15 +293,66 @@ RiverLayout::operator()(const coord_def &p, const uint32_t offset) const
     return layout(p, offset);
 }
 
-ProceduralSample
-NewAbyssLayout::operator()(const coord_def &p, const uint32_t offset) const
+void RiverLayout::sample(const vector<coord_def> &points,
+                         const uint32_t offset,
+                         vector<ProceduralSample> &out) const
+{
+    const double scale = 10000;
+    const double scalar = 90.0;
+    const vector<worley::noise_datum> noise = _batch_noise(points,
+        [&](const coord_def &p, double &x, double &y, double &z)
+        {
+            x = (p.x + perlin::fBM(p.x/4.0, p.y/4.0, seed, 5) * 3) / scalar;
+            y = (p.y + perlin::fBM(p.x/4.0 + 3.7, p.y/4.0 + 1.9, seed + 4, 5)
+                       * 3) / scalar;
+            z = offset / scale + seed;
+        });
+
+    // Points away from the rivers come from the underlying layout, in one
+    // batch.
+    vector<coord_def> land;
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        const worley::noise_datum &n = noise[i];
+        if ((n.id[0] ^ n.id[1] ^ seed) % 4
+            || n.distance[1] - n.distance[0] >= 1.5/scalar)
+        {
+            land.push_back(points[i]);
+        }
+    }
+    vector<ProceduralSample> land_samples;
+    layout.sample(land, offset, land_samples);
+
+    out.reserve(out.size() + points.size());
+    size_t next_land = 0;
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        const coord_def &p = points[i];
+        const worley::noise_datum &n = noise[i];
+        if ((n.id[0] ^ n.id[1] ^ seed) % 4
+            || n.distance[1] - n.distance[0] >= 1.5/scalar)
+        {
+            out.push_back(land_samples[next_land++]);
+            continue;
+        }
+
+        const uint32_t changepoint = offset + _get_changepoint(n, scale);
+        dungeon_feature_type feat = DNGN_SHALLOW_WATER;
+        uint64_t hash = hash3(p.x, p.y, n.id[0] + seed);
+        if (!(hash % 5))
+            feat = DNGN_DEEP_WATER;
+        if (!(hash % 23))
+            feat = DNGN_TREE;
+        out.emplace_back(p, feat, changepoint);
+    }
+}
+
+static ProceduralSample _new_abyss_sample(const coord_def &p,
+                                          const uint32_t offset,
+                                          const worley::noise_datum &noise,
+                                          const uint32_t seed)
 {
-    const double scale = 1.0 / 3.2;
     uint64_t base = hash3(p.x, p.y, seed);
-    worley::noise_datum noise = worley::noise(
-            p.x * scale,
-            p.y * scale,
-            offset / 1000.0);
     dungeon_feature_type feat = DNGN_FLOOR;
 
     int dist = noise.distance[0] * 100;
@@ -181,6 +374,35 @@ NewAbyssLayout::operator()(const coord_def &p, const uint32_t offset) const
     return ProceduralSample(p, feat, offset + delta);
 }
 
+ProceduralSample
+NewAbyssLayout::operator()(const coord_def &p, const uint32_t offset) const
+{
+    const double scale = 1.0 / 3.2;
+    worley::noise_datum noise = worley::noise(
+            p.x * scale,
+            p.y * scale,
+            offset / 1000.0);
+    return _new_abyss_sample(p, offset, noise, seed);
+}
+
+void NewAbyssLayout::sample(const vector<coord_def> &points,
+                            const uint32_t offset,
+                            vector<ProceduralSample> &out) const
+{
+    const double scale = 1.0 / 3.2;
+    const vector<worley::noise_datum> noise = _batch_noise(points,
+        [&](const coord_def &p, double &x, double &y, double &z)
+        {
+            x = p.x * scale;
+            y = p.y * scale;
+            z = offset / 1000.0;
+        });
+
+    out.reserve(out.size() + points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+        out.push_back(_new_abyss_sample(points[i], offset, noise[i], seed));
+}
+
 dungeon_feature_type sanitize_feature(dungeon_feature_type feature, bool strict)
 {
     if (feat_is_gate(feature)
@@ -282,6 +504,31 @@ LevelLayout::operator()(const coord_def &p, const uint32_t offset) const
     return ProceduralSample(p, feat, offset + 4096);
 }
 
+void LevelLayout::sample(const vector<coord_def> &points,
+                         const uint32_t offset,
+                         vector<ProceduralSample> &out) const
+{
+    // Points off the level's remains come from the underlying layout, in
+    // one batch.
+    vector<coord_def> unseen;
+    for (const coord_def &p : points)
+        if (grid(clip(p)) == DNGN_UNSEEN)
+            unseen.push_back(p);
+    vector<ProceduralSample> unseen_samples;
+    layout.sample(unseen, offset, unseen_samples);
+
+    out.reserve(out.size() + points.size());
+    size_t next_unseen = 0;
+    for (const coord_def &p : points)
+    {
+        const dungeon_feature_type feat = grid(clip(p));
+        if (feat == DNGN_UNSEEN)
+            out.push_back(unseen_samples[next_unseen++]);
+        else
+            out.emplace_back(p, feat, offset + 4096);
+    }
+}
+
 ProceduralSample
 NoiseLayout::operator()(const coord_def &p, const uint32_t offset) const
 {
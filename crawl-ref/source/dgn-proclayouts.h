@@ -54,6 +54,11 @@ class ProceduralLayout
     public:
         virtual ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const = 0;
+        // Samples all of points, appending to out in the same order. This
+        // must give exactly what operator() gives for each point; layouts
+        // override it where a batch of nearby points can share work.
+        virtual void sample(const vector<coord_def> &points,
+            const uint32_t offset, vector<ProceduralSample> &out) const;
         virtual ~ProceduralLayout() { }
 };
 
@@ -97,6 +102,8 @@ class WorleyLayout : public ProceduralLayout
             seed(_seed), layouts(_layouts), scale(_scale) {}
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
+        void sample(const vector<coord_def> &points, const uint32_t offset,
+            vector<ProceduralSample> &out) const override;
     private:
         const uint32_t seed;
         const vector<const ProceduralLayout*> layouts;
@@ -129,6 +136,8 @@ class RoilingChaosLayout : public ProceduralLayout
             seed(_seed), density(_density) {}
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
+        void sample(const vector<coord_def> &points, const uint32_t offset,
+            vector<ProceduralSample> &out) const override;
     private:
         const uint32_t seed;
         const uint32_t density;
@@ -141,6 +150,8 @@ class WastesLayout : public ProceduralLayout
         WastesLayout() { };
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
+        void sample(const vector<coord_def> &points, const uint32_t offset,
+            vector<ProceduralSample> &out) const override;
 };
 
 class RiverLayout : public ProceduralLayout
@@ -150,6 +161,8 @@ class RiverLayout : public ProceduralLayout
             seed(_seed), layout(_layout) {}
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
+        void sample(const vector<coord_def> &points, const uint32_t offset,
+            vector<ProceduralSample> &out) const override;
     private:
         const uint32_t seed;
         const ProceduralLayout &layout;
@@ -162,6 +175,8 @@ class NewAbyssLayout : public ProceduralLayout
         NewAbyssLayout(uint32_t _seed) : seed(_seed) {}
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
+        void sample(const vector<coord_def> &points, const uint32_t offset,
+            vector<ProceduralSample> &out) const override;
     private:
         const uint32_t seed;
 };
@@ -175,6 +190,8 @@ class LevelLayout : public ProceduralLayout
             const ProceduralLayout &_layout);
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
+        void sample(const vector<coord_def> &points, const uint32_t offset,
+            vector<ProceduralSample> &out) const override;
     private:
         feature_grid grid;
         uint32_t seed;
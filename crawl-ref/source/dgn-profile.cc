@@ -0,0 +1,446 @@
+/**
+ * @file
+ * @brief Level builder profiling: where build time goes, and why levels
+ *        are vetoed.
+**/
+
+#include "AppHdr.h"
+
+#include "dgn-profile.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "branch.h"
+#include "dungeon.h"
+#include "env.h"
+#include "json.h"
+#include "json-wrapper.h"
+#include "player.h"
+#include "stringutil.h"
+#include "syscalls.h"
+#include "tags.h"
+
+static const char *phase_names[] =
+{
+    "other", "primary", "layout", "vaults", "monsters", "items",
+    "connectivity",
+};
+COMPILE_CHECK(ARRAYSZ(phase_names) == NUM_BUILDER_PHASES);
+
+// How many of the slowest level builds to remember.
+#define SLOW_LEVELS 20
+
+struct branch_build_stats
+{
+    int levels = 0;             // Calls to builder().
+    int failed = 0;             // ... that gave up.
+    int attempts = 0;
+    int vetoes = 0;             // Attempts thrown away.
+    int64_t usecs[NUM_BUILDER_PHASES] = { };
+    int64_t vetoed_usecs = 0;   // Time spent on attempts thrown away.
+    map<string, int> veto_reasons;
+};
+
+struct slow_level
+{
+    level_id place;
+    int64_t usecs;
+    int attempts;
+    string layout;
+    string primary;
+};
+
+struct vault_build_stats
+{
+    int tries = 0;              // Calls to vault_main().
+    int attempts = 0;           // Tries to resolve and place the map.
+    int placed = 0;
+    int64_t usecs = 0;
+};
+
+static branch_build_stats branch_stats[NUM_BRANCHES];
+static vector<slow_level> slow_levels;
+static map<string, vault_build_stats> vault_stats;
+
+// The level and attempt being built.
+static bool building_level = false;
+static bool building_attempt = false;
+static branch_type level_branch;
+static int64_t level_start;
+static int level_attempts;
+static builder_phase phase = BPHASE_OTHER;
+static int64_t phase_start;
+static int64_t attempt_usecs[NUM_BUILDER_PHASES];
+
+int64_t builder_profile_usecs()
+{
+    return chrono::duration_cast<chrono::microseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void _charge_phase()
+{
+    const int64_t now = builder_profile_usecs();
+    attempt_usecs[phase] += now - phase_start;
+    phase_start = now;
+}
+
+builder_phase_timer::builder_phase_timer(builder_phase _phase)
+    : outer(phase)
+{
+    if (!building_attempt)
+        return;
+    _charge_phase();
+    phase = _phase;
+}
+
+builder_phase_timer::~builder_phase_timer()
+{
+    if (!building_attempt)
+        return;
+    _charge_phase();
+    phase = outer;
+}
+
+void builder_profile_level_start()
+{
+    building_level = true;
+    level_branch = you.where_are_you;
+    level_start = builder_profile_usecs();
+    level_attempts = 0;
+}
+
+void builder_profile_level_end(bool built)
+{
+    if (!building_level)
+        return;
+    building_level = false;
+
+    branch_build_stats &stats = branch_stats[level_branch];
+    ++stats.levels;
+    if (!built)
+        ++stats.failed;
+
+    slow_level level;
+    level.place = level_id::current();
+    level.usecs = builder_profile_usecs() - level_start;
+    level.attempts = level_attempts;
+    if (env.properties.exists(LAYOUT_TYPE_KEY))
+        level.layout = env.properties[LAYOUT_TYPE_KEY].get_string();
+    if (built && !env.level_vaults.empty())
+        level.primary = env.level_vaults[0]->map.name;
+
+    auto slower = [](const slow_level &a, const slow_level &b)
+                  {
+                      return a.usecs > b.usecs;
+                  };
+    slow_levels.insert(upper_bound(slow_levels.begin(), slow_levels.end(),
+                                   level, slower),
+                       level);
+    if (slow_levels.size() > SLOW_LEVELS)
+        slow_levels.pop_back();
+}
+
+void builder_profile_attempt_start()
+{
+    building_attempt = true;
+    ++level_attempts;
+    phase = BPHASE_OTHER;
+    phase_start = builder_profile_usecs();
+    for (int64_t &usecs : attempt_usecs)
+        usecs = 0;
+}
+
+/**
+ * Finish timing an attempt at building a level.
+ *
+ * @param veto  why the attempt was thrown away, or empty if it succeeded.
+ */
+void builder_profile_attempt_end(const string &veto)
+{
+    if (!building_attempt)
+        return;
+    _charge_phase();
+    building_attempt = false;
+
+    branch_build_stats &stats = branch_stats[you.where_are_you];
+    ++stats.attempts;
+    int64_t total = 0;
+    for (int i = 0; i < NUM_BUILDER_PHASES; ++i)
+    {
+        stats.usecs[i] += attempt_usecs[i];
+        total += attempt_usecs[i];
+    }
+
+    if (!veto.empty())
+    {
+        ++stats.vetoes;
+        ++stats.veto_reasons[veto];
+        stats.vetoed_usecs += total;
+    }
+}
+
+void builder_profile_vault(const string &name, int attempts, bool placed,
+                           int64_t usecs)
+{
+    vault_build_stats &stats = vault_stats[name];
+    ++stats.tries;
+    stats.attempts += attempts;
+    if (placed)
+        ++stats.placed;
+    stats.usecs += usecs;
+}
+
+void builder_profile_reset()
+{
+    for (branch_build_stats &stats : branch_stats)
+        stats = branch_build_stats();
+    slow_levels.clear();
+    vault_stats.clear();
+}
+
+static double _msecs(int64_t usecs)
+{
+    return usecs / 1000.0;
+}
+
+string builder_profile_summary()
+{
+    int levels = 0, attempts = 0, vetoes = 0;
+    int64_t usecs[NUM_BUILDER_PHASES] = { };
+    int64_t total = 0;
+    for (const branch_build_stats &stats : branch_stats)
+    {
+        levels += stats.levels;
+        attempts += stats.attempts;
+        vetoes += stats.vetoes;
+        for (int i = 0; i < NUM_BUILDER_PHASES; ++i)
+        {
+            usecs[i] += stats.usecs[i];
+            total += stats.usecs[i];
+        }
+    }
+
+    if (!levels)
+        return "No levels built yet.";
+
+    string summary = make_stringf(
+        "%d levels in %.1f ms: %d attempts, %d vetoed.\n",
+        levels, _msecs(total), attempts, vetoes);
+    for (int i = 0; i < NUM_BUILDER_PHASES; ++i)
+    {
+        summary += make_stringf("  %-13s %9.1f ms\n", phase_names[i],
+                                _msecs(usecs[i]));
+    }
+    summary += "Slowest levels:\n";
+    for (const slow_level &level : slow_levels)
+    {
+        summary += make_stringf("  %-10s %8.1f ms, %2d attempts  %s\n",
+                                level.place.describe().c_str(),
+                                _msecs(level.usecs), level.attempts,
+                                level.primary.c_str());
+    }
+    return summary;
+}
+
+static JsonNode *_phase_times(const int64_t *usecs)
+{
+    JsonNode *phases(json_mkobject());
+    for (int i = 0; i < NUM_BUILDER_PHASES; ++i)
+    {
+        json_append_member(phases, phase_names[i],
+                           json_mknumber(_msecs(usecs[i])));
+    }
+    return phases;
+}
+
+static JsonNode *_branch_array()
+{
+    JsonNode *array(json_mkarray());
+    for (branch_iterator it; it; ++it)
+    {
+        const branch_build_stats &stats = branch_stats[it->id];
+        if (!stats.levels && !stats.attempts)
+            continue;
+
+        JsonNode *branch(json_mkobject());
+        json_append_member(branch, "branch", json_mkstring(it->abbrevname));
+        json_append_member(branch, "levels", json_mknumber(stats.levels));
+        json_append_member(branch, "failed", json_mknumber(stats.failed));
+        json_append_member(branch, "attempts", json_mknumber(stats.attempts));
+        json_append_member(branch, "vetoes", json_mknumber(stats.vetoes));
+        json_append_member(branch, "phase_ms", _phase_times(stats.usecs));
+        json_append_member(branch, "vetoed_ms",
+                           json_mknumber(_msecs(stats.vetoed_usecs)));
+
+        JsonNode *reasons(json_mkobject());
+        for (const auto &entry : stats.veto_reasons)
+        {
+            json_append_member(reasons, entry.first.c_str(),
+                               json_mknumber(entry.second));
+        }
+        json_append_member(branch, "veto_reasons", reasons);
+        json_append_element(array, branch);
+    }
+    return array;
+}
+
+static JsonNode *_slow_level_array()
+{
+    JsonNode *array(json_mkarray());
+    for (const slow_level &level : slow_levels)
+    {
+        JsonNode *node(json_mkobject());
+        json_append_member(node, "level",
+                           json_mkstring(level.place.describe().c_str()));
+        json_append_member(node, "ms", json_mknumber(_msecs(level.usecs)));
+        json_append_member(node, "attempts", json_mknumber(level.attempts));
+        json_append_member(node, "layout", json_mkstring(level.layout.c_str()));
+        json_append_member(node, "primary",
+                           json_mkstring(level.primary.c_str()));
+        json_append_element(array, node);
+    }
+    return array;
+}
+
+// Vaults, most time spent first.
+static JsonNode *_vault_array()
+{
+    vector<pair<int64_t, string>> order;
+    for (const auto &entry : vault_stats)
+        order.emplace_back(-entry.second.usecs, entry.first);
+    sort(order.begin(), order.end());
+
+    JsonNode *array(json_mkarray());
+    for (const auto &entry : order)
+    {
+        const vault_build_stats &stats = vault_stats[entry.second];
+        JsonNode *node(json_mkobject());
+        json_append_member(node, "name", json_mkstring(entry.second.c_str()));
+        json_append_member(node, "tries", json_mknumber(stats.tries));
+        json_append_member(node, "attempts", json_mknumber(stats.attempts));
+        json_append_member(node, "placed", json_mknumber(stats.placed));
+        json_append_member(node, "ms", json_mknumber(_msecs(stats.usecs)));
+        json_append_element(array, node);
+    }
+    return array;
+}
+
+/**
+ * Write the profile of all levels built so far as JSON, of the form
+ * @code
+ *   { "branches": [...], "slowest_levels": [...], "vaults": [...] }
+ * @endcode
+ *
+ * Branches are objects with the counts of levels, failed levels, attempts
+ * and vetoes, the time in ms spent in each phase ("phase_ms") and on
+ * vetoed attempts ("vetoed_ms"), and a count of each veto reason.
+ * The slowest levels give the total time, number of attempts, layout types
+ * and first vault placed. Vaults give the number of times each was tried,
+ * the attempts at resolving and placing it, the times it was placed and
+ * the time spent in all that.
+ */
+bool builder_profile_write_json(const string &filename)
+{
+    FILE *fp = fopen_u(filename.c_str(), "w");
+    if (!fp)
+        return false;
+
+    JsonWrapper json(json_mkobject());
+    json_append_member(json.node, "branches", _branch_array());
+    json_append_member(json.node, "slowest_levels", _slow_level_array());
+    json_append_member(json.node, "vaults", _vault_array());
+
+    char *s = json_stringify(json.node, "  ");
+    const bool ok = s && fprintf(fp, "%s\n", s) >= 0;
+    free(s);
+    return !fclose(fp) && ok;
+}
+
+void builder_profile_save(writer &outf)
+{
+    for (const branch_build_stats &stats : branch_stats)
+    {
+        marshallInt(outf, stats.levels);
+        marshallInt(outf, stats.failed);
+        marshallInt(outf, stats.attempts);
+        marshallInt(outf, stats.vetoes);
+        for (int64_t usecs : stats.usecs)
+            marshallSigned(outf, usecs);
+        marshallSigned(outf, stats.vetoed_usecs);
+        marshallInt(outf, stats.veto_reasons.size());
+        for (const auto &entry : stats.veto_reasons)
+        {
+            marshallString(outf, entry.first);
+            marshallInt(outf, entry.second);
+        }
+    }
+
+    marshallInt(outf, slow_levels.size());
+    for (const slow_level &level : slow_levels)
+    {
+        marshall_level_id(outf, level.place);
+        marshallSigned(outf, level.usecs);
+        marshallInt(outf, level.attempts);
+        marshallString(outf, level.layout);
+        marshallString(outf, level.primary);
+    }
+
+    marshallInt(outf, vault_stats.size());
+    for (const auto &entry : vault_stats)
+    {
+        marshallString(outf, entry.first);
+        marshallInt(outf, entry.second.tries);
+        marshallInt(outf, entry.second.attempts);
+        marshallInt(outf, entry.second.placed);
+        marshallSigned(outf, entry.second.usecs);
+    }
+}
+
+// Add in a profile saved by builder_profile_save().
+void builder_profile_merge(reader &inf)
+{
+    for (branch_build_stats &stats : branch_stats)
+    {
+        stats.levels += unmarshallInt(inf);
+        stats.failed += unmarshallInt(inf);
+        stats.attempts += unmarshallInt(inf);
+        stats.vetoes += unmarshallInt(inf);
+        for (int64_t &usecs : stats.usecs)
+            usecs += unmarshallSigned(inf);
+        stats.vetoed_usecs += unmarshallSigned(inf);
+        for (int i = unmarshallInt(inf); i > 0; --i)
+        {
+            const string reason = unmarshallString(inf);
+            stats.veto_reasons[reason] += unmarshallInt(inf);
+        }
+    }
+
+    for (int i = unmarshallInt(inf); i > 0; --i)
+    {
+        slow_level level;
+        level.place = unmarshall_level_id(inf);
+        level.usecs = unmarshallSigned(inf);
+        level.attempts = unmarshallInt(inf);
+        level.layout = unmarshallString(inf);
+        level.primary = unmarshallString(inf);
+        slow_levels.push_back(level);
+    }
+    stable_sort(slow_levels.begin(), slow_levels.end(),
+                [](const slow_level &a, const slow_level &b)
+                {
+                    return a.usecs > b.usecs;
+                });
+    if (slow_levels.size() > SLOW_LEVELS)
+        slow_levels.resize(SLOW_LEVELS);
+
+    for (int i = unmarshallInt(inf); i > 0; --i)
+    {
+        vault_build_stats &stats = vault_stats[unmarshallString(inf)];
+        stats.tries += unmarshallInt(inf);
+        stats.attempts += unmarshallInt(inf);
+        stats.placed += unmarshallInt(inf);
+        stats.usecs += unmarshallSigned(inf);
+    }
+}
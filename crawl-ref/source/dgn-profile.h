@@ -0,0 +1,50 @@
+/**
+ * @file
+ * @brief Level builder profiling: where build time goes, and why levels
+ *        are vetoed.
+**/
+
+#pragma once
+
+class reader;
+class writer;
+
+// Keep phase names in dgn-profile.cc in sync.
+enum builder_phase
+{
+    BPHASE_OTHER,           // Resetting the level, traps, stairs, fixups.
+    BPHASE_PRIMARY,         // The primary vault, or the branch's own builder.
+    BPHASE_LAYOUT,          // The layout around the primary vault.
+    BPHASE_VAULTS,          // Branch entries, chance vaults and minivaults.
+    BPHASE_MONSTERS,
+    BPHASE_ITEMS,
+    BPHASE_CONNECTIVITY,    // Connectivity checks and fixups.
+    NUM_BUILDER_PHASES
+};
+
+// Charges the time until it goes out of scope to a phase, pausing the
+// phase it interrupts. Does nothing outside a level build.
+class builder_phase_timer
+{
+public:
+    builder_phase_timer(builder_phase phase);
+    ~builder_phase_timer();
+
+private:
+    builder_phase outer;
+};
+
+int64_t builder_profile_usecs();
+
+void builder_profile_level_start();
+void builder_profile_level_end(bool built);
+void builder_profile_attempt_start();
+void builder_profile_attempt_end(const string &veto = "");
+void builder_profile_vault(const string &name, int attempts, bool placed,
+                           int64_t usecs);
+
+void builder_profile_reset();
+string builder_profile_summary();
+bool builder_profile_write_json(const string &filename);
+void builder_profile_save(writer &outf);
+void builder_profile_merge(reader &inf);
@@ -13,5 +13,6 @@ enum disable_type
     DIS_AFFLICTIONS,
     DIS_MON_SIGHT,
     DIS_SAVE_CHECKPOINTS,
+    DIS_MAP_INDEX,
     NUM_DISABLEMENTS
 };
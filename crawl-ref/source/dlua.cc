@@ -72,7 +72,13 @@ void dlua_chunk::write(writer& outf) const
         return;
     }
 
-    if (!compiled.empty())
+    if (!compiled.empty() && !chunk.empty())
+    {
+        marshallByte(outf, CT_SOURCE_COMPILED);
+        marshallString4(outf, chunk);
+        marshallString4(outf, compiled);
+    }
+    else if (!compiled.empty())
     {
         marshallByte(outf, CT_COMPILED);
         marshallString4(outf, compiled);
@@ -101,6 +107,10 @@ void dlua_chunk::read(reader& inf)
     case CT_COMPILED:
         unmarshallString4(inf, compiled);
         break;
+    case CT_SOURCE_COMPILED:
+        unmarshallString4(inf, chunk);
+        unmarshallString4(inf, compiled);
+        break;
     }
     unmarshallString4(inf, file);
     first = unmarshallInt(inf);
@@ -151,9 +161,12 @@ int dlua_chunk::load(CLua &interp)
 {
     if (!compiled.empty())
     {
-        return check_op(interp,
-                         interp.loadbuffer(compiled.c_str(), compiled.length(),
-                                           context.c_str()));
+        const int err = interp.loadbuffer(compiled.c_str(), compiled.length(),
+                                          context.c_str());
+        if (!err || trimmed_string(chunk).empty())
+            return check_op(interp, err);
+        // Bytecode from some other Lua build: fall back on the source.
+        compiled.clear();
     }
 
     if (empty())
@@ -178,6 +191,16 @@ int dlua_chunk::load(CLua &interp)
     return err;
 }
 
+// Compiles the chunk without running it, so that its bytecode can be saved
+// along with the source.
+void dlua_chunk::precompile(CLua &interp)
+{
+    if (!compiled.empty() || empty())
+        return;
+    if (!load(interp))
+        lua_pop(interp, 1);
+}
+
 int dlua_chunk::run(CLua &interp)
 {
     int err = load(interp);
@@ -32,6 +32,7 @@
 #include "dgn-delve.h"
 #include "dgn-height.h"
 #include "dgn-overview.h"
+#include "dgn-profile.h"
 #include "dgn-shoals.h"
 #include "end.h"
 #include "files.h"
@@ -286,6 +287,8 @@ bool builder(bool enable_random_maps)
         level_id::current().describe().c_str()));
 #endif
 
+    builder_profile_level_start();
+
     // N tries to build the level, after which we bail with a capital B.
     int tries = 50;
     while (tries-- > 0)
@@ -298,10 +301,14 @@ bool builder(bool enable_random_maps)
         try
         {
             if (_build_level_vetoable(enable_random_maps))
+            {
+                builder_profile_level_end(true);
                 return true;
+            }
         }
         catch (map_load_exception &mload)
         {
+            builder_profile_attempt_end("Failed to load map.");
             mprf(MSGCH_ERROR, "Failed to load map, reloading all maps (%s).",
                  mload.what());
             reread_maps();
@@ -311,7 +318,9 @@ bool builder(bool enable_random_maps)
         get_uniq_map_names() = uniq_names;
     }
 
-    if (!crawl_state.map_stat_gen && !crawl_state.obj_stat_gen)
+    builder_profile_level_end(false);
+    if (!crawl_state.map_stat_gen && !crawl_state.obj_stat_gen
+        && !crawl_state.seed_survey)
     {
         // Failed to build level, bail out.
         if (crawl_state.need_save)
@@ -336,6 +345,7 @@ static bool _build_level_vetoable(bool enable_random_maps)
 #ifdef DEBUG_STATISTICS
     mapstat_report_map_build_start();
 #endif
+    builder_profile_attempt_start();
 
     dgn_reset_level(enable_random_maps);
 
@@ -353,6 +363,7 @@ static bool _build_level_vetoable(bool enable_random_maps)
 #ifdef DEBUG_STATISTICS
         mapstat_report_map_veto(e.what());
 #endif
+        builder_profile_attempt_end(e.what());
         // try not to lose any ghosts that have been placed
         save_ghosts(ghost_demon::find_ghosts(false), false);
         return false;
@@ -363,6 +374,7 @@ static bool _build_level_vetoable(bool enable_random_maps)
     if (crawl_state.game_standard_levelgen()
         && !_valid_dungeon_level())
     {
+        builder_profile_attempt_end("Invalid level.");
         return false;
     }
 
@@ -402,6 +414,7 @@ static bool _build_level_vetoable(bool enable_random_maps)
             mprf(MSGCH_ERROR, "branch epilogue for %s failed: %s",
                               level_id::current().describe().c_str(),
                               dlua.error.c_str());
+            builder_profile_attempt_end("Branch epilogue failed.");
             return false;
         }
 
@@ -414,6 +427,7 @@ static bool _build_level_vetoable(bool enable_random_maps)
     for (auto vault : _you_all_vault_list)
         mapstat_report_map_success(vault);
 #endif
+    builder_profile_attempt_end();
 
     return true;
 }
@@ -795,50 +809,95 @@ static bool _dgn_square_is_ever_passable(const coord_def &c)
     return _dgn_square_is_passable(c);
 }
 
-static inline void _dgn_point_record_stub(const coord_def &) { }
+// Union-find over the cells of the level, indexed by x + y * GXM.
+static int _dgn_zone_root(vector<int> &parent, int i)
+{
+    while (parent[i] != i)
+    {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
 
-template <class point_record>
-static bool _dgn_fill_zone(
-    const coord_def &start, int zone,
-    point_record &record_point,
-    bool (*passable)(const coord_def &) = _dgn_square_is_passable,
-    bool (*iswanted)(const coord_def &) = nullptr)
+static void _dgn_zone_join(vector<int> &parent, int i, int j)
 {
-    bool ret = false;
-    list<coord_def> points[2];
-    int cur = 0;
+    i = _dgn_zone_root(parent, i);
+    j = _dgn_zone_root(parent, j);
+    // Keep the cell that comes first in scan order as the root.
+    if (i < j)
+        parent[j] = i;
+    else if (j < i)
+        parent[i] = j;
+}
 
-    // No bounds checks, assuming the level has at least one layer of
-    // rock border.
+// Labels every passable square in travel_point_distance with the number of
+// its (8-connected) zone, and returns the number of zones. Zones are
+// numbered in the order a row-major scan first meets them, which is the
+// numbering you'd get by flood filling from each unlabelled square in turn,
+// but each square is only tested for passability once and there's no
+// flood queue. If iswanted is given, wanted[zone] is set for each zone
+// containing a square it accepts (wanted[0] is unused).
+static int _dgn_label_zones(
+    bool (*passable)(const coord_def &) = _dgn_square_is_passable,
+    bool (*iswanted)(const coord_def &) = nullptr,
+    vector<bool> *wanted = nullptr)
+{
+    memset(travel_point_distance, 0, sizeof(travel_distance_grid_t));
 
-    for (points[cur].push_back(start); !points[cur].empty();)
-    {
-        for (const auto &c : points[cur])
+    // -1 for impassable squares.
+    vector<int> parent(GXM * GYM, -1);
+    for (int y = 0; y < GYM; ++y)
+        for (int x = 0; x < GXM; ++x)
         {
-            travel_point_distance[c.x][c.y] = zone;
+            if (!map_bounds(x, y) || !passable(coord_def(x, y)))
+                continue;
 
-            if (iswanted && iswanted(c))
-                ret = true;
+            const int i = x + y * GXM;
+            parent[i] = i;
 
-            for (adjacent_iterator ai(c); ai; ++ai)
+            // Join with the already scanned neighbours: west, and the three
+            // squares of the row above.
+            if (x > 0 && parent[i - 1] >= 0)
+                _dgn_zone_join(parent, i, i - 1);
+            if (y == 0)
+                continue;
+            for (int nx = max(x - 1, 0); nx <= min(x + 1, GXM - 1); ++nx)
+                if (parent[nx + (y - 1) * GXM] >= 0)
+                    _dgn_zone_join(parent, i, nx + (y - 1) * GXM);
+        }
+
+    // The root of each zone is its first square in scan order, so zones
+    // get their numbers from their roots.
+    int nzones = 0;
+    vector<int> zone_of(GXM * GYM, 0);
+    if (wanted)
+        wanted->assign(1, false);
+    for (int y = 0; y < GYM; ++y)
+        for (int x = 0; x < GXM; ++x)
+        {
+            const int i = x + y * GXM;
+            if (parent[i] < 0)
+                continue;
+
+            const int root = _dgn_zone_root(parent, i);
+            if (root == i)
             {
-                const coord_def& cp = *ai;
-                if (!map_bounds(cp)
-                    || travel_point_distance[cp.x][cp.y] || !passable(cp))
-                {
-                    continue;
-                }
+                zone_of[i] = ++nzones;
+                if (wanted)
+                    wanted->push_back(false);
+            }
 
-                travel_point_distance[cp.x][cp.y] = zone;
-                record_point(cp);
-                points[!cur].push_back(cp);
+            const int zone = zone_of[root];
+            travel_point_distance[x][y] = zone;
+            if (iswanted && wanted && !(*wanted)[zone]
+                && iswanted(coord_def(x, y)))
+            {
+                (*wanted)[zone] = true;
             }
         }
 
-        points[cur].clear();
-        cur = !cur;
-    }
-    return ret;
+    return nzones;
 }
 
 static bool _is_perm_down_stair(const coord_def &c)
@@ -948,69 +1007,62 @@ static bool _is_exit_stair(const coord_def &c)
 //
 // If fill is non-zero, it fills any disconnected regions with fill.
 //
-static int _process_disconnected_zones(int x1, int y1, int x2, int y2,
-                bool choose_stairless,
+static int _process_disconnected_zones(bool choose_stairless,
                 dungeon_feature_type fill,
                 bool (*passable)(const coord_def &) = _dgn_square_is_passable)
 {
-    memset(travel_point_distance, 0, sizeof(travel_distance_grid_t));
-    int nzones = 0;
+    vector<bool> has_exit_stair;
+    const int nzones =
+        _dgn_label_zones(passable,
+                         choose_stairless ? (at_branch_bottom() ?
+                                             _is_upwards_exit_stair :
+                                             _is_exit_stair) : nullptr,
+                         &has_exit_stair);
+
     int ngood = 0;
-    for (int y = y1; y <= y2 ; ++y)
+    vector<vector<coord_def>> zone_coords;
+    vector<bool> zone_in_vault;
+    for (int zone = 1; zone <= nzones; ++zone)
     {
-        for (int x = x1; x <= x2; ++x)
+        // If we want only stairless zones, screen out zones that did
+        // have stairs.
+        if (choose_stairless && has_exit_stair[zone])
         {
-            if (!map_bounds(x, y)
-                || travel_point_distance[x][y]
-                || !passable(coord_def(x, y)))
-            {
-                continue;
-            }
+            ++ngood;
+            continue;
+        }
+        if (!fill)
+            continue;
 
-            const bool found_exit_stair =
-                _dgn_fill_zone(coord_def(x, y), ++nzones,
-                               _dgn_point_record_stub,
-                               passable,
-                               choose_stairless ? (at_branch_bottom() ?
-                                                   _is_upwards_exit_stair :
-                                                   _is_exit_stair) : nullptr);
-
-            // If we want only stairless zones, screen out zones that did
-            // have stairs.
-            if (choose_stairless && found_exit_stair)
-                ++ngood;
-            else if (fill)
-            {
-                // Don't fill in areas connected to vaults.
-                // We want vaults to be accessible; if the area is disconneted
-                // from the rest of the level, this will cause the level to be
-                // vetoed later on.
-                bool veto = false;
-                vector<coord_def> coords;
-                for (int fy = y1; fy <= y2 ; ++fy)
+        // Collect the squares of every zone in one pass over the level.
+        if (zone_coords.empty())
+        {
+            zone_coords.resize(nzones + 1);
+            zone_in_vault.resize(nzones + 1, false);
+            for (int y = 0; y < GYM; ++y)
+                for (int x = 0; x < GXM; ++x)
                 {
-                    for (int fx = x1; fx <= x2; ++fx)
+                    const int z = travel_point_distance[x][y];
+                    if (!z || zone_in_vault[z])
+                        continue;
+                    if (map_masked(coord_def(x, y), MMT_VAULT))
                     {
-                        if (travel_point_distance[fx][fy] == nzones)
-                        {
-                            if (map_masked(coord_def(fx, fy), MMT_VAULT))
-                            {
-                                veto = true;
-                                break;
-                            }
-                            else
-                                coords.emplace_back(fx, fy);
-                        }
+                        zone_in_vault[z] = true;
+                        zone_coords[z].clear();
                     }
-                    if (veto)
-                        break;
-                }
-                if (!veto)
-                {
-                    for (auto c : coords)
-                        _set_grd(c, fill);
+                    else
+                        zone_coords[z].emplace_back(x, y);
                 }
-            }
+        }
+
+        // Don't fill in areas connected to vaults.
+        // We want vaults to be accessible; if the area is disconneted
+        // from the rest of the level, this will cause the level to be
+        // vetoed later on.
+        if (!zone_in_vault[zone])
+        {
+            for (auto c : zone_coords[zone])
+                _set_grd(c, fill);
         }
     }
 
@@ -1020,8 +1072,7 @@ static int _process_disconnected_zones(int x1, int y1, int x2, int y2,
 int dgn_count_disconnected_zones(bool choose_stairless,
                                  dungeon_feature_type fill)
 {
-    return _process_disconnected_zones(0, 0, GXM-1, GYM-1, choose_stairless,
-                                       fill);
+    return _process_disconnected_zones(choose_stairless, fill);
 }
 
 static void _fixup_hell_stairs()
@@ -1855,88 +1906,77 @@ static bool _fixup_stone_stairs(bool preserve_vault_stairs)
 static bool _add_feat_if_missing(bool (*iswanted)(const coord_def &),
                                  dungeon_feature_type feat)
 {
-    memset(travel_point_distance, 0, sizeof(travel_distance_grid_t));
-    int nzones = 0;
-    for (int y = 0; y < GYM; ++y)
-        for (int x = 0; x < GXM; ++x)
-        {
-            // [ds] Use dgn_square_is_passable instead of
-            // dgn_square_travel_ok here, for we'll otherwise
-            // fail on floorless isolated pocket in vaults (like the
-            // altar surrounded by deep water), and trigger the assert
-            // downstairs.
-            const coord_def gc(x, y);
-            if (!map_bounds(x, y)
-                || travel_point_distance[x][y] // already covered previously
-                || !_dgn_square_is_passable(gc))
-            {
-                continue;
-            }
+    // [ds] Use dgn_square_is_passable instead of
+    // dgn_square_travel_ok here, for we'll otherwise
+    // fail on floorless isolated pocket in vaults (like the
+    // altar surrounded by deep water), and trigger the assert
+    // downstairs.
+    vector<bool> has_wanted;
+    const int nzones = _dgn_label_zones(_dgn_square_is_passable, iswanted,
+                                        &has_wanted);
+    for (int zone = 1; zone <= nzones; ++zone)
+    {
+        if (has_wanted[zone])
+            continue;
 
-            if (_dgn_fill_zone(gc, ++nzones, _dgn_point_record_stub,
-                               _dgn_square_is_passable, iswanted))
+        bool found_feature = false;
+        for (rectangle_iterator ri(0); ri; ++ri)
+        {
+            if (grd(*ri) == feat
+                && travel_point_distance[ri->x][ri->y] == zone)
             {
-                continue;
+                found_feature = true;
+                break;
             }
+        }
 
-            bool found_feature = false;
-            for (rectangle_iterator ri(0); ri; ++ri)
-            {
-                if (grd(*ri) == feat
-                    && travel_point_distance[ri->x][ri->y] == nzones)
-                {
-                    found_feature = true;
-                    break;
-                }
-            }
+        if (found_feature)
+            continue;
 
-            if (found_feature)
+        int i = 0;
+        while (i++ < 2000)
+        {
+            coord_def rnd;
+            rnd.x = random2(GXM);
+            rnd.y = random2(GYM);
+            if (grd(rnd) != DNGN_FLOOR)
                 continue;
 
-            int i = 0;
-            while (i++ < 2000)
-            {
-                coord_def rnd;
-                rnd.x = random2(GXM);
-                rnd.y = random2(GYM);
-                if (grd(rnd) != DNGN_FLOOR)
-                    continue;
+            if (travel_point_distance[rnd.x][rnd.y] != zone)
+                continue;
 
-                if (travel_point_distance[rnd.x][rnd.y] != nzones)
-                    continue;
+            _set_grd(rnd, feat);
+            found_feature = true;
+            break;
+        }
 
-                _set_grd(rnd, feat);
-                found_feature = true;
-                break;
-            }
+        if (found_feature)
+            continue;
 
-            if (found_feature)
+        for (rectangle_iterator ri(0); ri; ++ri)
+        {
+            if (grd(*ri) != DNGN_FLOOR)
                 continue;
 
-            for (rectangle_iterator ri(0); ri; ++ri)
-            {
-                if (grd(*ri) != DNGN_FLOOR)
-                    continue;
-
-                if (travel_point_distance[ri->x][ri->y] != nzones)
-                    continue;
+            if (travel_point_distance[ri->x][ri->y] != zone)
+                continue;
 
-                _set_grd(*ri, feat);
-                found_feature = true;
-                break;
-            }
+            _set_grd(*ri, feat);
+            found_feature = true;
+            break;
+        }
 
-            if (found_feature)
-                continue;
+        if (found_feature)
+            continue;
 
 #ifdef DEBUG_DIAGNOSTICS
-            dump_map("debug.map", true, true);
+        dump_map("debug.map", true, true);
 #endif
-            // [ds] Too many normal cases trigger this ASSERT, including
-            // rivers that surround a stair with deep water.
-            // die("Couldn't find region.");
-            return false;
-        }
+        // [ds] Too many normal cases trigger this ASSERT, including
+        // rivers that surround a stair with deep water.
+        // die("Couldn't find region.");
+        return false;
+    }
 
     return true;
 }
@@ -2409,10 +2449,17 @@ static void _post_vault_build()
 
 static void _build_dungeon_level()
 {
-    bool place_vaults = _builder_by_type();
+    bool place_vaults;
+    {
+        builder_phase_timer timer(BPHASE_PRIMARY);
+        place_vaults = _builder_by_type();
+    }
 
     if (player_in_branch(BRANCH_SLIME))
+    {
+        builder_phase_timer timer(BPHASE_CONNECTIVITY);
         _slime_connectivity_fixup();
+    }
 
     // Now place items, mons, gates, etc.
     // Stairs must exist by this point (except in Shoals where they are
@@ -2428,6 +2475,7 @@ static void _build_dungeon_level()
     if (player_in_branch(BRANCH_DUNGEON)
         && !crawl_state.game_is_tutorial())
     {
+        builder_phase_timer timer(BPHASE_VAULTS);
         _build_overflow_temples();
     }
 
@@ -2435,6 +2483,7 @@ static void _build_dungeon_level()
     // no guarantees, seeing this is a minivault.
     if (crawl_state.game_standard_levelgen())
     {
+        builder_phase_timer vaults_timer(BPHASE_VAULTS);
         if (place_vaults)
         {
             // Moved branch entries to place first so there's a good
@@ -2453,12 +2502,17 @@ static void _build_dungeon_level()
             _place_chance_vaults();
         }
 
+        builder_phase_timer other_timer(BPHASE_OTHER);
+
         // Ruination and plant clumps.
         _post_vault_build();
 
         // XXX: Moved this here from builder_monsters so that
         //      connectivity can be ensured
-        _place_uniques();
+        {
+            builder_phase_timer timer(BPHASE_MONSTERS);
+            _place_uniques();
+        }
 
         if (_mimic_at_level())
             _place_feature_mimics();
@@ -2466,12 +2520,21 @@ static void _build_dungeon_level()
         _place_traps();
 
         // Any vault-placement activity must happen before this check.
-        _dgn_verify_connectivity(nvaults);
+        {
+            builder_phase_timer timer(BPHASE_CONNECTIVITY);
+            _dgn_verify_connectivity(nvaults);
+        }
 
-        _builder_monsters();
+        {
+            builder_phase_timer timer(BPHASE_MONSTERS);
+            _builder_monsters();
+        }
 
         // Place items.
-        _builder_items();
+        {
+            builder_phase_timer timer(BPHASE_ITEMS);
+            _builder_items();
+        }
 
         _fixup_walls();
     }
@@ -3225,6 +3288,7 @@ static bool _builder_normal()
         return vault->orient != MAP_ENCOMPASS;
     }
 
+    builder_phase_timer timer(BPHASE_LAYOUT);
     vault = random_map_for_tag("layout", true, true);
 
     if (!vault)
@@ -4258,13 +4322,13 @@ static const vault_placement *_build_vault_impl(const map_def *vault,
     if (!build_only && (placed_vault_orientation != MAP_ENCOMPASS || is_layout)
         && player_in_branch(BRANCH_SWAMP))
     {
-        _process_disconnected_zones(0, 0, GXM-1, GYM-1, true, DNGN_TREE);
+        _process_disconnected_zones(true, DNGN_TREE);
         // do a second pass to remove tele closets consisting of deep water
         // created by the first pass -- which will not fill in deep water
         // because it is treated as impassable.
         // TODO: get zonify to prevent these?
         // TODO: does this come up anywhere outside of swamp?
-        _process_disconnected_zones(0, 0, GXM-1, GYM-1, true, DNGN_TREE,
+        _process_disconnected_zones(true, DNGN_TREE,
                                     _dgn_square_is_ever_passable);
     }
 
@@ -4294,6 +4358,7 @@ static const vault_placement *_build_vault_impl(const map_def *vault,
 
 static void _build_postvault_level(vault_placement &place)
 {
+    builder_phase_timer timer(BPHASE_LAYOUT);
     if (player_in_branch(BRANCH_SPIDER))
     {
         int ngb_min = 2;
@@ -6531,20 +6596,7 @@ static bool _fixup_interlevel_connectivity()
     has_down[0] = has_down[1] = has_down[2] = false;
 
     // Find up stairs and down stairs on the current level.
-    memset(travel_point_distance, 0, sizeof(travel_distance_grid_t));
-    int nzones = 0;
-    for (rectangle_iterator ri(0); ri; ++ri)
-    {
-        if (!map_bounds(ri->x, ri->y)
-            || travel_point_distance[ri->x][ri->y]
-            || !dgn_square_travel_ok(*ri))
-        {
-            continue;
-        }
-
-        _dgn_fill_zone(*ri, ++nzones, _dgn_point_record_stub,
-                       dgn_square_travel_ok, nullptr);
-    }
+    _dgn_label_zones(dgn_square_travel_ok);
 
     int max_region = 0;
     for (rectangle_iterator ri(0); ri; ++ri)
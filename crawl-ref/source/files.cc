@@ -849,8 +849,27 @@ void write_ghost_version(writer &outf)
         marshallInt(outf, 0);
 }
 
+// Set while pregenerating several levels, so that each one is compressed
+// in the background while the next is built.
+static bool _defer_level_saves = false;
+
 static void _write_tagged_chunk(const string &chunkname, tag_type tag)
 {
+#if PREGEN_COMPRESSION_THREADS
+    if (_defer_level_saves)
+    {
+        vector<unsigned char> buf;
+        {
+            writer outf(&buf);
+            marshallUByte(outf, TAG_MAJOR_VERSION);
+            marshallUByte(outf, TAG_MINOR_VERSION);
+            tag_write(tag, outf);
+        }
+        you.save->write_chunk_deferred(chunkname, move(buf));
+        return;
+    }
+#endif
+
     writer outf(you.save, chunkname);
 
     // write version
@@ -1385,18 +1404,25 @@ void reset_portal_entrances()
             brentry[b] = level_id();
 }
 
-static bool _generate_portal_levels()
+/**
+ * The portal levels that pregeneration builds right after `here`, in the
+ * order it builds them. Only known once `here` has been built.
+ */
+vector<level_id> portal_levels_from(const level_id &here)
 {
-    // find any portals that branch off of the current level.
-    level_id here = level_id::current();
     vector<level_id> to_build;
     for (auto b : portal_generation_order)
         if (brentry[b] == here)
             for (int i = 1; i <= branches[b].numlevels; i++)
                 to_build.push_back(level_id(b, i));
+    return to_build;
+}
 
+static bool _generate_portal_levels()
+{
+    // find any portals that branch off of the current level.
     bool generated = false;
-    for (auto lid : to_build)
+    for (auto lid : portal_levels_from(level_id::current()))
         generated = generate_level(lid) || generated;
     return generated;
 }
@@ -1535,6 +1561,33 @@ static bool _branch_pregenerates(branch_type b)
         branch_generation_order.end(), b) > 0;
 }
 
+/**
+ * The levels of the connected dungeon that pregeneration builds, in the
+ * order it builds them, leaving out portals (see portal_levels_from()) and
+ * the levels that are built afresh on every visit, Pandemonium and
+ * ziggurats. Depends on the branch layout set up for the current game.
+ */
+vector<level_id> pregen_level_order()
+{
+    vector<level_id> order;
+    for (auto br : branch_generation_order)
+    {
+        if (br == NUM_BRANCHES || br == BRANCH_PANDEMONIUM
+            || br == BRANCH_ZIGGURAT)
+        {
+            continue;
+        }
+        // See pregen_dungeon() for the dungeon and vestibule.
+        if (brentry[br].is_valid() || br == BRANCH_DUNGEON
+            || br == BRANCH_VESTIBULE)
+        {
+            for (int i = 1; i <= branches[br].numlevels; i++)
+                order.emplace_back(br, i);
+        }
+    }
+    return order;
+}
+
 /**
 * Generate dungeon branches in a stable order until the level `stopping_point`
 * is found; `stopping_point` will be generated if it doesn't already exist. If
@@ -1621,6 +1674,10 @@ bool pregen_dungeon(const level_id &stopping_point)
         // in normal usage if we get to here, something will generate. But it
         // is possible to call this in a way that doesn't lead to generation.
         bool generated = false;
+        // The levels are still built one at a time, in order: what each
+        // one gets depends on what earlier ones used up (uniques, unique
+        // vaults, unrandarts), so only saving them can overlap.
+        unwind_bool defer_saves(_defer_level_saves, true);
 
         for (const level_id &new_level : to_generate)
         {
@@ -52,6 +52,7 @@
 #include "playable.h"
 #include "player.h"
 #include "prompt.h"
+#include "seed-survey.h"
 #include "slot-select-mode.h"
 #include "species.h"
 #include "spl-util.h"
@@ -3884,6 +3885,9 @@ enum commandline_option_type
     CLO_MAPSTAT_DUMP_DISCONNECT,
     CLO_OBJSTAT,
     CLO_ITERATIONS,
+    CLO_JOBS,
+    CLO_SEED_SURVEY,
+    CLO_SEED_SURVEY_QUERY,
     CLO_FORCE_MAP,
     CLO_ARENA,
     CLO_DUMP_MAPS,
@@ -3924,7 +3928,8 @@ static const char *cmd_ops[] =
 {
     "scores", "name", "species", "background", "dir", "rc", "rcdir", "tscores",
     "vscores", "scorefile", "morgue", "macro", "mapstat", "dump-disconnect",
-    "objstat", "iters", "force-map", "arena", "dump-maps", "test", "script",
+    "objstat", "iters", "jobs", "seed-survey", "seed-survey-query", "force-map",
+    "arena", "dump-maps", "test", "script",
     "builddb", "help", "version", "seed", "pregen", "save-version", "sprint",
     "extra-opt-first", "extra-opt-last", "sprint-map", "edit-save",
     "print-charset", "tutorial", "wizard", "explore", "no-save", "gdb",
@@ -4630,6 +4635,8 @@ bool parse_args(int argc, char **argv, bool rc_only)
 
     SysEnv.rcdirs.clear();
     SysEnv.map_gen_iters = 0;
+    SysEnv.map_gen_jobs = 1;
+    SysEnv.seed_survey_first = SysEnv.seed_survey_last = 0;
 
     if (argc < 2)           // no args!
         return true;
@@ -4807,6 +4814,46 @@ bool parse_args(int argc, char **argv, bool rc_only)
 #endif
             break;
 
+        case CLO_JOBS:
+            // Also for -seed-survey, so not just DEBUG_STATISTICS.
+            if (!next_is_param || !isadigit(*next_arg))
+                end(1, false, "Integer argument required for -%s\n", arg);
+            else
+            {
+                SysEnv.map_gen_jobs = max(1, atoi(next_arg));
+                nextUsed = true;
+            }
+            break;
+
+        case CLO_SEED_SURVEY:
+        {
+            if (!next_is_param)
+                end(1, false, "Seed range required for -%s\n", arg);
+            const int read = sscanf(next_arg, "%" SCNu64 "-%" SCNu64,
+                                    &SysEnv.seed_survey_first,
+                                    &SysEnv.seed_survey_last);
+            if (read < 1)
+                end(1, false, "Bad seed range for -%s: %s\n", arg, next_arg);
+            if (read == 1)
+                SysEnv.seed_survey_last = SysEnv.seed_survey_first;
+            if (SysEnv.seed_survey_last < SysEnv.seed_survey_first)
+                swap(SysEnv.seed_survey_first, SysEnv.seed_survey_last);
+            // Seed 0 asks for a random seed, which can't be surveyed.
+            if (!SysEnv.seed_survey_first)
+                end(1, false, "Seeds for -%s start at 1\n", arg);
+            crawl_state.seed_survey = true;
+#ifdef USE_TILE_LOCAL
+            crawl_state.tiles_disabled = true;
+#endif
+            nextUsed = true;
+            break;
+        }
+
+        case CLO_SEED_SURVEY_QUERY:
+            // Always parse.
+            end(seed_survey_query(argc - current - 1, argv + current + 1)
+                ? 0 : 1);
+
         case CLO_FORCE_MAP:
 #ifdef DEBUG_STATISTICS
             if (!next_is_param)
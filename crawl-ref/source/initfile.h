@@ -58,6 +58,9 @@ public:
     vector<string> cmd_args;
 
     int map_gen_iters;
+    int map_gen_jobs;
+    uint64_t seed_survey_first;
+    uint64_t seed_survey_last;
     unique_ptr<depth_ranges> map_gen_range;
 
     vector<string> extra_opts_first;
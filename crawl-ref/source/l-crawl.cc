@@ -944,6 +944,7 @@ static int crawl_article_a(lua_State *ls)
 LUARET1(crawl_game_started, boolean, crawl_state.need_save
                                      || crawl_state.map_stat_gen
                                      || crawl_state.obj_stat_gen
+                                     || crawl_state.seed_survey
                                      || crawl_state.test)
 /*** Is crawl asking us to choose a stat?
  * @treturn boolean
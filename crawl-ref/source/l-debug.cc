@@ -361,6 +361,7 @@ static const char* disablements[] =
     "afflictions",
     "mon_sight",
     "save_checkpoints",
+    "map_index",
 };
 
 LUAFN(debug_disable)
@@ -30,10 +30,10 @@
  *
  * == Overview ==
  *
- * At first use, the LOS code makes some precomputations,
- * filling a list of all relevant rays in one quadrant,
- * and filling data structures that allow calculating LOS
- * in a quadrant without checking each ray.
+ * At build time, util/gen-los-rays.py makes some precomputations,
+ * listing all relevant rays in one quadrant, and generating
+ * tables (los-rays.h) that allow calculating LOS in a quadrant
+ * without checking each ray.
  *
  * The code provides functions for filling LOS information
  * around a given center efficiently, and for querying rays
@@ -51,494 +51,174 @@
 #include "coord.h"
 #include "coordit.h"
 #include "env.h"
+#include "los-rays.h"
 #include "losglobal.h"
 #include "mon-act.h"
-
-// These determine what rays are cast in the precomputation,
-// and affect start-up time significantly.
-// XXX: Argue that these values are sufficient.
-#define LOS_MAX_ANGLE (2*LOS_MAX_RANGE-2)
-#define LOS_INTERCEPT_MULT (2)
-
-// These store all unique (in terms of footprint) full rays.
-// The footprint of ray=fullray[i] consists of ray.length cells,
-// stored in ray_coords[ray.start..ray.length-1].
-// These are filled during precomputation (_register_ray).
-// XXX: fullrays is not needed anymore after precomputation.
-struct los_ray;
-static vector<los_ray> fullrays;
-static vector<coord_def> ray_coords;
-
-// These store all unique minimal cellrays. For each i,
-// cellray i ends in cellray_ends[i] and passes through
-// thoses cells p that have blockrays(p)[i] set. In other
-// words, blockrays(p)[i] is set iff an opaque cell p blocks
-// the cellray with index i.
-static vector<coord_def> cellray_ends;
-typedef FixedArray<bit_vector*, LOS_MAX_RANGE+1, LOS_MAX_RANGE+1> blockrays_t;
-static blockrays_t blockrays;
-
-// We also store the minimal cellrays by target position
-// for efficient retrieval by find_ray.
-// XXX: Consider condensing this representation.
-struct cellray;
-static FixedArray<vector<cellray>, LOS_MAX_RANGE+1, LOS_MAX_RANGE+1> min_cellrays;
-
-// Temporary arrays used in losight() to track which rays
-// are blocked or have seen a smoke cloud.
-// Allocated when doing the precomputations.
-static bit_vector *dead_rays     = nullptr;
-static bit_vector *smoke_rays    = nullptr;
-
-class quadrant_iterator : public rectangle_iterator
-{
-public:
-    quadrant_iterator()
-        : rectangle_iterator(coord_def(0,0),
-                             coord_def(LOS_MAX_RANGE, LOS_MAX_RANGE))
+#include "mon-pathfind.h"
+#include "mon-util.h"
+#include "state.h"
+#if LOS_THREADS > 1
+#include "threads.h"
+#endif
+
+// A set of cells in the first quadrant, one bit per cell, so that
+// losight() can test a cellray against a whole quadrant's opacity
+// a 64-bit word at a time.
+#define LOS_QUADRANT_SIZE (LOS_MAX_RANGE+1)
+#define LOS_QUADRANT_CELLS (LOS_QUADRANT_SIZE * LOS_QUADRANT_SIZE)
+#define LOS_MASK_WORDS ((LOS_QUADRANT_CELLS + 63) / 64)
+COMPILE_CHECK(LOS_QUADRANT_SIZE < 16);
+
+struct los_mask
+{
+    uint64_t w[LOS_MASK_WORDS];
+
+    void reset()
     {
+        for (int i = 0; i < LOS_MASK_WORDS; ++i)
+            w[i] = 0;
     }
-};
-
-void clear_rays_on_exit()
-{
-    delete dead_rays;
-    delete smoke_rays;
-    for (quadrant_iterator qi; qi; ++qi)
-        delete blockrays(*qi);
-}
-
-// LOS radius.
-int los_radius = LOS_DEFAULT_RANGE;
-
-static void _handle_los_change();
-
-void set_los_radius(int r)
-{
-    ASSERT(r <= LOS_RADIUS);
-    los_radius = r;
-    invalidate_los();
-    _handle_los_change();
-}
 
-int get_los_radius()
-{
-    return los_radius;
-}
-
-bool double_is_zero(const double x)
-{
-    return x > -EPSILON_VALUE && x < EPSILON_VALUE;
-}
-
-struct los_ray : public ray_def
-{
-    // The footprint of this ray is stored in
-    // ray_coords[start..start+length-1].
-    unsigned int start;
-    unsigned int length;
-
-    los_ray(geom::ray _r)
-        : ray_def(_r), start(0), length(0)
+    static int index(const coord_def& p)
     {
+        return p.y * LOS_QUADRANT_SIZE + p.x;
     }
 
-    // Shoot a ray from the given start point (accx, accy) with the given
-    // slope, bounded by the pre-calc bounds shape.
-    // Returns the cells it travels through, excluding the origin.
-    // Returns an empty vector if this was a bad ray.
-    vector<coord_def> footprint()
+    bool get(int i) const
     {
-        vector<coord_def> cs;
-        los_ray copy = *this;
-        coord_def c;
-        coord_def old;
-        int cellnum;
-        for (cellnum = 0; true; ++cellnum)
-        {
-            old = c;
-            if (!copy.advance())
-            {
-//                dprf("discarding corner ray (%f,%f) + t*(%f,%f)",
-//                     r.start.x, r.start.y, r.dir.x, r.dir.y);
-                cs.clear();
-                break;
-            }
-            c = copy.pos();
-            if (c.rdist() > LOS_RADIUS)
-                break;
-            cs.push_back(c);
-            ASSERT((c - old).rdist() == 1);
-        }
-        return cs;
+        return w[i / 64] & (1ULL << (i % 64));
     }
 
-    coord_def operator[](unsigned int i)
+    void set(int i)
     {
-        ASSERT(i < length);
-        return ray_coords[start+i];
+        w[i / 64] |= 1ULL << (i % 64);
     }
-};
 
-// Check if the passed rays have identical footprint.
-static bool _is_same_ray(los_ray ray, vector<coord_def> newray)
-{
-    if (ray.length != newray.size())
-        return false;
-    for (unsigned int i = 0; i < ray.length; i++)
-        if (ray[i] != newray[i])
-            return false;
-    return true;
-}
-
-// Check if the passed ray has already been created.
-static bool _is_duplicate_ray(vector<coord_def> newray)
-{
-    for (los_ray lray : fullrays)
-        if (_is_same_ray(lray, newray))
-            return true;
-    return false;
-}
-
-// A cellray given by fullray and index of end-point.
-struct cellray
-{
-    // A cellray passes through cells ray_coords[ray.start..ray.start+end].
-    los_ray ray;
-    unsigned int end; // Relative index (inside ray) of end cell.
-
-    cellray(const los_ray& r, unsigned int e)
-        : ray(r), end(e), imbalance(-1), first_diag(false)
+    // Set the LOS_QUADRANT_SIZE cells of row y from the low bits of row.
+    void set_row(int y, uint64_t row)
     {
+        const int i = y * LOS_QUADRANT_SIZE;
+        w[i / 64] |= row << (i % 64);
+        if (i % 64 + LOS_QUADRANT_SIZE > 64)
+            w[i / 64 + 1] |= row >> (64 - i % 64);
     }
 
-    // The end-point's index inside ray_coord.
-    int index() const { return ray.start + end; }
-
-    // The end-point.
-    coord_def target() const { return ray_coords[index()]; }
-
-    // XXX: Currently ray/cellray[0] is the first point outside the origin.
-    coord_def operator[](unsigned int i)
+    los_mask& operator&=(const los_mask& other)
     {
-        ASSERT(i <= end);
-        return ray_coords[ray.start+i];
+        for (int i = 0; i < LOS_MASK_WORDS; ++i)
+            w[i] &= other.w[i];
+        return *this;
     }
 
-    // Parameters used in find_ray. These need to be calculated
-    // only for the minimal cellrays.
-    int imbalance;
-    bool first_diag;
-
-    void calc_params();
-};
-
-// Compare two cellrays to the same target.
-// This determines which ray is considered better by find_ray,
-// used with list::sort.
-// Returns true if a is strictly better than b, false else.
-static bool _is_better(const cellray& a, const cellray& b)
-{
-    // Only compare cellrays with equal target.
-    ASSERT(a.target() == b.target());
-    // calc_params() has been called.
-    ASSERT(a.imbalance >= 0);
-    ASSERT(b.imbalance >= 0);
-    if (a.imbalance < b.imbalance)
-        return true;
-    else if (a.imbalance > b.imbalance)
-        return false;
-    else
-        return a.first_diag && !b.first_diag;
-}
-
-enum class compare_type
-{
-    neither,
-    subray,
-    superray,
-};
-
-// Check whether one of the passed cellrays is a subray of the
-// other in terms of footprint.
-static compare_type _compare_cellrays(const cellray& a, const cellray& b)
-{
-    if (a.target() != b.target())
-        return compare_type::neither;
-
-    int cura = a.ray.start;
-    int curb = b.ray.start;
-    int enda = cura + a.end;
-    int endb = curb + b.end;
-    bool maybe_sub = true;
-    bool maybe_super = true;
-
-    while (cura < enda && curb < endb && (maybe_sub || maybe_super))
+    // Call f(i) for each cell i in the mask, in increasing order.
+    template<class F> void for_each(F f) const
     {
-        coord_def pa = ray_coords[cura];
-        coord_def pb = ray_coords[curb];
-        if (pa.x > pb.x || pa.y > pb.y)
-        {
-            maybe_super = false;
-            curb++;
-        }
-        if (pa.x < pb.x || pa.y < pb.y)
-        {
-            maybe_sub = false;
-            cura++;
-        }
-        if (pa == pb)
-        {
-            cura++;
-            curb++;
-        }
+        for (int i = 0; i < LOS_MASK_WORDS; ++i)
+            for (uint64_t bits = w[i]; bits; bits &= bits - 1)
+                f(i * 64 + _lowest_bit(bits));
     }
-    maybe_sub = maybe_sub && cura == enda;
-    maybe_super = maybe_super && curb == endb;
 
-    if (maybe_sub)
-        return compare_type::subray;    // includes equality
-    else if (maybe_super)
-        return compare_type::superray;
-    else
-        return compare_type::neither;
-}
-
-// Determine all minimal cellrays.
-// They're stored globally by target in min_cellrays,
-// and returned as a list of indices into ray_coords.
-static vector<int> _find_minimal_cellrays()
-{
-    FixedArray<list<cellray>, LOS_MAX_RANGE+1, LOS_MAX_RANGE+1> minima;
-    list<cellray>::iterator min_it;
-
-    for (los_ray ray : fullrays)
+private:
+    static int _lowest_bit(uint64_t bits)
     {
-        for (unsigned int i = 0; i < ray.length; ++i)
+        // de Bruijn sequence lookup
+        static const int index64[64] =
         {
-            // Is the cellray ray[0..i] duplicated so far?
-            bool dup = false;
-            cellray c(ray, i);
-            list<cellray>& min = minima(c.target());
-
-            bool erased = false;
-            for (min_it = min.begin();
-                 min_it != min.end() && !dup;)
-            {
-                switch (_compare_cellrays(*min_it, c))
-                {
-                case compare_type::subray:
-                    dup = true;
-                    break;
-                case compare_type::superray:
-                    min_it = min.erase(min_it);
-                    erased = true;
-                    // clear this should be added, but might have
-                    // to erase more
-                    break;
-                case compare_type::neither:
-                default:
-                    break;
-                }
-                if (!erased)
-                    ++min_it;
-                else
-                    erased = false;
-            }
-            if (!dup)
-                min.push_back(c);
-        }
+             0,  1, 48,  2, 57, 49, 28,  3, 61, 58, 50, 42, 38, 29, 17,  4,
+            62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12,  5,
+            63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+            46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19,  9, 13,  8,  7,  6,
+        };
+        return index64[((bits & (~bits + 1)) * 0x03f79d71b4cb0a89ULL) >> 58];
     }
+};
 
-    vector<int> result;
-    for (quadrant_iterator qi; qi; ++qi)
-    {
-        list<cellray>& min = minima(*qi);
-        for (min_it = min.begin(); min_it != min.end(); ++min_it)
-        {
-            // Calculate imbalance and slope difference for sorting.
-            min_it->calc_params();
-            result.push_back(min_it->index());
-        }
-        min.sort(_is_better);
-        min_cellrays(*qi) = vector<cellray>(min.begin(), min.end());
-    }
-    return result;
-}
-
-// Create and register the ray defined by the arguments.
-static void _register_ray(geom::ray r)
-{
-    los_ray ray = los_ray(r);
-    vector<coord_def> coords = ray.footprint();
-
-    if (coords.empty() || _is_duplicate_ray(coords))
-        return;
-
-    ray.start = ray_coords.size();
-    ray.length = coords.size();
-    for (coord_def c : coords)
-        ray_coords.push_back(c);
-    fullrays.push_back(ray);
-}
+// The ray tables are generated at build time by util/gen-los-rays.py.
+// For each quadrant cell p, los_blockrays[los_mask::index(p)] has
+// bit i set iff p lies on (thus blocks) minimal cellray i. The
+// cellrays are ordered by end cell: those ending in the cell with
+// los_mask index i are los_first_cellray[i] .. los_first_cellray[i+1]-1,
+// best first for find_ray.
+COMPILE_CHECK(LOS_RAYS_RANGE == LOS_MAX_RANGE);
+
+// Packed opacity maps, one for each opacity function that only
+// depends on terrain, clouds and monsters (see opacity_map_type).
+// Each stores the terrain and cloud part of the opacity, one bit
+// per cell in rows of 64-bit words; they're kept up to date by
+// los_terrain_changed() and rebuilt on demand after los_changed().
+// Monster opacity is read from mgrd when a map is used, since
+// mgrd is written from too many places to track here.
+#define LOS_ROW_WORDS ((GXM + 63) / 64)
+struct opacity_map
+{
+    bool valid;
+    uint64_t opaque[GYM][LOS_ROW_WORDS];
+    uint64_t half[GYM][LOS_ROW_WORDS];
+};
+static opacity_map opacity_maps[NUM_OPACITY_MAPS];
+
+// Results of find_ray for the opacity functions with a packed map.
+// Those only change with terrain, clouds and sight-blocking monsters,
+// each of which starts a new LOS epoch; an entry is only valid during
+// the epoch it was computed in.
+#define RAY_CACHE_SIZE 512
+struct ray_cache_entry
+{
+    uint32_t epoch;
+    coord_def source;
+    coord_def target;
+    int range;
+    int cycle_from;       // ray.cycle_idx if cycling, else -1
+    opacity_map_type map;
+    bool found;
+    ray_def ray;
+};
+static ray_cache_entry ray_cache[RAY_CACHE_SIZE];
+static uint32_t los_epoch = 1;
+static los_cache_stats ray_stats;
 
-static void _create_blockrays()
+static void _new_los_epoch()
 {
-    // First, we calculate blocking information for all cell rays.
-    // Cellrays are numbered according to the index of their end
-    // cell in ray_coords.
-    const int n_cellrays = ray_coords.size();
-    blockrays_t all_blockrays;
-    for (quadrant_iterator qi; qi; ++qi)
-        all_blockrays(*qi) = new bit_vector(n_cellrays);
-
-    for (los_ray ray : fullrays)
-    {
-        for (unsigned int i = 0; i < ray.length; ++i)
-        {
-            // Every cell is contained in (thus blocks)
-            // all following cellrays.
-            for (unsigned int j = i + 1; j < ray.length; ++j)
-                all_blockrays(ray[i])->set(ray.start + j);
-        }
-    }
-
-    // We've built the basic blockray array; now compress it, keeping
-    // only the nonduplicated cellrays.
-
-    // Determine minimal cellrays and store their indices in ray_coords.
-    vector<int> min_indices = _find_minimal_cellrays();
-    const int n_min_rays    = min_indices.size();
-    cellray_ends.resize(n_min_rays);
-    for (int i = 0; i < n_min_rays; ++i)
-        cellray_ends[i] = ray_coords[min_indices[i]];
-
-    // Compress blockrays accordingly.
-    for (quadrant_iterator qi; qi; ++qi)
+    if (++los_epoch == 0)
     {
-        blockrays(*qi) = new bit_vector(n_min_rays);
-        for (int i = 0; i < n_min_rays; ++i)
-        {
-            blockrays(*qi)->set(i, all_blockrays(*qi)
-                                   ->get(min_indices[i]));
-        }
+        for (ray_cache_entry &entry : ray_cache)
+            entry.epoch = 0;
+        los_epoch = 1;
     }
-
-    // We can throw away all_blockrays now.
-    for (quadrant_iterator qi; qi; ++qi)
-        delete all_blockrays(*qi);
-
-    dead_rays  = new bit_vector(n_min_rays);
-    smoke_rays = new bit_vector(n_min_rays);
-
-    dprf("Cellrays: %d Fullrays: %u Minimal cellrays: %u",
-          n_cellrays, (unsigned int)fullrays.size(), n_min_rays);
+    ray_stats.invalidations++;
 }
 
-static int _gcd(int x, int y)
+class quadrant_iterator : public rectangle_iterator
 {
-    int tmp;
-    while (y != 0)
+public:
+    quadrant_iterator()
+        : rectangle_iterator(coord_def(0,0),
+                             coord_def(LOS_MAX_RANGE, LOS_MAX_RANGE))
     {
-        x %= y;
-        tmp = x;
-        x = y;
-        y = tmp;
     }
-    return x;
-}
-
-static bool _complexity_lt(const pair<int,int>& lhs, const pair<int,int>& rhs)
-{
-    return lhs.first * lhs.second < rhs.first * rhs.second;
-}
-
-// Cast all rays
-static void raycast()
-{
-    static bool done_raycast = false;
-    if (done_raycast)
-        return;
-
-    // Creating all rays for first quadrant
-    // We have a considerable amount of overkill.
-    done_raycast = true;
-
-    // register perpendiculars FIRST, to make them top choice
-    // when selecting beams
-    _register_ray(geom::ray(0.5, 0.5, 0.0, 1.0));
-    _register_ray(geom::ray(0.5, 0.5, 1.0, 0.0));
-
-    // For a slope of M = y/x, every x we move on the X axis means
-    // that we move y on the y axis. We want to look at the resolution
-    // of x/y: in that case, every step on the X axis means an increase
-    // of 1 in the Y axis at the intercept point. We can assume gcd(x,y)=1,
-    // so we look at steps of 1/y.
-
-    // Changing the order a bit. We want to order by the complexity
-    // of the beam, which is log(x) + log(y) ~ xy.
-    vector<pair<int,int> > xyangles;
-    for (int xangle = 1; xangle <= LOS_MAX_ANGLE; ++xangle)
-        for (int yangle = 1; yangle <= LOS_MAX_ANGLE; ++yangle)
-        {
-            if (_gcd(xangle, yangle) == 1)
-                xyangles.emplace_back(xangle, yangle);
-        }
-
-    sort(xyangles.begin(), xyangles.end(), _complexity_lt);
-    for (auto xyangle : xyangles)
-    {
-        const int xangle = xyangle.first;
-        const int yangle = xyangle.second;
+};
 
-        for (int intercept = 1; intercept < LOS_INTERCEPT_MULT*yangle; ++intercept)
-        {
-            double xstart = ((double)intercept) / (LOS_INTERCEPT_MULT*yangle);
-            double ystart = 0.5;
+// LOS radius.
+int los_radius = LOS_DEFAULT_RANGE;
 
-            _register_ray(geom::ray(xstart, ystart, xangle, yangle));
-            // also draw the identical ray in octant 2
-            _register_ray(geom::ray(ystart, xstart, yangle, xangle));
-        }
-    }
+static void _handle_los_change();
 
-    // Now create the appropriate blockrays array
-    _create_blockrays();
+void set_los_radius(int r)
+{
+    ASSERT(r <= LOS_RADIUS);
+    los_radius = r;
+    invalidate_los();
+    _handle_los_change();
 }
 
-static int _imbalance(ray_def ray, const coord_def& target)
+int get_los_radius()
 {
-    int imb = 0;
-    int diags = 0, straights = 0;
-    while (ray.pos() != target)
-    {
-        coord_def old = ray.pos();
-        if (!ray.advance())
-            die("can't advance ray");
-        switch ((ray.pos() - old).abs())
-        {
-        case 1:
-            diags = 0;
-            if (++straights > imb)
-                imb = straights;
-            break;
-        case 2:
-            straights = 0;
-            if (++diags > imb)
-                imb = diags;
-            break;
-        default:
-            die("ray imbalance out of range");
-        }
-    }
-    return imb;
+    return los_radius;
 }
 
-void cellray::calc_params()
+bool double_is_zero(const double x)
 {
-    coord_def trg = target();
-    imbalance = _imbalance(ray, trg);
-    first_diag = ((*this)[0].abs() == 2);
+    return x > -EPSILON_VALUE && x < EPSILON_VALUE;
 }
 
 // Find ray in positive quadrant.
@@ -555,35 +235,37 @@ static bool _find_ray_se(const coord_def& target, ray_def& ray,
 
     ASSERT(target.rdist() <= LOS_RADIUS);
 
-    // Ensure the precalculations have been done.
-    raycast();
-
-    const vector<cellray> &min = min_cellrays(target);
-    ASSERT(!min.empty());
-    cellray c = min[0]; // XXX: const cellray &c ?
+    // The minimal cellrays ending in target, best first.
+    const int first = los_first_cellray[los_mask::index(target)];
+    const unsigned int count = los_first_cellray[los_mask::index(target) + 1]
+                               - first;
+    ASSERT(count > 0);
+    const los_cellray *c = &los_cellrays[first];
     unsigned int index = 0;
 
     if (cycle)
-        dprf("cycling from %d (total %u)", ray.cycle_idx, (unsigned int)min.size());
+        dprf("cycling from %d (total %u)", ray.cycle_idx, count);
 
     unsigned int start = cycle ? ray.cycle_idx + 1 : 0;
-    ASSERT(start <= min.size());
+    ASSERT(start <= count);
 
     int blocked = OPC_OPAQUE;
     for (unsigned int i = start;
-         (blocked >= OPC_OPAQUE) && (i < start + min.size()); i++)
+         (blocked >= OPC_OPAQUE) && (i < start + count); i++)
     {
-        index = i % min.size();
-        c = min[index];
+        index = i % count;
+        c = &los_cellrays[first + index];
+        const int8_t (*cells)[2] = &los_ray_coords[los_fullrays[c->ray].start];
         blocked = OPC_CLEAR;
         // Check all inner points.
-        for (unsigned int j = 0; j < c.end && blocked < OPC_OPAQUE; j++)
-            blocked += opc(c[j]);
+        for (int j = 0; j < c->end && blocked < OPC_OPAQUE; j++)
+            blocked += opc(coord_def(cells[j][0], cells[j][1]));
     }
     if (blocked >= OPC_OPAQUE)
         return false;
 
-    ray = c.ray;
+    const los_fullray &full = los_fullrays[c->ray];
+    ray = ray_def(geom::ray(full.x, full.y, full.dx, full.dy));
     ray.cycle_idx = index;
 
     return true;
@@ -621,9 +303,9 @@ struct opacity_trans : public opacity_func
 // If cycle is false, find the first fitting ray. If it is true,
 // assume that ray is appropriately filled in, and look for the next
 // ray. We only ever use ray.cycle_idx.
-bool find_ray(const coord_def& source, const coord_def& target,
-              ray_def& ray, const opacity_func& opc, int range,
-              bool cycle)
+static bool _find_ray(const coord_def& source, const coord_def& target,
+                      ray_def& ray, const opacity_func& opc, int range,
+                      bool cycle)
 {
     if (target == source || !map_bounds(source) || !map_bounds(target))
         return false;
@@ -651,6 +333,80 @@ bool find_ray(const coord_def& source, const coord_def& target,
     return true;
 }
 
+#ifdef DEBUG_LOS
+static bool _same_ray(const ray_def& a, const ray_def& b)
+{
+    return a.r.start.x == b.r.start.x && a.r.start.y == b.r.start.y
+           && a.r.dir.x == b.r.dir.x && a.r.dir.y == b.r.dir.y
+           && a.on_corner == b.on_corner && a.cycle_idx == b.cycle_idx;
+}
+#endif
+
+// Find a nonblocked ray from source to target. Return false if no
+// such ray could be found, otherwise return true and fill ray
+// appropriately.
+// if range is too great or all rays are blocked.
+// If cycle is false, find the first fitting ray. If it is true,
+// assume that ray is appropriately filled in, and look for the next
+// ray. We only ever use ray.cycle_idx.
+bool find_ray(const coord_def& source, const coord_def& target,
+              ray_def& ray, const opacity_func& opc, int range,
+              bool cycle)
+{
+    // The builder changes terrain without telling us.
+    const opacity_map_type map = opc.packed_map();
+    if (map == OMAP_NONE || crawl_state.generating_level)
+        return _find_ray(source, target, ray, opc, range, cycle);
+
+    const int cycle_from = cycle ? ray.cycle_idx : -1;
+    const unsigned int hash = ((source.y * GXM + source.x) * 61
+                               + target.y * GXM + target.x) * 7
+                              + map + 131 * (cycle_from + 1);
+    ray_cache_entry &entry = ray_cache[hash % RAY_CACHE_SIZE];
+
+    if (entry.epoch == los_epoch && entry.source == source
+        && entry.target == target && entry.map == map
+        && entry.range == range && entry.cycle_from == cycle_from)
+    {
+        ray_stats.hits++;
+#ifdef DEBUG_LOS
+        ray_def check = ray;
+        const bool found = _find_ray(source, target, check, opc, range,
+                                     cycle);
+        if (found != entry.found || found && !_same_ray(check, entry.ray))
+        {
+            die("cached ray mismatch (map %d) from (%d,%d) to (%d,%d)",
+                map, source.x, source.y, target.x, target.y);
+        }
+#endif
+        if (entry.found)
+            ray = entry.ray;
+        return entry.found;
+    }
+
+    ray_stats.misses++;
+    entry.epoch = los_epoch;
+    entry.source = source;
+    entry.target = target;
+    entry.range = range;
+    entry.cycle_from = cycle_from;
+    entry.map = map;
+    entry.found = _find_ray(source, target, ray, opc, range, cycle);
+    if (entry.found)
+        entry.ray = ray;
+    return entry.found;
+}
+
+const los_cache_stats& get_ray_cache_stats()
+{
+    return ray_stats;
+}
+
+uint32_t get_los_epoch()
+{
+    return los_epoch;
+}
+
 bool exists_ray(const coord_def& source, const coord_def& target,
                 const opacity_func& opc, int range)
 {
@@ -758,7 +514,7 @@ bool cell_see_cell_nocache(const coord_def& p1, const coord_def& p2)
 }
 
 // We use raycasting. The algorithm:
-// PRECOMPUTATION:
+// PRECOMPUTATION (util/gen-los-rays.py, at build time):
 // Create a large bundle of rays and cast them.
 // Mark, for each one, which cells kill it (and where.)
 // Also, for each one, note which cells it passes.
@@ -784,57 +540,15 @@ bool cell_see_cell_nocache(const coord_def& p1, const coord_def& p2)
 // PERFORMANCE:
 // With reasonable values we have around 6000 cellrays, meaning
 // around 600Kb (75 KB) of data. This gets cut down to 700 cellrays
-// after removing duplicates. That means that we need to do
-// around 22*100*4 ~ 9,000 memory reads + writes per LOS call on a
-// 32-bit system. Not too bad.
+// after removing duplicates. A quadrant's opacity is gathered into
+// 81-bit cell masks, read a row at a time from the packed opacity
+// maps for the usual opacity functions, so that only the opaque
+// cells have to be visited to kill rays, a handful of 64-bit ORs
+// each. The cellrays are sorted by end cell, so whether a cell is
+// visible is a masked test of a few words of the dead rays.
 // IMPROVEMENTS:
 // Smoke will now only block LOS after two cells of smoke. This is
-// done by updating with a second array.
-
-static void _losight_quadrant(los_grid& sh, const los_param& dat, int sx, int sy)
-{
-    const unsigned int num_cellrays = cellray_ends.size();
-
-    dead_rays->reset();
-    smoke_rays->reset();
-
-    for (quadrant_iterator qi; qi; ++qi)
-    {
-        coord_def p = coord_def(sx*(qi->x), sy*(qi->y));
-        if (!dat.los_bounds(p))
-            continue;
-
-        switch (dat.opacity(p))
-        {
-        case OPC_OPAQUE:
-            // Block the appropriate rays.
-            *dead_rays |= *blockrays(*qi);
-            break;
-        case OPC_HALF:
-            // Block rays which have already seen a cloud.
-            *dead_rays  |= (*smoke_rays & *blockrays(*qi));
-            *smoke_rays |= *blockrays(*qi);
-            break;
-        default:
-            break;
-        }
-    }
-
-    // Ray calculation done. Now work out which cells in this
-    // quadrant are visible.
-    for (unsigned int rayidx = 0; rayidx < num_cellrays; ++rayidx)
-    {
-        // make the cells seen by this ray at this point visible
-        if (!dead_rays->get(rayidx))
-        {
-            // This ray is alive, thus the end cell is visible.
-            const coord_def p = coord_def(sx * cellray_ends[rayidx].x,
-                                          sy * cellray_ends[rayidx].y);
-            if (dat.los_bounds(p))
-                sh(p) = true;
-        }
-    }
-}
+// done by keeping a second mask of half-opaque cells.
 
 struct los_param_funcs : public los_param
 {
@@ -859,15 +573,211 @@ struct los_param_funcs : public los_param
     }
 };
 
-void losight(los_grid& sh, const coord_def& center,
-             const opacity_func& opc, const circle_def& bounds)
+static void _set_map_opacity(opacity_map& map, opacity_map_type type,
+                             const coord_def& p)
 {
-    const los_param& dat = los_param_funcs(center, opc, bounds);
+    const uint64_t bit = 1ULL << (p.x % 64);
+    uint64_t &opaque = map.opaque[p.y][p.x / 64];
+    uint64_t &half = map.half[p.y][p.x / 64];
+    opaque &= ~bit;
+    half &= ~bit;
+    switch (packed_opacity(type, p))
+    {
+    case OPC_OPAQUE:
+        opaque |= bit;
+        break;
+    case OPC_HALF:
+        half |= bit;
+        break;
+    default:
+        break;
+    }
+}
 
-    sh.init(false);
+static const opacity_map& _opacity_map(opacity_map_type type)
+{
+    opacity_map &map = opacity_maps[type];
+    if (!map.valid)
+    {
+        for (rectangle_iterator ri(0); ri; ++ri)
+            _set_map_opacity(map, type, *ri);
+        map.valid = true;
+    }
+    return map;
+}
+
+// The cells x0..x0+LOS_QUADRANT_SIZE-1 of a packed opacity map row,
+// as the low bits of the result. Cells off the map are clear.
+static uint64_t _map_row_bits(const uint64_t *row, int x0)
+{
+    const int lo = max(x0, 0);
+    const int hi = min(x0 + LOS_QUADRANT_SIZE, GXM);
+    if (lo >= hi)
+        return 0;
+
+    const int n = hi - lo;
+    const int b = lo % 64;
+    uint64_t bits = row[lo / 64] >> b;
+    if (b + n > 64)
+        bits |= row[lo / 64 + 1] << (64 - b);
+    bits &= (1ULL << n) - 1;
+    return bits << (lo - x0);
+}
+
+// Fill opaque and half with the opaque and half-opaque cells of the
+// quadrant (sx, sy), restricted to the in-bounds cells inb.
+static void _quadrant_opacity(const los_param_funcs& dat, int sx, int sy,
+                              const los_mask& inb,
+                              los_mask& opaque, los_mask& half)
+{
+    opaque.reset();
+    half.reset();
+
+    const opacity_map_type type = dat.opc.packed_map();
+    // The builder changes terrain behind the maps' back, and only calls
+    // los_changed() once it's done.
+    if (type == OMAP_NONE || crawl_state.generating_level)
+    {
+        for (int y = 0, i = 0; y < LOS_QUADRANT_SIZE; ++y)
+            for (int x = 0; x < LOS_QUADRANT_SIZE; ++x, ++i)
+            {
+                if (!inb.get(i))
+                    continue;
+
+                switch (dat.opacity(coord_def(sx * x, sy * y)))
+                {
+                case OPC_OPAQUE:
+                    opaque.set(i);
+                    break;
+                case OPC_HALF:
+                    half.set(i);
+                    break;
+                default:
+                    break;
+                }
+            }
+        return;
+    }
+
+    const opacity_map &map = _opacity_map(type);
+    const coord_def c = dat.center;
+    const int x0 = sx > 0 ? c.x : c.x - LOS_MAX_RANGE;
+    for (int qy = 0; qy < LOS_QUADRANT_SIZE; ++qy)
+    {
+        const int y = c.y + sy * qy;
+        if (y < 0 || y >= GYM)
+            continue;
+
+        uint64_t orow = _map_row_bits(map.opaque[y], x0);
+        uint64_t hrow = _map_row_bits(map.half[y], x0);
+        if (sx < 0)
+        {
+            orow = los_reversed_rows[orow];
+            hrow = los_reversed_rows[hrow];
+        }
+        opaque.set_row(qy, orow);
+        half.set_row(qy, hrow);
+    }
+    opaque &= inb;
+    half &= inb;
+
+    const los_type mons_los = packed_opacity_mons(type);
+    if (mons_los == LOS_NONE)
+        return;
+
+    // Monsters only matter on cells the terrain leaves clear.
+    for (int y = 0, i = 0; y < LOS_QUADRANT_SIZE; ++y)
+        for (int x = 0; x < LOS_QUADRANT_SIZE; ++x, ++i)
+        {
+            const coord_def p(c.x + sx * x, c.y + sy * y);
+            if (!inb.get(i) || opaque.get(i) || half.get(i)
+                || mgrd(p) == NON_MONSTER)
+            {
+                continue;
+            }
+
+            if (const monster *mon = monster_at(p))
+            {
+                switch (mons_opacity(mon, mons_los))
+                {
+                case OPC_OPAQUE:
+                    opaque.set(i);
+                    break;
+                case OPC_HALF:
+                    half.set(i);
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+}
+
+// Is any of the cellrays first..last-1 not in dead?
+static bool _any_alive(const uint64_t *dead, int first, int last)
+{
+    for (int i = first; i < last; i = (i / 64 + 1) * 64)
+    {
+        uint64_t alive = ~dead[i / 64] & (~0ULL << (i % 64));
+        if (last < (i / 64 + 1) * 64)
+            alive &= ~(~0ULL << (last % 64));
+        if (alive)
+            return true;
+    }
+    return false;
+}
+
+static void _losight_quadrant(los_grid& sh, const los_param_funcs& dat,
+                              int sx, int sy)
+{
+    los_mask inb;
+    inb.reset();
+    for (int y = 0, i = 0; y < LOS_QUADRANT_SIZE; ++y)
+        for (int x = 0; x < LOS_QUADRANT_SIZE; ++x, ++i)
+            if (dat.los_bounds(coord_def(sx * x, sy * y)))
+                inb.set(i);
 
-    // Do precomputations if necessary.
-    raycast();
+    los_mask opaque, half;
+    _quadrant_opacity(dat, sx, sy, inb, opaque, half);
+
+    // Track which rays are blocked or have seen a smoke cloud.
+    uint64_t dead_rays[LOS_RAY_WORDS] = { 0 };
+    uint64_t smoke_rays[LOS_RAY_WORDS] = { 0 };
+
+    // Block the appropriate rays.
+    opaque.for_each([&](int i)
+    {
+        const uint64_t *block = &los_blockrays[i][0];
+        for (int w = 0; w < LOS_RAY_WORDS; ++w)
+            dead_rays[w] |= block[w];
+    });
+    // Block rays which have already seen a cloud.
+    half.for_each([&](int i)
+    {
+        const uint64_t *block = &los_blockrays[i][0];
+        for (int w = 0; w < LOS_RAY_WORDS; ++w)
+        {
+            dead_rays[w]  |= smoke_rays[w] & block[w];
+            smoke_rays[w] |= block[w];
+        }
+    });
+
+    // Ray calculation done. Now work out which cells in this
+    // quadrant are visible: those with an alive ray ending there.
+    inb.for_each([&](int i)
+    {
+        if (_any_alive(dead_rays, los_first_cellray[i],
+                       los_first_cellray[i + 1]))
+        {
+            sh(coord_def(sx * (i % LOS_QUADRANT_SIZE),
+                         sy * (i / LOS_QUADRANT_SIZE))) = true;
+        }
+    });
+}
+
+static void _losight(los_grid& sh, const los_param_funcs& dat)
+{
+    sh.init(false);
 
     const int quadrant_x[4] = {  1, -1, -1,  1 };
     const int quadrant_y[4] = {  1,  1, -1, -1 };
@@ -879,6 +789,140 @@ void losight(los_grid& sh, const coord_def& center,
     sh(o) = true;
 }
 
+#ifdef DEBUG_LOS
+// Wraps an opacity function, hiding its packed map.
+struct opacity_unpacked : public opacity_func
+{
+    const opacity_func& orig;
+
+    opacity_unpacked(const opacity_func& opc) : orig(opc) {}
+
+    CLONE(opacity_unpacked)
+
+    opacity_type operator()(const coord_def& p) const override
+    {
+        return orig(p);
+    }
+};
+#endif
+
+void losight(los_grid& sh, const coord_def& center,
+             const opacity_func& opc, const circle_def& bounds)
+{
+    _losight(sh, los_param_funcs(center, opc, bounds));
+
+#ifdef DEBUG_LOS
+    if (opc.packed_map() != OMAP_NONE)
+    {
+        const opacity_unpacked unpacked(opc);
+        los_grid check;
+        _losight(check, los_param_funcs(center, unpacked, bounds));
+        for (quadrant_iterator qi; qi; ++qi)
+            for (int q = 0; q < 4; ++q)
+            {
+                const coord_def p((q & 1 ? -1 : 1) * qi->x,
+                                  (q & 2 ? -1 : 1) * qi->y);
+                if (sh(p) != check(p))
+                {
+                    die("packed LOS mismatch (map %d) at (%d,%d)+(%d,%d)",
+                        opc.packed_map(), center.x, center.y, p.x, p.y);
+                }
+            }
+    }
+#endif
+}
+
+// Give each thread at least this many centers to do.
+#define LOS_THREAD_MIN_CENTERS 8
+
+struct losight_job
+{
+    los_grid *grids;
+    const coord_def *centers;
+    int first, last;
+    const opacity_func *opc;
+    const circle_def *bounds;
+};
+
+static void *_losight_job(void *arg)
+{
+    const losight_job &job = *static_cast<const losight_job *>(arg);
+    for (int i = job.first; i < job.last; ++i)
+    {
+        _losight(job.grids[i],
+                 los_param_funcs(job.centers[i], *job.opc, *job.bounds));
+    }
+    return nullptr;
+}
+
+// Compute the LOS from each of centers into grids, just as losight()
+// would. This only reads the map, so the work can be split over
+// LOS_THREADS threads.
+void losight_batch(vector<los_grid>& grids, const vector<coord_def>& centers,
+                   const opacity_func& opc, const circle_def& bounds)
+{
+    const int n = centers.size();
+    grids.resize(n);
+    if (!n)
+        return;
+
+    // Build the packed map now, rather than have the threads race to.
+    const opacity_map_type type = opc.packed_map();
+    if (type != OMAP_NONE && !crawl_state.generating_level)
+        _opacity_map(type);
+
+    const int threads = max(1, min(LOS_THREADS, n / LOS_THREAD_MIN_CENTERS));
+    vector<losight_job> jobs(threads);
+    for (int t = 0; t < threads; ++t)
+    {
+        losight_job &job = jobs[t];
+        job.grids = grids.data();
+        job.centers = centers.data();
+        job.first = n * t / threads;
+        job.last = n * (t + 1) / threads;
+        job.opc = &opc;
+        job.bounds = &bounds;
+    }
+
+#if LOS_THREADS > 1
+    vector<thread_t> workers(threads - 1);
+    int started = 0;
+    while (started < threads - 1
+           && !thread_create_joinable(&workers[started], _losight_job,
+                                      &jobs[started + 1]))
+    {
+        ++started;
+    }
+    // Do the jobs of any threads that failed to start here.
+    for (int t = started + 1; t < threads; ++t)
+        _losight_job(&jobs[t]);
+#endif
+    _losight_job(&jobs[0]);
+#if LOS_THREADS > 1
+    for (int t = 0; t < started; ++t)
+        thread_join(workers[t]);
+#endif
+
+#ifdef DEBUG_LOS
+    for (int i = 0; i < n; ++i)
+    {
+        los_grid check;
+        losight(check, centers[i], opc, bounds);
+        for (quadrant_iterator qi; qi; ++qi)
+            for (int q = 0; q < 4; ++q)
+            {
+                const coord_def p((q & 1 ? -1 : 1) * qi->x,
+                                  (q & 2 ? -1 : 1) * qi->y);
+                if (grids[i](p) != check(p))
+                {
+                    die("batched LOS mismatch at (%d,%d)+(%d,%d)",
+                        centers[i].x, centers[i].y, p.x, p.y);
+                }
+            }
+    }
+#endif
+}
+
 opacity_type mons_opacity(const monster* mon, los_type how)
 {
     // no regard for LOS_ARENA
@@ -913,6 +957,7 @@ void los_actor_moved(const actor* act, const coord_def& oldpos)
     {
         invalidate_los_around(oldpos);
         invalidate_los_around(act->pos());
+        _new_los_epoch();
         _handle_los_change();
     }
 }
@@ -922,6 +967,7 @@ void los_monster_died(const monster* mon)
     if (_mons_block_sight(mon))
     {
         invalidate_los_around(mon->pos());
+        _new_los_epoch();
         _handle_los_change();
     }
 }
@@ -929,13 +975,22 @@ void los_monster_died(const monster* mon)
 // Might want to pass new/old terrain.
 void los_terrain_changed(const coord_def& p)
 {
+    for (int i = 0; i < NUM_OPACITY_MAPS; ++i)
+        if (opacity_maps[i].valid)
+            _set_map_opacity(opacity_maps[i], (opacity_map_type)i, p);
     invalidate_los_around(p);
+    pathfind_terrain_changed(p);
+    _new_los_epoch();
     _handle_los_change();
 }
 
 void los_changed()
 {
     mons_reset_just_seen();
+    for (opacity_map &map : opacity_maps)
+        map.valid = false;
     invalidate_los();
+    pathfind_level_changed();
+    _new_los_epoch();
     _handle_los_change();
 }
@@ -27,6 +27,8 @@ bool find_ray(const coord_def& source, const coord_def& target,
               int range = LOS_MAX_RANGE, bool cycle = false);
 bool exists_ray(const coord_def& source, const coord_def& target,
                 const opacity_func &opc, int range = LOS_MAX_RANGE);
+struct los_cache_stats;
+const los_cache_stats& get_ray_cache_stats();
 dungeon_feature_type ray_blocker(const coord_def& source, const coord_def& target);
 
 void fallback_ray(const coord_def& source, const coord_def& target,
@@ -41,13 +43,17 @@ bool cell_see_cell_nocache(const coord_def& p1, const coord_def& p2);
 
 typedef SquareArray<bool, LOS_MAX_RANGE> los_grid;
 
-void clear_rays_on_exit();
 void losight(los_grid& sh, const coord_def& center,
              const opacity_func &opc = opc_default,
              const circle_def &bds = BDS_DEFAULT);
+void losight_batch(vector<los_grid>& grids, const vector<coord_def>& centers,
+                   const opacity_func &opc = opc_default,
+                   const circle_def &bds = BDS_DEFAULT);
 
 void los_actor_moved(const actor* act, const coord_def& oldpos);
 void los_monster_died(const monster* mon);
 void los_terrain_changed(const coord_def& p);
 void los_changed();
+// Changes whenever terrain, clouds or sight-blocking monsters might have.
+uint32_t get_los_epoch();
 opacity_type mons_opacity(const monster* mon, los_type how);
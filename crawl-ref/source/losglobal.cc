@@ -5,37 +5,116 @@
 #include "coord.h"
 #include "coordit.h"
 #include "libutil.h"
-#include "los-def.h"
-
-#define LOS_KNOWN 4
-
-typedef uint8_t losfield_t;
-typedef losfield_t halflos_t[LOS_MAX_RANGE+1][2*LOS_MAX_RANGE+1];
-static const int o_half_x = 0;
-static const int o_half_y = LOS_MAX_RANGE;
+#include "los.h"
+
+// Each pair of cells p < q within LOS range of each other has an entry
+// stored with p, indexed by q - p. An entry has two bits for each of the
+// cached los_types: whether LOS between p and q is known, and whether
+// there is LOS.
+#define LOS_KNOWN   1
+#define LOS_VISIBLE 2
+
+// The offsets q - p > (0, 0) (see coord_def::operator<): (0, 1) ..
+// (0, LOS_MAX_RANGE), then (x, -LOS_MAX_RANGE) .. (x, LOS_MAX_RANGE)
+// for each x = 1 .. LOS_MAX_RANGE.
+#define LOS_HALF_CELLS (LOS_MAX_RANGE * (2*LOS_MAX_RANGE+1) + LOS_MAX_RANGE)
+#define LOS_TYPE_WORDS ((2 * LOS_HALF_CELLS + 15) / 16)
+#define NUM_CACHED_LOS 4
+
+// The entries stored with one cell, valid only if generation matches
+// los_generation. They are cleared lazily when next used, so that
+// invalidating LOS around a cell only needs to reset the generations
+// of the cells that might see it, not clear their entries.
+//
+// That's 146 bytes a cell, or 818 KB in all, and another 22 KB for
+// saved_los below; a byte for each pair of cells in a 17x9 half square
+// would be 857 KB.
+struct halflos_t
+{
+    uint16_t generation;
+    uint16_t entries[NUM_CACHED_LOS][LOS_TYPE_WORDS];
+};
 typedef halflos_t globallos_t[GXM][GYM];
 
 static globallos_t globallos;
+static uint16_t los_generation = 1;
+static los_cache_stats los_stats;
+
+// The los_types (as a mask) whose LOS from a cell has been saved since
+// anything within range of it last changed, if generation matches
+// los_generation. This is only a hint to avoid recomputing LOS in
+// cache_los_from(): the saved entries may still be dropped when a cell
+// on the far side of them changes.
+struct saved_los_t
+{
+    uint16_t generation;
+    uint8_t types;
+};
+static saved_los_t saved_los[GXM][GYM];
+
+static int _los_type_index(los_type l)
+{
+    switch (l)
+    {
+    case LOS_DEFAULT:   return 0;
+    case LOS_NO_TRANS:  return 1;
+    case LOS_SOLID:     return 2;
+    case LOS_SOLID_SEE: return 3;
+    default:
+        die("invalid opacity");
+    }
+}
 
-static losfield_t* _lookup_globallos(const coord_def& p, const coord_def& q)
+static halflos_t& _valid_halflos(const coord_def& p)
 {
-    COMPILE_CHECK(LOS_KNOWN * 2 <= sizeof(losfield_t) * 8);
+    halflos_t &half = globallos[p.x][p.y];
+    if (half.generation != los_generation)
+    {
+        memset(half.entries, 0, sizeof(half.entries));
+        half.generation = los_generation;
+    }
+    return half;
+}
 
+// Find the entry for p and q, p != q. Returns nullptr if they're out of
+// range of each other, else the entries of their halflos, setting index.
+static halflos_t* _lookup_globallos(const coord_def& p, const coord_def& q,
+                                    int &index)
+{
     if (!map_bounds(p) || !map_bounds(q))
         return nullptr;
     coord_def diff = q - p;
     if (diff.rdist() > LOS_RADIUS)
         return nullptr;
     // p < q iff p.x < q.x || p.x == q.x && p.y < q.y
-    if (diff < coord_def(0, 0))
-        return &globallos[q.x][q.y][-diff.x + o_half_x][-diff.y + o_half_y];
+    const bool swap = diff < coord_def(0, 0);
+    if (swap)
+        diff = -diff;
+    if (diff.x == 0)
+        index = diff.y - 1;
     else
-        return &globallos[p.x][p.y][ diff.x + o_half_x][ diff.y + o_half_y];
+    {
+        index = LOS_MAX_RANGE + (diff.x - 1) * (2*LOS_MAX_RANGE+1)
+                + diff.y + LOS_MAX_RANGE;
+    }
+    return &_valid_halflos(swap ? q : p);
+}
+
+static int _get_entry(const halflos_t* half, int type, int index)
+{
+    return half->entries[type][index / 8] >> (2 * (index % 8)) & 3;
+}
+
+static void _set_entry(halflos_t* half, int type, int index, int entry)
+{
+    uint16_t &word = half->entries[type][index / 8];
+    const int shift = 2 * (index % 8);
+    word = (word & ~(3U << shift)) | entry << shift;
 }
 
-static void _save_los(los_def* los, los_type l)
+static void _save_los(const coord_def& o, const los_grid& show, los_type l)
 {
-    const coord_def o = los->get_center();
+    const int type = _los_type_index(l);
     int y1 = o.y - LOS_MAX_RANGE;
     int y2 = o.y + LOS_MAX_RANGE;
     int x1 = o.x - LOS_MAX_RANGE;
@@ -43,19 +122,31 @@ static void _save_los(los_def* los, los_type l)
     for (int y = y1; y <= y2; y++)
         for (int x = x1; x <= x2; x++)
         {
-            if (max(abs(o.x - x), abs(o.y - y)) > LOS_MAX_RANGE)
+            coord_def ri(x, y);
+            if (ri == o)
                 continue;
 
-            coord_def ri(x, y);
-            losfield_t* flags = _lookup_globallos(o, ri);
-            if (!flags)
+            int index;
+            halflos_t* half = _lookup_globallos(o, ri, index);
+            if (!half)
                 continue;
-            *flags |= l << LOS_KNOWN;
-            if (los->see_cell(ri))
-                *flags |= l;
-            else
-                *flags &= ~l;
+            _set_entry(half, type, index,
+                       show(ri - o) ? LOS_KNOWN | LOS_VISIBLE : LOS_KNOWN);
         }
+
+    saved_los_t &saved = saved_los[o.x][o.y];
+    if (saved.generation != los_generation)
+    {
+        saved.generation = los_generation;
+        saved.types = 0;
+    }
+    saved.types |= l;
+}
+
+static bool _los_saved(const coord_def& o, los_type l)
+{
+    const saved_los_t &saved = saved_los[o.x][o.y];
+    return saved.generation == los_generation && (saved.types & l);
 }
 
 // Opacity at p has changed.
@@ -67,65 +158,96 @@ void invalidate_los_around(const coord_def& p)
     int y2 = min(p.y + LOS_MAX_RANGE, GYM - 1);
     for (int y = y1; y <= y2; y++)
         for (int x = x1; x <= x2; x++)
-            memset(globallos[x][y], 0, sizeof(halflos_t));
+            globallos[x][y].generation = 0;
+
+    x2 = min(p.x + LOS_MAX_RANGE, GXM - 1);
+    for (int y = y1; y <= y2; y++)
+        for (int x = x1; x <= x2; x++)
+            saved_los[x][y].generation = 0;
+    los_stats.invalidations++;
 }
 
 void invalidate_los()
 {
-    for (rectangle_iterator ri(0); ri; ++ri)
-        memset(globallos[ri->x][ri->y], 0, sizeof(halflos_t));
+    if (++los_generation == 0)
+    {
+        // Wrapped around; make sure no stale entries look valid.
+        for (rectangle_iterator ri(0); ri; ++ri)
+        {
+            globallos[ri->x][ri->y].generation = 0;
+            saved_los[ri->x][ri->y].generation = 0;
+        }
+        los_generation = 1;
+    }
+    los_stats.invalidations++;
+}
+
+const los_cache_stats& get_los_cache_stats()
+{
+    return los_stats;
 }
 
-static void _update_globallos_at(const coord_def& p, los_type l)
+static const opacity_func& _los_opacity(los_type l)
 {
     switch (l)
     {
-    case LOS_DEFAULT:
-        {
-            los_def los(p, opc_default);
-            los.update();
-            _save_los(&los, l);
-            break;
-        }
-    case LOS_NO_TRANS:
-        {
-            los_def los(p, opc_no_trans);
-            los.update();
-            _save_los(&los, l);
-            break;
-        }
-    case LOS_SOLID:
-        {
-            los_def los(p, opc_solid);
-            los.update();
-            _save_los(&los, l);
-            break;
-        }
-    case LOS_SOLID_SEE:
-        {
-            los_def los(p, opc_solid_see);
-            los.update();
-            _save_los(&los, l);
-            break;
-        }
+    case LOS_DEFAULT:   return opc_default;
+    case LOS_NO_TRANS:  return opc_no_trans;
+    case LOS_SOLID:     return opc_solid;
+    case LOS_SOLID_SEE: return opc_solid_see;
     default:
         die("invalid opacity");
     }
 }
 
+static void _update_globallos_at(const coord_def& p, los_type l)
+{
+    los_grid show;
+    losight(show, p, _los_opacity(l));
+    _save_los(p, show, l);
+}
+
+// Make sure the LOS of type l from each of centers is cached, computing
+// all that are missing in one batch.
+void cache_los_from(const vector<coord_def>& centers, los_type l)
+{
+    vector<coord_def> todo;
+    for (const coord_def &c : centers)
+        if (map_bounds(c) && !_los_saved(c, l))
+            todo.push_back(c);
+
+    vector<los_grid> grids;
+    losight_batch(grids, todo, _los_opacity(l));
+    for (unsigned int i = 0; i < todo.size(); ++i)
+        _save_los(todo[i], grids[i], l);
+}
+
 bool cell_see_cell(const coord_def& p, const coord_def& q, los_type l)
 {
     if (l == LOS_NONE)
         return true;
 
-    losfield_t* flags = _lookup_globallos(p, q);
+    // The center of LOS is always visible.
+    if (p == q)
+        return map_bounds(p);
+
+    int index;
+    halflos_t* half = _lookup_globallos(p, q, index);
 
-    if (!flags)
+    if (!half)
         return false; // outside range
 
-    if (!(*flags & (l << LOS_KNOWN)))
+    const int type = _los_type_index(l);
+    int entry = _get_entry(half, type, index);
+    if (entry & LOS_KNOWN)
+        los_stats.hits++;
+    else
+    {
+        los_stats.misses++;
         _update_globallos_at(p, l);
+        entry = _get_entry(half, type, index);
+    }
 
-    ASSERT(*flags & (l << LOS_KNOWN));
-    return *flags & l;
+    ASSERT(entry & LOS_KNOWN);
+    return entry & LOS_VISIBLE;
 }
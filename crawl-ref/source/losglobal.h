@@ -6,3 +6,13 @@ void invalidate_los_around(const coord_def& p);
 void invalidate_los();
 
 bool cell_see_cell(const coord_def& p, const coord_def& q, los_type l);
+void cache_los_from(const vector<coord_def>& centers, los_type l);
+
+struct los_cache_stats
+{
+    uint64_t hits;          // lookups answered from the cache
+    uint64_t misses;        // ... that needed a computation
+    uint64_t invalidations; // cache invalidations
+};
+
+const los_cache_stats& get_los_cache_stats();
@@ -23,33 +23,118 @@ const opacity_solid_see opc_solid_see = opacity_solid_see();
 const opacity_no_actor opc_no_actor = opacity_no_actor();
 const opacity_excl opc_excl = opacity_excl();
 
-opacity_type opacity_default::operator()(const coord_def& p) const
+// The terrain and cloud part of the packed opacity functions. These are
+// kept separate from the monster part so that los.cc can store them in
+// its packed opacity maps.
+
+static inline opacity_type _default_terrain(const coord_def& p)
 {
-    dungeon_feature_type f = grd(p);
-    if (feat_is_opaque(f))
+    if (feat_is_opaque(env.grid(p)))
         return OPC_OPAQUE;
     else if (is_opaque_cloud(cloud_type_at(p)))
         return OPC_HALF;
-    else if (const monster *mon = monster_at(p))
-        return mons_opacity(mon, LOS_DEFAULT);
     return OPC_CLEAR;
 }
 
-opacity_type opacity_fullyopaque::operator()(const coord_def& p) const
+static inline opacity_type _fullyopaque_terrain(const coord_def& p)
 {
-    if (feat_is_opaque(env.grid(p)))
+    return feat_is_opaque(env.grid(p)) ? OPC_OPAQUE : OPC_CLEAR;
+}
+
+static inline bool _feat_blocks_trans(dungeon_feature_type f)
+{
+    return feat_is_opaque(f) || feat_is_wall(f) || feat_is_closed_door(f);
+}
+
+static inline opacity_type _no_trans_terrain(const coord_def& p)
+{
+    if (_feat_blocks_trans(env.grid(p)))
         return OPC_OPAQUE;
-    else
-        return OPC_CLEAR;
+    else if (is_opaque_cloud(cloud_type_at(p)))
+        return OPC_HALF;
+    return OPC_CLEAR;
 }
 
-opacity_type opacity_no_trans::operator()(const coord_def& p) const
+static inline opacity_type _fully_no_trans_terrain(const coord_def& p)
+{
+    return _feat_blocks_trans(env.grid(p)) ? OPC_OPAQUE : OPC_CLEAR;
+}
+
+static inline opacity_type _solid_terrain(const coord_def& p)
 {
-    dungeon_feature_type f = grd(p);
-    if (feat_is_opaque(f) || feat_is_wall(f) || feat_is_closed_door(f))
+    return feat_is_solid(env.grid(p)) ? OPC_OPAQUE : OPC_CLEAR;
+}
+
+static inline opacity_type _solid_see_terrain(const coord_def& p)
+{
+    if (feat_is_solid(env.grid(p)))
         return OPC_OPAQUE;
     else if (is_opaque_cloud(cloud_type_at(p)))
         return OPC_HALF;
+    return OPC_CLEAR;
+}
+
+/**
+ * The opacity of a cell according to the terrain and clouds alone.
+ *
+ * @param map  The packed opacity function.
+ * @param p    The cell.
+ * @return     The opacity of p, ignoring monsters.
+ */
+opacity_type packed_opacity(opacity_map_type map, const coord_def& p)
+{
+    switch (map)
+    {
+    case OMAP_DEFAULT:        return _default_terrain(p);
+    case OMAP_FULLYOPAQUE:    return _fullyopaque_terrain(p);
+    case OMAP_NO_TRANS:       return _no_trans_terrain(p);
+    case OMAP_FULLY_NO_TRANS: return _fully_no_trans_terrain(p);
+    case OMAP_SOLID:          return _solid_terrain(p);
+    case OMAP_SOLID_SEE:      return _solid_see_terrain(p);
+    default:
+        die("invalid opacity map %d", map);
+    }
+}
+
+/**
+ * How monsters affect a packed opacity function.
+ *
+ * @param map  The packed opacity function.
+ * @return     The los_type to pass to mons_opacity() for monsters standing
+ *             on cells that are clear according to packed_opacity(), or
+ *             LOS_NONE if monsters never matter.
+ */
+los_type packed_opacity_mons(opacity_map_type map)
+{
+    switch (map)
+    {
+    case OMAP_DEFAULT:   return LOS_DEFAULT;
+    case OMAP_NO_TRANS:  return LOS_NO_TRANS;
+    case OMAP_SOLID_SEE: return LOS_SOLID_SEE;
+    default:             return LOS_NONE;
+    }
+}
+
+opacity_type opacity_default::operator()(const coord_def& p) const
+{
+    const opacity_type opc = _default_terrain(p);
+    if (opc != OPC_CLEAR)
+        return opc;
+    else if (const monster *mon = monster_at(p))
+        return mons_opacity(mon, LOS_DEFAULT);
+    return OPC_CLEAR;
+}
+
+opacity_type opacity_fullyopaque::operator()(const coord_def& p) const
+{
+    return _fullyopaque_terrain(p);
+}
+
+opacity_type opacity_no_trans::operator()(const coord_def& p) const
+{
+    const opacity_type opc = _no_trans_terrain(p);
+    if (opc != OPC_CLEAR)
+        return opc;
     else if (const monster *mon = monster_at(p))
         return mons_opacity(mon, LOS_NO_TRANS);
     return OPC_CLEAR;
@@ -57,10 +142,7 @@ opacity_type opacity_no_trans::operator()(const coord_def& p) const
 
 opacity_type opacity_fully_no_trans::operator()(const coord_def& p) const
 {
-    dungeon_feature_type f = grd(p);
-    if (feat_is_opaque(f) || feat_is_wall(f) || feat_is_closed_door(f))
-        return OPC_OPAQUE;
-    return OPC_CLEAR;
+    return _fully_no_trans_terrain(p);
 }
 
 opacity_type opacity_immob::operator()(const coord_def& p) const
@@ -80,25 +162,18 @@ opacity_type opacity_mons_immob::operator()(const coord_def& p) const
 
 opacity_type opacity_solid::operator()(const coord_def& p) const
 {
-    dungeon_feature_type f = env.grid(p);
-    if (feat_is_solid(f))
-        return OPC_OPAQUE;
-
-    return OPC_CLEAR;
+    return _solid_terrain(p);
 }
 
 // Make anything solid block in addition to normal LOS.
 // That includes statues and grates in addition to opacity_no_trans.
 opacity_type opacity_solid_see::operator()(const coord_def& p) const
 {
-    dungeon_feature_type f = env.grid(p);
-    if (feat_is_solid(f))
-        return OPC_OPAQUE;
-    else if (is_opaque_cloud(cloud_type_at(p)))
-        return OPC_HALF;
+    const opacity_type opc = _solid_see_terrain(p);
+    if (opc != OPC_CLEAR)
+        return opc;
     else if (const monster *mon = monster_at(p))
         return mons_opacity(mon, LOS_SOLID_SEE);
-
     return OPC_CLEAR;
 }
 
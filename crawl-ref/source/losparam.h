@@ -5,6 +5,8 @@
 
 #pragma once
 
+#include "los-type.h"
+
 // Note: find_ray relies on the fact that 2*OPC_HALF == OPC_OPAQUE.
 // On the other hand, losight tracks this explicitly.
 enum opacity_type
@@ -16,14 +18,34 @@ enum opacity_type
     NUM_OPACITIES
 };
 
+// Opacity functions that only look at terrain, clouds and monster
+// opacity. los.cc keeps a packed per-level bitmap of the terrain and
+// cloud part of each of these.
+enum opacity_map_type
+{
+    OMAP_NONE = -1,
+    OMAP_DEFAULT,
+    OMAP_FULLYOPAQUE,
+    OMAP_NO_TRANS,
+    OMAP_FULLY_NO_TRANS,
+    OMAP_SOLID,
+    OMAP_SOLID_SEE,
+    NUM_OPACITY_MAPS
+};
+
 class opacity_func
 {
 public:
     virtual opacity_type operator()(const coord_def& p) const = 0;
     virtual ~opacity_func() {}
     virtual opacity_func* clone() const = 0;
+    // The packed opacity map that stands in for this function, if any.
+    virtual opacity_map_type packed_map() const { return OMAP_NONE; }
 };
 
+opacity_type packed_opacity(opacity_map_type map, const coord_def& p);
+los_type packed_opacity_mons(opacity_map_type map);
+
 #define CLONE(typename) \
     typename* clone() const override \
     { \
@@ -37,6 +59,7 @@ public:
     CLONE(opacity_default)
 
     opacity_type operator()(const coord_def& p) const override;
+    opacity_map_type packed_map() const override { return OMAP_DEFAULT; }
 };
 extern const opacity_default opc_default;
 
@@ -48,6 +71,7 @@ public:
     CLONE(opacity_fullyopaque)
 
     opacity_type operator()(const coord_def& p) const override;
+    opacity_map_type packed_map() const override { return OMAP_FULLYOPAQUE; }
 };
 extern const opacity_fullyopaque opc_fullyopaque;
 
@@ -60,6 +84,7 @@ public:
     CLONE(opacity_no_trans)
 
     opacity_type operator()(const coord_def& p) const override;
+    opacity_map_type packed_map() const override { return OMAP_NO_TRANS; }
 };
 extern const opacity_no_trans opc_no_trans;
 
@@ -71,6 +96,7 @@ public:
     CLONE(opacity_fully_no_trans)
 
     opacity_type operator()(const coord_def& p) const override;
+    opacity_map_type packed_map() const override { return OMAP_FULLY_NO_TRANS; }
 };
 extern const opacity_fully_no_trans opc_fully_no_trans;
 
@@ -109,6 +135,7 @@ public:
     CLONE(opacity_solid)
 
     opacity_type operator()(const coord_def& p) const override;
+    opacity_map_type packed_map() const override { return OMAP_SOLID; }
 };
 extern const opacity_solid opc_solid;
 
@@ -119,6 +146,7 @@ public:
     CLONE(opacity_solid_see)
 
     opacity_type operator()(const coord_def& p) const override;
+    opacity_map_type packed_map() const override { return OMAP_SOLID_SEE; }
 };
 extern const opacity_solid_see opc_solid_see;
 
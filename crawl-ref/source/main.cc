@@ -535,6 +535,21 @@ static void _show_commandline_options_help()
     puts("  -force-map <map>    For -mapstat and -objstat, alway choose the "
          "      given map on every level.");
 #endif
+    puts("");
+    puts("Seed survey options:");
+    puts("  -seed-survey <first>[-<last>]  build the dungeon for each seed in "
+         "the range");
+    puts("      and catalogue its vaults, uniques, artefacts, altars and "
+         "shops in");
+    puts("      seed-survey.cat.");
+    puts("  -seed-survey-query <file> [<term>...]  list the seeds in a "
+         "catalogue that");
+    puts("      match every term: a case-insensitive part of a name, "
+         "optionally");
+    puts("      limited to a category, e.g. 'altar:trog' or 'unique:sigmund'.");
+    puts("  -jobs <num>  split the work of -seed-survey, -mapstat or -objstat "
+         "between");
+    puts("      this many processes");
     puts("");
     puts("Miscellaneous options:");
     puts("  -dump-maps       write map Lua to stderr when parsing .des files");
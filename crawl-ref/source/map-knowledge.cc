@@ -24,6 +24,7 @@ void set_terrain_mapped(const coord_def gc)
     map_cell* cell = &env.map_knowledge(gc);
     cell->flags &= (~MAP_CHANGED_FLAG);
     cell->flags |= MAP_MAGIC_MAPPED_FLAG;
+    travel_knowledge_changed(gc);
 #ifdef USE_TILE
     // This may have changed the explore horizon, so update adjacent minimap
     // squares as well.
@@ -126,6 +127,9 @@ void set_terrain_seen(const coord_def pos)
     const dungeon_feature_type feat = grd(pos);
     map_cell* cell = &env.map_knowledge(pos);
 
+    if (!(cell->flags & MAP_SEEN_FLAG) || cell->flags & MAP_CHANGED_FLAG)
+        travel_knowledge_changed(pos);
+
     // First time we've seen a notable feature.
     if (!(cell->flags & MAP_SEEN_FLAG))
     {
@@ -2448,11 +2448,30 @@ void map_def::strip()
     feat_renames.clear();
 }
 
+void map_def::precompile_lua()
+{
+    for (dlua_chunk *chunk : { &prelude, &mapchunk, &main, &validate, &veto,
+                               &epilogue })
+    {
+        chunk->precompile(dlua);
+    }
+}
+
 void map_def::load()
 {
     if (!index_only)
         return;
 
+    size_t size;
+    if (const unsigned char *bodies = archived_map_bodies(cache_name, size))
+    {
+        reader inf(bodies, size, TAG_MINOR_VERSION);
+        inf.advance(cache_offset);
+        read_full(inf);
+        index_only = false;
+        return;
+    }
+
     const string descache_base = get_descache_path(cache_name, "");
     file_lock deslock(descache_base + ".lk", "rb", false);
     const string loadfile = descache_base + ".dsc";
@@ -1190,6 +1190,7 @@ public:
 
     void load();
     void strip();
+    void precompile_lua();
 
     int weight(const level_id &lid) const;
     map_chance chance(const level_id &lid) const;
@@ -10,8 +10,10 @@
 #include <algorithm>
 #include <cstdlib>
 #include <cstring>
+#include <memory>
 #include <sys/param.h>
 #include <sys/types.h>
+#include <unordered_map>
 #ifndef TARGET_COMPILER_VC
 #include <unistd.h>
 #endif
@@ -20,6 +22,7 @@
 #include "coord.h"
 #include "coordit.h"
 #include "dbg-maps.h"
+#include "dgn-profile.h"
 #include "dungeon.h"
 #include "end.h"
 #include "endianness.h"
@@ -42,7 +45,7 @@
 
 static map_section_type _write_vault(map_def &mdef,
                                      vault_placement &,
-                                     bool check_place);
+                                     bool check_place, int &attempts);
 static map_section_type _apply_vault_definition(
     map_def &def,
     vault_placement &,
@@ -67,6 +70,30 @@ point_vector map_anchor_points;
 
 static map_vector vdefs;
 
+typedef vector<unsigned> vault_indices;
+
+// Selecting a vault used to test every map against the selector. The
+// index keeps, for each tag and for each place asked about so far, the
+// maps that could pass the parts of those tests that never change for a
+// map (its tags, DEPTH, PLACE and CHANCE). The lists are in vdefs order,
+// so random selection sees the same maps in the same order as before.
+// Depth ranges count back from the bottom of branches, so the lists for
+// places are only good for the branch depths they were made with.
+struct map_index
+{
+    unordered_map<string, vault_indices> tagged;
+    FixedVector<int, NUM_BRANCHES> depths;
+    map<level_id, vault_indices> placed;
+    map<level_id, vault_indices> in_depth[2];
+    map<level_id, vault_indices> chance_in_depth;
+};
+static unique_ptr<map_index> vindex;
+
+static void _reset_map_index()
+{
+    vindex.reset();
+}
+
 // Parameter array that vault code can use.
 string_vector map_parameters;
 
@@ -103,12 +130,19 @@ map_section_type vault_main(vault_placement &place, const map_def *vault,
     // level, except for branch entry vaults where dungeon.cc just
     // rejects the vault and places a vanilla entry.
 
-    return _write_vault(const_cast<map_def&>(*vault), place, check_place);
+    const int64_t start = builder_profile_usecs();
+    int attempts = 0;
+    const map_section_type orient =
+        _write_vault(const_cast<map_def&>(*vault), place, check_place,
+                     attempts);
+    builder_profile_vault(vault->name, attempts, orient != MAP_NONE,
+                          builder_profile_usecs() - start);
+    return orient;
 }
 
 static map_section_type _write_vault(map_def &mdef,
                                      vault_placement &place,
-                                     bool check_place)
+                                     bool check_place, int &attempts)
 {
     mdef.load();
 
@@ -123,6 +157,8 @@ static map_section_type _write_vault(map_def &mdef,
 
     while (tries-- > 0)
     {
+        ++attempts;
+
         // We're a regular vault, so clear the subvault stack.
         clear_subvault_stack();
 
@@ -724,6 +760,49 @@ vector<string> find_map_matches(const string &name)
     return matches;
 }
 
+static map_index &_map_index()
+{
+    if (!vindex)
+    {
+        vindex.reset(new map_index);
+        for (unsigned i = 0, size = vdefs.size(); i < size; ++i)
+            for (const string &tag : vdefs[i].get_tags_unsorted())
+                vindex->tagged[tag].push_back(i);
+        vindex->depths = brdepth;
+    }
+    else if (!equal(brdepth.begin(), brdepth.end(), vindex->depths.begin()))
+    {
+        // A new game, or the sanity checks in read_maps(), changed them.
+        vindex->placed.clear();
+        vindex->in_depth[0].clear();
+        vindex->in_depth[1].clear();
+        vindex->chance_in_depth.clear();
+        vindex->depths = brdepth;
+    }
+    return *vindex;
+}
+
+// The maps with all of tags, or some of them at least; nullptr if there's
+// no shorter list to check than all the maps.
+static const vault_indices *_maps_with_tags(const unordered_set<string> &tags)
+{
+    if (tags.empty() || crawl_state.disables[DIS_MAP_INDEX])
+        return nullptr;
+
+    static const vault_indices no_maps;
+    const map_index &index = _map_index();
+    const vault_indices *shortest = nullptr;
+    for (const string &tag : tags)
+    {
+        auto it = index.tagged.find(tag);
+        if (it == index.tagged.end())
+            return &no_maps;
+        if (!shortest || it->second.size() < shortest->size())
+            shortest = &it->second;
+    }
+    return shortest;
+}
+
 mapref_vector find_maps_for_tag(const string &tag,
                                 bool check_depth,
                                 bool check_used)
@@ -732,8 +811,11 @@ mapref_vector find_maps_for_tag(const string &tag,
     level_id place = level_id::current();
     unordered_set<string> tag_set = parse_tags(tag);
 
-    for (const map_def &mapdef : vdefs)
+    const vault_indices *candidates = _maps_with_tags(tag_set);
+    for (unsigned i = 0, size = candidates ? candidates->size() : vdefs.size();
+         i < size; ++i)
     {
+        const map_def &mapdef = vdefs[candidates ? (*candidates)[i] : i];
         if (mapdef.has_all_tags(tag_set.begin(), tag_set.end())
             && !mapdef.has_tag("dummy")
             && (!check_depth || !mapdef.has_depth()
@@ -760,6 +842,7 @@ private:
 public:
     bool accept(const map_def &md) const;
     void announce(const map_def *map) const;
+    const vault_indices *candidates() const;
 
     bool valid() const
     {
@@ -827,17 +910,21 @@ public:
     const bool check_layout;
 };
 
-bool map_selector::depth_selectable(const map_def &mapdef) const
+// Some tagged levels cannot be selected as random maps in a specific depth.
+static bool _tags_depth_selectable(const map_def &mapdef)
 {
-    return mapdef.is_usable_in(place)
-           // Some tagged levels cannot be selected as random
-           // maps in a specific depth:
-           && !mapdef.has_tag_suffix("entry")
+    return !mapdef.has_tag_suffix("entry")
            && !mapdef.has_tag("unrand")
            && !mapdef.has_tag("place_unique")
            && !mapdef.has_tag("tutorial")
            && (!mapdef.has_tag_prefix("temple_")
-               || mapdef.has_tag_prefix("uniq_altar_"))
+               || mapdef.has_tag_prefix("uniq_altar_"));
+}
+
+bool map_selector::depth_selectable(const map_def &mapdef) const
+{
+    return mapdef.is_usable_in(place)
+           && _tags_depth_selectable(mapdef)
            && _map_matches_species(mapdef)
            && (!check_layout || _map_matches_layout_type(mapdef));
 }
@@ -901,6 +988,52 @@ bool map_selector::accept(const map_def &mapdef) const
     }
 }
 
+/**
+ * Which maps might this selector accept?
+ *
+ * @return the indices of every map that accept() could be true for, in
+ *         order, or nullptr if they all need to be checked.
+ */
+const vault_indices *map_selector::candidates() const
+{
+    if (crawl_state.disables[DIS_MAP_INDEX])
+        return nullptr;
+    if (sel == TAG)
+        return _maps_with_tags(parse_tags(tag));
+
+    map_index &index = _map_index();
+    map<level_id, vault_indices> &lists =
+        sel == PLACE ? index.placed :
+        sel == DEPTH ? index.in_depth[mini]
+                     : index.chance_in_depth;
+    auto it = lists.find(place);
+    if (it != lists.end())
+        return &it->second;
+
+    vault_indices &maps = lists[place];
+    for (unsigned i = 0, size = vdefs.size(); i < size; ++i)
+    {
+        const map_def &mapdef = vdefs[i];
+        bool possible;
+        if (sel == PLACE)
+            possible = mapdef.place.is_usable_in(place);
+        else
+        {
+            const bool chance = mapdef.chance(place).valid();
+            const bool dummy = mapdef.has_tag("dummy");
+            possible = mapdef.is_usable_in(place)
+                       && _tags_depth_selectable(mapdef)
+                       && (sel == DEPTH
+                           ? mapdef.is_minivault() == mini
+                             && (!chance || dummy)
+                           : chance && !dummy);
+        }
+        if (possible)
+            maps.push_back(i);
+    }
+    return &maps;
+}
+
 void map_selector::announce(const map_def *vault) const
 {
 #ifdef DEBUG_DIAGNOSTICS
@@ -941,13 +1074,20 @@ string vault_chance_tag(const map_def &map)
     return "";
 }
 
-typedef vector<unsigned> vault_indices;
-
 static vault_indices _eligible_maps_for_selector(const map_selector &sel)
 {
     vault_indices eligible;
 
-    if (sel.valid())
+    if (!sel.valid())
+        return eligible;
+
+    if (const vault_indices *candidates = sel.candidates())
+    {
+        for (unsigned i : *candidates)
+            if (sel.accept(vdefs[i]))
+                eligible.push_back(i);
+    }
+    else
     {
         for (unsigned i = 0, size = vdefs.size(); i < size; ++i)
             if (sel.accept(vdefs[i]))
@@ -1262,34 +1402,9 @@ static bool _verify_map_full(const string &base, time_t mtime)
     return verify_file_version(base + ".dsc", mtime);
 }
 
-static bool _load_map_index(const string& cache, const string &base,
-                            time_t mtime)
+static bool _load_map_index(const string& cache, reader *prelude,
+                            reader &inf, time_t mtime)
 {
-    // If there's a global prelude, load that first.
-    if (FILE *fp = fopen_u((base + ".lux").c_str(), "rb"))
-    {
-        reader inf(fp, TAG_MINOR_VERSION);
-        uint8_t major = unmarshallUByte(inf);
-        uint8_t minor = unmarshallUByte(inf);
-        int8_t word = unmarshallByte(inf);
-        int64_t t = unmarshallSigned(inf);
-        if (major != TAG_MAJOR_VERSION || minor > TAG_MINOR_VERSION
-            || word != WORD_LEN || t != mtime)
-        {
-            return false;
-        }
-
-        lc_global_prelude.read(inf);
-        fclose(fp);
-
-        global_preludes.push_back(lc_global_prelude);
-    }
-
-    FILE* fp = fopen_u((base + ".idx").c_str(), "rb");
-    if (!fp)
-        end(1, true, "Unable to read %s", (base + ".idx").c_str());
-
-    reader inf(fp, TAG_MINOR_VERSION);
     // Re-check version, might have been modified in the meantime.
     uint8_t major = unmarshallUByte(inf);
     uint8_t minor = unmarshallUByte(inf);
@@ -1302,14 +1417,33 @@ static bool _load_map_index(const string& cache, const string &base,
     }
 
 #if TAG_MAJOR_VERSION == 34
-    // Throw out indices that could have CHANCE priority entirely.
-    if (minor < TAG_MINOR_NO_PRIORITY)
+    // Throw out indices that could have CHANCE priority entirely, and
+    // rebuild those without Lua bytecode.
+    if (minor < TAG_MINOR_MAP_BYTECODE)
         return false;
 #endif
 
+    // If there's a global prelude, load that first.
+    if (prelude)
+    {
+        major = unmarshallUByte(*prelude);
+        minor = unmarshallUByte(*prelude);
+        word = unmarshallByte(*prelude);
+        t = unmarshallSigned(*prelude);
+        if (major != TAG_MAJOR_VERSION || minor > TAG_MINOR_VERSION
+            || word != WORD_LEN || t != mtime)
+        {
+            return false;
+        }
+
+        lc_global_prelude.read(*prelude);
+        global_preludes.push_back(lc_global_prelude);
+    }
+
     const int nmaps = unmarshallShort(inf);
     const int nexist = vdefs.size();
     vdefs.resize(nexist + nmaps, map_def());
+    _reset_map_index();
     for (int i = 0; i < nmaps; ++i)
     {
         map_def &vdef(vdefs[nexist + i]);
@@ -1321,19 +1455,260 @@ static bool _load_map_index(const string& cache, const string &base,
         lc_loaded_maps[vdef.name] = vdef.place_loaded_from;
         vdef.place_loaded_from.clear();
     }
-    fclose(fp);
 
     return true;
 }
 
+/////////////////////////////////////////////////////////////////////////////
+// The map archive.
+//
+// Checking and reading the three or four cache files of every .des file
+// adds up when each game is a new process. Once all the des files have
+// been read, their caches are packed into one archive file; later
+// processes map that into memory in one go and read the indices and
+// map bodies straight from it. Since the mapping outlives the file, the
+// bodies also stay consistent with the index if another process rebuilds
+// the caches while we're running.
+//
+// The archive is the usual version header and the size of the directory,
+// then the directory: the number of des files and for each its cache
+// name, modification time and the offset and size of its .lux, .idx and
+// .dsc caches. Those follow, offsets counting from the end of the
+// directory.
+
+#define MAP_ARCHIVE "maps-archive"
+
+struct archived_cache
+{
+    const unsigned char *data;
+    size_t size;
+};
+
+struct archived_des
+{
+    int64_t mtime;
+    archived_cache lux, idx, dsc;
+    // Were this des file's maps loaded from the archive?
+    bool used;
+};
+
+struct map_archive_t
+{
+    bool opened = false;
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+    unordered_map<string, archived_des> files;
+    // The des files read so far, and whether they differ from the archive.
+    vector<pair<string, time_t>> read;
+    bool stale = false;
+};
+static map_archive_t map_archive;
+
+static void _close_map_archive()
+{
+    if (map_archive.data)
+        unmap_file(map_archive.data, map_archive.size);
+    map_archive.data = nullptr;
+    map_archive.size = 0;
+    map_archive.files.clear();
+}
+
+static void _open_map_archive()
+{
+    if (map_archive.opened)
+        return;
+    map_archive.opened = true;
+
+    file_lock lock(_des_cache_dir(MAP_ARCHIVE ".lk"), "rb", false);
+    const string path = _des_cache_dir(MAP_ARCHIVE ".arc");
+    size_t size = 0;
+    const unsigned char *data = map_file_u(path.c_str(), size);
+    if (!data)
+        return;
+    map_archive.data = data;
+    map_archive.size = size;
+
+    try
+    {
+        reader inf(data, size, TAG_MINOR_VERSION);
+        inf.set_safe_read(true);
+        const uint8_t major = unmarshallUByte(inf);
+        const uint8_t minor = unmarshallUByte(inf);
+        const int8_t word = unmarshallByte(inf);
+        if (major != TAG_MAJOR_VERSION || minor != TAG_MINOR_VERSION
+            || word != WORD_LEN)
+        {
+            _close_map_archive();
+            return;
+        }
+
+        const size_t base = 3 + sizeof(int32_t) + unmarshallInt(inf);
+        const int nfiles = unmarshallInt(inf);
+        for (int i = 0; i < nfiles; ++i)
+        {
+            archived_des &des = map_archive.files[unmarshallString(inf)];
+            des.mtime = unmarshallSigned(inf);
+            des.used = false;
+            for (archived_cache *cache : { &des.lux, &des.idx, &des.dsc })
+            {
+                const size_t offset = base + unmarshallUnsigned(inf);
+                cache->size = unmarshallUnsigned(inf);
+                if (offset + cache->size > size)
+                    throw short_read_exception();
+                cache->data = data + offset;
+            }
+        }
+    }
+    catch (short_read_exception &E)
+    {
+        dprf("Discarding corrupt map archive %s", path.c_str());
+        _close_map_archive();
+    }
+}
+
+static bool _load_archived_maps(const string &cachename, time_t mtime)
+{
+    _open_map_archive();
+    auto it = map_archive.files.find(cachename);
+    if (it == map_archive.files.end() || it->second.mtime != mtime)
+        return false;
+
+    archived_des &des = it->second;
+    reader prelude(des.lux.data, des.lux.size, TAG_MINOR_VERSION);
+    reader inf(des.idx.data, des.idx.size, TAG_MINOR_VERSION);
+    if (!_load_map_index(cachename, des.lux.size ? &prelude : nullptr, inf,
+                         mtime))
+    {
+        return false;
+    }
+    des.used = true;
+    return true;
+}
+
+const unsigned char *archived_map_bodies(const string &cachename,
+                                         size_t &size)
+{
+    auto it = map_archive.files.find(cachename);
+    if (it == map_archive.files.end() || !it->second.used)
+        return nullptr;
+    size = it->second.dsc.size;
+    return it->second.dsc.data;
+}
+
+// Is this a cache file for a des file last modified at mtime?
+static bool _cache_matches(const unsigned char *data, size_t size,
+                           time_t mtime)
+{
+    try
+    {
+        reader inf(data, size);
+        inf.set_safe_read(true);
+        const uint8_t major = unmarshallUByte(inf);
+        const uint8_t minor = unmarshallUByte(inf);
+        const int8_t word = unmarshallByte(inf);
+        const int64_t t = unmarshallSigned(inf);
+        return major == TAG_MAJOR_VERSION
+               && minor <= TAG_MINOR_VERSION
+               && word == WORD_LEN
+               && t == mtime;
+    }
+    catch (short_read_exception &E)
+    {
+        return false;
+    }
+}
+
+static void _archive_cache(writer &dir, vector<unsigned char> &caches,
+                           const unsigned char *data, size_t size)
+{
+    marshallUnsigned(dir, caches.size());
+    marshallUnsigned(dir, size);
+    caches.insert(caches.end(), data, data + size);
+}
+
+// Pack the caches of all the des files read into a new archive, if the
+// one we have is out of date.
+static void _write_map_archive()
+{
+    if (!map_archive.stale)
+        return;
+    map_archive.stale = false;
+
+    _check_des_index_dir();
+    file_lock lock(_des_cache_dir(MAP_ARCHIVE ".lk"), "wb", false);
+
+    vector<unsigned char> dirbuf, caches;
+    writer dir(&dirbuf);
+    marshallInt(dir, map_archive.read.size());
+    for (const auto &entry : map_archive.read)
+    {
+        const string &name = entry.first;
+        marshallString(dir, name);
+        marshallSigned(dir, entry.second);
+
+        auto it = map_archive.files.find(name);
+        if (it != map_archive.files.end() && it->second.used)
+        {
+            const archived_des &des = it->second;
+            for (const archived_cache *cache : { &des.lux, &des.idx, &des.dsc })
+                _archive_cache(dir, caches, cache->data, cache->size);
+            continue;
+        }
+
+        const string base = get_descache_path(name, "");
+        file_lock deslock(base + ".lk", "rb", false);
+        for (const char *ext : { ".lux", ".idx", ".dsc" })
+        {
+            const string file = base + ext;
+            size_t size = 0;
+            const unsigned char *data = map_file_u(file.c_str(), size);
+            const bool ok = data && _cache_matches(data, size, entry.second);
+            // Only the global prelude is optional.
+            if (!ok && strcmp(ext, ".lux"))
+            {
+                dprf("Not archiving maps: no usable %s", file.c_str());
+                if (data)
+                    unmap_file(data, size);
+                return;
+            }
+            _archive_cache(dir, caches, data, ok ? size : 0);
+            if (data)
+                unmap_file(data, size);
+        }
+    }
+
+    const string path = _des_cache_dir(MAP_ARCHIVE ".arc");
+    const string tmp = path + ".tmp";
+    FILE *fp = fopen_replace(tmp.c_str());
+    if (!fp)
+        return;
+
+    writer outf(tmp, fp, true);
+    marshallUByte(outf, TAG_MAJOR_VERSION);
+    marshallUByte(outf, TAG_MINOR_VERSION);
+    marshallByte(outf, WORD_LEN);
+    marshallInt(outf, dirbuf.size());
+    outf.write(dirbuf.data(), dirbuf.size());
+    outf.write(caches.data(), caches.size());
+    fclose(fp);
+
+    if (!outf.succeeded() || rename_u(tmp.c_str(), path.c_str()))
+        unlink_u(tmp.c_str());
+}
+
 static bool _load_map_cache(const string &filename, const string &cachename)
 {
+    time_t mtime = file_modtime(filename);
+    map_archive.read.emplace_back(cachename, mtime);
+    if (_load_archived_maps(cachename, mtime))
+        return true;
+    map_archive.stale = true;
+
     _check_des_index_dir();
     const string descache_base = get_descache_path(cachename, "");
 
     file_lock deslock(descache_base + ".lk", "rb", false);
 
-    time_t mtime = file_modtime(filename);
     string file_idx = descache_base + ".idx";
     string file_dsc = descache_base + ".dsc";
 
@@ -1344,7 +1719,13 @@ static bool _load_map_cache(const string &filename, const string &cachename)
         return false;
     }
 
-    return _load_map_index(cachename, descache_base, mtime);
+    reader prelude(descache_base + ".lux", TAG_MINOR_VERSION);
+    reader inf(file_idx, TAG_MINOR_VERSION);
+    if (!inf.valid())
+        end(1, true, "Unable to read %s", file_idx.c_str());
+
+    return _load_map_index(cachename, prelude.valid() ? &prelude : nullptr,
+                           inf, mtime);
 }
 
 static void _write_map_prelude(const string &filebase, time_t mtime)
@@ -1380,7 +1761,10 @@ static void _write_map_full(const string &filebase, size_t vs, size_t ve,
     marshallByte(outf, WORD_LEN);
     marshallSigned(outf, mtime);
     for (size_t i = vs; i < ve; ++i)
+    {
+        vdefs[i].precompile_lua();
         vdefs[i].write_full(outf);
+    }
     fclose(fp);
 }
 
@@ -1473,6 +1857,7 @@ void read_maps()
     if (dlua.execfile("dlua/loadmaps.lua", true, true, true))
         end(1, false, "Lua error: %s", dlua.error.c_str());
 
+    _write_map_archive();
     lc_loaded_maps.clear();
 
     {
@@ -1496,6 +1881,9 @@ void reread_maps()
 
     // BOOM!
     vdefs.clear();
+    _reset_map_index();
+    _close_map_archive();
+    map_archive = map_archive_t();
     map_files_read.clear();
     read_maps();
 }
@@ -1515,6 +1903,7 @@ void add_parsed_map(const map_def &md)
 
     map.fixup();
     vdefs.push_back(map);
+    _reset_map_index();
 }
 
 void run_map_global_preludes()
@@ -1417,7 +1417,8 @@ bool msgwin_errors_to_stderr()
 {
     return crawl_state.test || crawl_state.script
             || crawl_state.build_db
-            || crawl_state.map_stat_gen || crawl_state.obj_stat_gen;
+            || crawl_state.map_stat_gen || crawl_state.obj_stat_gen
+            || crawl_state.seed_survey;
 }
 
 void msgwin_clear_temporary()
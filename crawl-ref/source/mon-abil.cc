@@ -120,10 +120,10 @@ bool ugly_thing_mutate(monster& ugly, bool force)
 // leaving durations unchanged, I guess. -cao
 static void _split_ench_durations(monster* initial_slime, monster* split_off)
 {
-    for (const auto &entry : initial_slime->enchantments)
+    for (const mon_enchant &me : initial_slime->enchantments)
         // Don't let new slimes inherit being held by a web or net
-        if (entry.second.ench != ENCH_HELD)
-            split_off->add_ench(entry.second);
+        if (me.ench != ENCH_HELD)
+            split_off->add_ench(me);
 }
 
 // What to do about any enchantments these two creatures may have?
@@ -137,35 +137,33 @@ void merge_ench_durations(monster& initial, monster& merge_to, bool usehd)
 
     mon_enchant_list &from_ench = initial.enchantments;
 
-    for (auto &entry : from_ench)
+    for (mon_enchant &me : from_ench)
     {
         // Does the other creature have this enchantment as well?
-        const mon_enchant temp = merge_to.get_ench(entry.first);
+        const mon_enchant temp = merge_to.get_ench(me.ench);
         // If not, use duration 0 for their part of the average.
         const bool no_initial = temp.ench == ENCH_NONE;
         const int duration = no_initial ? 0 : temp.duration;
 
-        entry.second.duration = (entry.second.duration * initial_count
-                                 + duration * merge_to_count)/total_count;
+        me.duration = (me.duration * initial_count
+                       + duration * merge_to_count)/total_count;
 
-        if (!entry.second.duration)
-            entry.second.duration = 1;
+        if (!me.duration)
+            me.duration = 1;
 
         if (no_initial)
-            merge_to.add_ench(entry.second);
+            merge_to.add_ench(me);
         else
-            merge_to.update_ench(entry.second);
+            merge_to.update_ench(me);
     }
 
-    for (auto &entry : merge_to.enchantments)
+    for (mon_enchant &me : merge_to.enchantments)
     {
-        if (from_ench.find(entry.first) == from_ench.end()
-            && entry.second.duration > 1)
+        if (!from_ench.contains(me.ench) && me.duration > 1)
         {
-            entry.second.duration = (merge_to_count * entry.second.duration)
-                                    / total_count;
+            me.duration = (merge_to_count * me.duration) / total_count;
 
-            merge_to.update_ench(entry.second);
+            merge_to.update_ench(me);
         }
     }
 }
@@ -48,6 +48,7 @@
 #include "mon-project.h"
 #include "mon-speak.h"
 #include "mon-tentacle.h"
+#include "mon-util.h"
 #include "nearby-danger.h"
 #include "religion.h"
 #include "rot.h"
@@ -2330,14 +2331,113 @@ void queue_monster_for_action(monster* mons)
     monster_queue.emplace(mons, mons->speed_increment);
 }
 
+// How often idle monsters are checked for dormancy, in auts. A monster
+// goes dormant at the second check in a row that finds it idle.
+#define DORMANCY_CHECK_AUT 100
+// How far from the player a monster must be to go dormant.
+#define DORMANCY_DISTANCE (LOS_RADIUS * 2)
+
+/**
+ * Is a monster idle and far enough from the player that it can stop taking
+ * turns for a while? Whatever would end that has to stop this being true,
+ * so that the monster is woken.
+ */
+static bool _idle_and_far_away(const monster &mons)
+{
+    if (!mons.asleep() && !(mons_is_wandering(mons) && mons.foe == MHITNOT))
+        return false;
+
+    // Things that need to happen every turn.
+    if (!mons.enchantments.empty()
+        || mons.is_summoned()
+        || mons.friendly()
+        || mons.pacified()
+        || mons.is_constricted()
+        || mons.is_constricting()
+        || mons_is_projectile(mons)
+        || mons_is_tentacle_head(mons_base_type(mons))
+        || mons_is_tentacle_or_tentacle_segment(mons.type)
+        || mons.type == MONS_SPATIAL_MAELSTROM
+        || (mons.flags & (MF_JUST_SUMMONED | MF_TAKING_STAIRS
+                          | MF_BANISHED)))
+    {
+        return false;
+    }
+
+    return grid_distance(mons.pos(), you.pos()) > DORMANCY_DISTANCE;
+}
+
+/**
+ * Bring a dormant monster up to date and let it take turns again. Its
+ * time dormant is caught up as if the player had been off the level.
+ *
+ * @param mons      The monster.
+ * @param max_moves The most grids it may move while catching up.
+ */
+void wake_dormant_monster(monster &mons, int max_moves)
+{
+    if (!(mons.flags & MF_DORMANT))
+        return;
+
+    mons.flags &= ~(MF_DORMANT | MF_IDLE);
+    const int since = mons.props[DORMANT_SINCE_KEY].get_int();
+    mons.props.erase(DORMANT_SINCE_KEY);
+    update_monster(mons, (you.elapsed_time - since) / 10, max_moves);
+}
+
+/**
+ * Should a monster sit out this turn? Monsters that are found idle and far
+ * away at two dormancy checks in a row go dormant, and wake as soon as
+ * that stops being so.
+ *
+ * Dormant monsters make none of their usual random rolls, energy included,
+ * and waking one rolls for its catch-up instead. So a seeded game's
+ * gameplay random numbers differ from before dormancy; level generation
+ * has generators of its own and isn't affected.
+ *
+ * @param mons  The monster.
+ * @param check Whether this turn is a dormancy check.
+ */
+static bool _dormant(monster &mons, bool check)
+{
+    if (crawl_state.game_is_arena())
+        return false;
+
+    const bool idle = _idle_and_far_away(mons);
+    if (mons.flags & MF_DORMANT)
+    {
+        if (idle)
+            return true;
+        // Don't let catching up walk it into the player's sight.
+        wake_dormant_monster(mons, grid_distance(mons.pos(), you.pos())
+                                   - LOS_RADIUS - 1);
+        return !mons.alive();
+    }
+
+    if (!idle)
+        mons.flags &= ~MF_IDLE;
+    else if (check && (mons.flags & MF_IDLE))
+    {
+        mons.flags |= MF_DORMANT;
+        mons.props[DORMANT_SINCE_KEY].get_int() = you.elapsed_time;
+        return true;
+    }
+    else if (check)
+        mons.flags |= MF_IDLE;
+    return false;
+}
+
 static void _clear_monster_flags()
 {
     // Clear any summoning flags so that lower indiced
     // monsters get their actions in the next round.
     // Also clear one-turn deep sleep flag.
     // XXX: MF_JUST_SLEPT only really works for player-cast hibernation.
-    for (auto &mons : menv_real)
-        mons.flags &= ~MF_JUST_SUMMONED & ~MF_JUST_SLEPT;
+    for (int i = 0; i < env.mons_used; ++i)
+        menv[i].flags &= ~MF_JUST_SUMMONED & ~MF_JUST_SLEPT;
+
+    // Forget slots freed at the end of the list this turn.
+    trim_monster_slots();
 }
 
 /**
@@ -2401,13 +2501,28 @@ static void _display_just_seen()
  */
 void handle_monsters(bool with_noise)
 {
+    const bool dormancy_check =
+        (you.elapsed_time + you.time_taken) / DORMANCY_CHECK_AUT
+        != you.elapsed_time / DORMANCY_CHECK_AUT;
+
+    vector<coord_def> awake;
     for (monster_iterator mi; mi; ++mi)
     {
+        if (_dormant(**mi, dormancy_check))
+            continue;
+
         _pre_monster_move(**mi);
         if (!invalid_monster(*mi) && mi->alive() && mi->has_action_energy())
+        {
             monster_queue.emplace(*mi, mi->speed_increment);
+            if (!mi->asleep())
+                awake.push_back(mi->pos());
+        }
     }
 
+    // Awake monsters will look around; work out what they see all at once.
+    cache_los_from(awake, LOS_DEFAULT);
+
     int tries = 0; // infinite loop protection, shouldn't be ever needed
     while (!monster_queue.empty())
     {
@@ -32,4 +32,8 @@ void handle_monster_move(monster* mon);
 
 void queue_monster_for_action(monster* mons);
 
+// When a dormant monster stopped taking turns, in elapsed_time.
+#define DORMANT_SINCE_KEY "dormant_since"
+void wake_dormant_monster(monster &mons, int max_moves);
+
 #define ENERGY_SUBMERGE(entry) (max(entry->energy_usage.swim / 2, 1))
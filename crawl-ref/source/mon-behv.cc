@@ -1020,6 +1020,12 @@ void behaviour_event(monster* mon, mon_event_type event, const actor *src,
     if (!mon->alive())
         return;
 
+    // Catch up first, so that the event acts on the monster as it is now,
+    // but leave it where it is: whatever caused the event is aimed there.
+    wake_dormant_monster(*mon, 0);
+    if (!mon->alive())
+        return;
+
     ASSERT(!crawl_state.game_is_arena() || src != &you);
     ASSERT_IN_BOUNDS_OR_ORIGIN(src_pos);
     if (mons_is_projectile(mon->type))
@@ -3715,6 +3715,38 @@ static mon_spell_slot _find_spell_prospect(const monster &mons,
     return hspell_pass[i];
 }
 
+/// What a spell's tracer depends on, besides the level itself.
+struct tracer_key
+{
+    coord_def source;
+    coord_def target;
+    spell_type spell;
+    beam_type flavour;
+    int range;
+    int damage_num, damage_size;
+    int ench_power;
+    bool explode;
+    bool ignore_good_idea;
+
+    bool operator < (const tracer_key &other) const
+    {
+        return std::tie(source, target, spell, flavour, range, damage_num,
+                        damage_size, ench_power, explode, ignore_good_idea)
+             < std::tie(other.source, other.target, other.spell,
+                        other.flavour, other.range, other.damage_num,
+                        other.damage_size, other.ench_power, other.explode,
+                        other.ignore_good_idea);
+    }
+};
+
+/**
+ * Tracers already found to advise against casting, while one monster picks
+ * its spell. Nothing on the level changes until the spell is chosen, so the
+ * same tracer fired again would only give the same answer. Tracers that
+ * advise casting are not remembered: the cast needs the traced beam.
+ */
+typedef set<tracer_key> tracer_refusals;
+
 /**
  * Would it be a good idea for the given monster to cast the given spell?
  *
@@ -3723,17 +3755,32 @@ static mon_spell_slot _find_spell_prospect(const monster &mons,
  * @param beem      A beam with the spell loaded into it; used as a tracer.
  * @param ignore_good_idea      Whether to be almost completely indiscriminate
  *                              with beam spells. XXX: refactor this out?
+ * @param refusals[in,out]  Tracers that already failed during this choice.
  */
 static bool _should_cast_spell(const monster &mons, spell_type spell,
-                               bolt &beem, bool ignore_good_idea)
+                               bolt &beem, bool ignore_good_idea,
+                               tracer_refusals &refusals)
 {
     // beam-type spells requiring tracers
     if (get_spell_flags(spell) & spflag::needs_tracer)
     {
         const bool explode = spell_is_direct_explosion(spell);
+        const tracer_key key = { mons.pos(), beem.target, spell,
+                                 beem.flavour, beem.range, beem.damage.num,
+                                 beem.damage.size, beem.ench_power, explode,
+                                 ignore_good_idea };
+        if (refusals.count(key))
+            return false;
+
+        // Tracers only draw random numbers in rare cases (guessing where an
+        // invisible player is); don't remember those answers.
+        const uint64_t draws = rng::current_generator().get_count();
         fire_tracer(&mons, beem, explode);
         // Good idea?
-        return mons_should_fire(beem, ignore_good_idea);
+        const bool good_idea = mons_should_fire(beem, ignore_good_idea);
+        if (!good_idea && rng::current_generator().get_count() == draws)
+            refusals.insert(key);
+        return good_idea;
     }
 
     // All direct-effect/summoning/self-enchantments/etc.
@@ -3807,11 +3854,13 @@ static monster_spells _find_usable_spells(monster &mons)
  *                        (from setup_targetting_beam())
  * @param spell           The spell to be targetted and cast.
  * @param ignore_good_idea  Whether to ignore most targeting constraints (ru)
+ * @param refusals[in,out]  Tracers that already failed during this choice.
  */
 static bool _target_and_justify_spell(monster &mons,
                                       bolt &beem,
                                       spell_type spell,
-                                      bool ignore_good_idea)
+                                      bool ignore_good_idea,
+                                      tracer_refusals &refusals)
 {
     // Setup the spell.
     setup_mons_cast(&mons, beem, spell);
@@ -3844,7 +3893,8 @@ static bool _target_and_justify_spell(monster &mons,
         return false;
     }
 
-    return _should_cast_spell(mons, spell, beem, ignore_good_idea);
+    return _should_cast_spell(mons, spell, beem, ignore_good_idea,
+                              refusals);
 }
 
 /**
@@ -3874,6 +3924,7 @@ static mon_spell_slot _choose_spell_to_cast(monster &mons,
                 return slot;
 
     bolt orig_beem = beem;
+    tracer_refusals refusals;
 
     // Promote the casting of useful spells for low-HP monsters.
     // (kraken should always cast their escape spell of inky).
@@ -3890,7 +3941,7 @@ static mon_spell_slot _choose_spell_to_cast(monster &mons,
         {
             bolt targ_beam = orig_beem;
             if (_target_and_justify_spell(mons, targ_beam, slot.spell,
-                                          ignore_good_idea)
+                                          ignore_good_idea, refusals)
                 && one_chance_in(++found_spell))
             {
                 chosen_slot = slot;
@@ -3931,7 +3982,7 @@ static mon_spell_slot _choose_spell_to_cast(monster &mons,
         beem = orig_beem;
 
         if (_target_and_justify_spell(mons, beem, chosen_slot.spell,
-                                       ignore_good_idea))
+                                       ignore_good_idea, refusals))
         {
             ASSERT(chosen_slot.spell != SPELL_NO_SPELL);
             return chosen_slot;
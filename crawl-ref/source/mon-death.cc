@@ -2763,7 +2763,6 @@ item_def* mounted_kill(monster* daddy, monster_type mc, killer_type killer,
 
     // Need to copy ENCH_ABJ etc. or we could get real XP/meat from a summon.
     mon.enchantments = daddy->enchantments;
-    mon.ench_cache = daddy->ench_cache;
 
     mon.attitude = daddy->attitude;
     mon.damage_friendly = daddy->damage_friendly;
@@ -2985,8 +2984,8 @@ string summoned_poof_msg(const monster* mons, const item_def &item)
 bool mons_is_mons_class(const monster* mons, monster_type type)
 {
     return mons->type == type
-           || mons->props.exists(ORIGINAL_TYPE_KEY)
-              && mons->props[ORIGINAL_TYPE_KEY].get_int() == type;
+           || mons->props.exists(prop_key::original_type)
+              && mons->props[prop_key::original_type].get_int() == type;
 }
 
 /**
@@ -61,37 +61,6 @@ static void _place_thunder_ring(const monster &mons)
         }
 }
 
-#ifdef DEBUG_ENCH_CACHE_DIAGNOSTICS
-bool monster::has_ench(enchant_type ench) const
-{
-    mon_enchant e = get_ench(ench);
-    if (e.ench == ench)
-    {
-        if (!ench_cache[ench])
-        {
-            die("monster %s has ench '%s' not in cache",
-                name(DESC_PLAIN).c_str(),
-                string(e).c_str());
-        }
-    }
-    else if (e.ench == ENCH_NONE)
-    {
-        if (ench_cache[ench])
-        {
-            die("monster %s has no ench '%s' but cache says it does",
-                name(DESC_PLAIN).c_str(),
-                string(mon_enchant(ench)).c_str());
-        }
-    }
-    else
-    {
-        die("get_ench returned '%s' when asked for '%s'",
-            string(e).c_str(),
-            string(mon_enchant(ench)).c_str());
-    }
-    return ench_cache[ench];
-}
-#endif
 
 bool monster::has_ench(enchant_type ench, enchant_type ench2) const
 {
@@ -113,10 +82,9 @@ mon_enchant monster::get_ench(enchant_type ench1,
 
     for (int e = ench1; e <= ench2; ++e)
     {
-        auto i = enchantments.find(static_cast<enchant_type>(e));
-
-        if (i != enchantments.end())
-            return i->second;
+        const enchant_type et = static_cast<enchant_type>(e);
+        if (const mon_enchant *me = enchantments.find(et))
+            return *me;
     }
 
     return mon_enchant();
@@ -126,7 +94,7 @@ void monster::update_ench(const mon_enchant &ench)
 {
     if (ench.ench != ENCH_NONE)
     {
-        if (mon_enchant *curr_ench = map_find(enchantments, ench.ench))
+        if (mon_enchant *curr_ench = enchantments.find(ench.ench))
             *curr_ench = ench;
     }
 }
@@ -166,14 +134,13 @@ bool monster::add_ench(const mon_enchant &ench)
     }
 
     bool new_enchantment = false;
-    mon_enchant *added = map_find(enchantments, ench.ench);
+    mon_enchant *added = enchantments.find(ench.ench);
     if (added)
         *added += ench;
     else
     {
         new_enchantment = true;
-        added = &(enchantments[ench.ench] = ench);
-        ench_cache.set(ench.ench, true);
+        added = &enchantments.insert(ench);
     }
 
     // If the duration is not set, we must calculate it (depending on the
@@ -254,7 +221,6 @@ void monster::add_enchantment_effect(const mon_enchant &ench, bool quiet)
         {
             // temporarly change our attitude back (XXX: scary code...)
             unwind_var<mon_enchant_list> enchants(enchantments, mon_enchant_list{});
-            unwind_var<FixedBitVector<NUM_ENCHANTMENTS>> ecache(ench_cache, {});
             end_flayed_effect(this);
         }
         del_ench(ENCH_STILL_WINDS);
@@ -418,18 +384,16 @@ static bool _prepare_del_ench(monster* mon, const mon_enchant &me)
 
 bool monster::del_ench(enchant_type ench, bool quiet, bool effect)
 {
-    auto i = enchantments.find(ench);
-    if (i == enchantments.end())
+    const mon_enchant *found = enchantments.find(ench);
+    if (!found)
         return false;
 
-    const mon_enchant me = i->second;
-    const enchant_type et = i->first;
+    const mon_enchant me = *found;
 
     if (!_prepare_del_ench(this, me))
         return false;
 
-    enchantments.erase(et);
-    ench_cache.set(et, false);
+    enchantments.erase(ench);
     if (effect)
         remove_enchantment_effect(me, quiet);
     return true;
@@ -1052,7 +1016,7 @@ string monster::describe_enchantments() const
     {
         if (i != enchantments.begin())
             oss << ", ";
-        oss << string(i->second);
+        oss << string(*i);
     }
     return oss.str();
 }
@@ -1581,7 +1545,10 @@ void monster::apply_enchantment(const mon_enchant &me)
                 mprf("The portal closes; %s is severed.", name(DESC_THE).c_str());
 
             if (env.grid(base_position) == DNGN_MALIGN_GATEWAY)
+            {
                 env.grid(base_position) = DNGN_FLOOR;
+                set_terrain_changed(base_position);
+            }
 
             maybe_bloodify_square(base_position);
             add_ench(ENCH_SEVERED);
@@ -1926,13 +1893,13 @@ void monster::apply_enchantments()
     // We process an enchantment only if it existed both at the start of this
     // function and when getting to it in order; any enchantment can add, modify
     // or remove others -- or even itself.
-    FixedBitVector<NUM_ENCHANTMENTS> ec = ench_cache;
+    FixedBitVector<NUM_ENCHANTMENTS> ec = enchantments.types();
 
     // The ordering in enchant_type makes sure that "super-enchantments"
     // like berserk time out before their parts.
     for (int i = 0; i < NUM_ENCHANTMENTS; ++i)
         if (ec[i] && has_ench(static_cast<enchant_type>(i)))
-            apply_enchantment(enchantments.find(static_cast<enchant_type>(i))->second);
+            apply_enchantment(*enchantments.find(static_cast<enchant_type>(i)));
 }
 
 // Used to adjust time durations in calc_duration() for monster speed.
@@ -2060,6 +2027,48 @@ static const char *_mons_enchantment_name(enchant_type ench)
     return enchant_names[ench];
 }
 
+mon_enchant &mon_enchant_list::insert(const mon_enchant &me)
+{
+    ASSERT(!present[me.ench]);
+    const int i = index_of(me.ench);
+    if (large.empty() && count == INLINE_SIZE)
+        large.assign(small, small + count);
+
+    present.set(me.ench);
+    ++count;
+    if (!large.empty())
+        return *large.insert(large.begin() + i, me);
+
+    for (int j = count - 1; j > i; --j)
+        small[j] = small[j - 1];
+    return small[i] = me;
+}
+
+bool mon_enchant_list::erase(enchant_type ench)
+{
+    if (!present[ench])
+        return false;
+
+    const int i = index_of(ench);
+    present.set(ench, false);
+    --count;
+    if (!large.empty())
+        large.erase(large.begin() + i);
+    else
+    {
+        for (int j = i; j < count; ++j)
+            small[j] = small[j + 1];
+    }
+    return true;
+}
+
+void mon_enchant_list::clear()
+{
+    present.reset();
+    count = 0;
+    large.clear();
+}
+
 enchant_type name_to_ench(const char *name)
 {
     for (unsigned int i = ENCH_NONE; i < ARRAYSZ(enchant_names); i++)
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "bitary.h"
 #include "enchant-type.h"
 
 #define INFINITE_DURATION  30000
@@ -54,4 +55,69 @@ private:
     int calc_duration(const monster* mons, const mon_enchant *added) const;
 };
 
+/**
+ * A monster's enchantments, in enchant_type order.
+ *
+ * Monsters rarely carry more than a few enchantments, so they are kept
+ * sorted in a small inline array, moving to the heap only if that fills up.
+ * A bitset of the types present answers has_ench() without a search.
+ */
+class mon_enchant_list
+{
+public:
+    typedef mon_enchant *iterator;
+    typedef const mon_enchant *const_iterator;
+
+    mon_enchant_list() : count(0) { }
+
+    bool contains(enchant_type ench) const { return present[ench]; }
+    const FixedBitVector<NUM_ENCHANTMENTS> &types() const { return present; }
+
+    mon_enchant *find(enchant_type ench)
+    {
+        return present[ench] ? begin() + index_of(ench) : nullptr;
+    }
+    const mon_enchant *find(enchant_type ench) const
+    {
+        return present[ench] ? begin() + index_of(ench) : nullptr;
+    }
+
+    // The enchantment must not already be present.
+    mon_enchant &insert(const mon_enchant &me);
+    bool erase(enchant_type ench);
+    void clear();
+
+    bool empty() const { return !count; }
+    int size() const { return count; }
+
+    iterator begin() { return data(); }
+    iterator end() { return data() + count; }
+    const_iterator begin() const { return data(); }
+    const_iterator end() const { return data() + count; }
+
+private:
+    static const int INLINE_SIZE = 6;
+
+    FixedBitVector<NUM_ENCHANTMENTS> present;
+    int count;
+    mon_enchant small[INLINE_SIZE];
+    vector<mon_enchant> large;  // All of them, once small has filled up.
+
+    mon_enchant *data() { return large.empty() ? small : large.data(); }
+    const mon_enchant *data() const
+    {
+        return large.empty() ? small : large.data();
+    }
+
+    // Where the enchantment is, or would go.
+    int index_of(enchant_type ench) const
+    {
+        const mon_enchant *d = data();
+        int i = 0;
+        while (i < count && d[i].ench < ench)
+            ++i;
+        return i;
+    }
+};
+
 enchant_type name_to_ench(const char *name);
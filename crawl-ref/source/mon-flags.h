@@ -240,8 +240,10 @@ enum monster_flag_type : uint64_t
     /// Monster gets various archery boosts.
     MF_ARCHER             = BIT(22),
 
-                          //BIT(23),
-                          //BIT(24),
+    /// idle and far from the player at the last dormancy check
+    MF_IDLE               = BIT(23),
+    /// skipped by handle_monsters() until something wakes it
+    MF_DORMANT            = BIT(24),
                           //BIT(25),
 
     /// This monster cannot regenerate.
@@ -215,7 +215,7 @@ bool try_pathfind(monster* mon)
     if (range > 0)
         mp.set_range(range);
 
-    if (mp.init_pathfind(mon, targpos))
+    if (mp.init_shared_pathfind(mon, targpos))
     {
         mon->travel_path = mp.calc_waypoints();
         if (!mon->travel_path.empty())
@@ -511,7 +511,7 @@ static bool _handle_monster_travelling(monster* mon)
 
             // The last coordinate in the path vector is our destination.
             const int len = mon->travel_path.size();
-            if (mp.init_pathfind(mon, mon->travel_path[len-1]))
+            if (mp.init_long_pathfind(mon, mon->travel_path[len-1]))
             {
                 mon->travel_path = mp.calc_waypoints();
                 if (!mon->travel_path.empty())
@@ -677,7 +677,7 @@ static bool _handle_monster_patrolling(monster* mon)
         // What he will see is them swarming back to the Hive
         // entrance after some time, and that is what matters.
         monster_pathfind mp;
-        if (mp.init_pathfind(mon, mon->patrol_point))
+        if (mp.init_long_pathfind(mon, mon->patrol_point))
         {
             mon->travel_path = mp.calc_waypoints();
             if (!mon->travel_path.empty())
@@ -766,7 +766,7 @@ static bool _band_wander_target(monster * mon)
         monster_pathfind mp;
         mp.set_range(1000);
 
-        if (mp.init_pathfind(mon, band_leader->pos()))
+        if (mp.init_long_pathfind(mon, band_leader->pos()))
         {
             mon->travel_path = mp.calc_waypoints();
             if (!mon->travel_path.empty())
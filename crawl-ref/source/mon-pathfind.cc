@@ -2,6 +2,10 @@
 
 #include "mon-pathfind.h"
 
+#include <queue>
+
+#include "act-iter.h"
+#include "coordit.h"
 #include "directn.h"
 #include "env.h"
 #include "los.h"
@@ -62,16 +66,421 @@ int mons_tracking_range(const monster* mon)
     return range;
 }
 
+// The hash holds positions by estimated total path length, which can't
+// exceed the number of grids.
+#define PATHFIND_HASH_SIZE (GXM * GYM)
+
+// Grids are numbered x * GYM + y in the hash's lists.
+static int _pf_index(const coord_def& p)
+{
+    return p.x * GYM + p.y;
+}
+
+static coord_def _pf_pos(int i)
+{
+    return coord_def(i / GYM, i % GYM);
+}
+
+// The per-search state of monster_pathfind. It's too big to set up from
+// scratch for each search, so it's stamped with a search generation
+// instead of cleared: a grid's entries (and a hash bucket) only count
+// if they were written in the current generation.
+struct pathfind_workspace
+{
+    uint32_t generation;
+
+    // The generation in which a grid was first reached.
+    uint32_t reached[GXM][GYM];
+    // The distance from start, for reached grids.
+    int dist[GXM][GYM];
+    // Where we came from on a given shortest path.
+    int8_t prev[GXM][GYM];
+    // Whether a reached grid is currently in the hash.
+    bool hashed[GXM][GYM];
+
+    // Each bucket of the hash is a doubly linked list of the grids with
+    // that estimated total path length, in the order they were added.
+    uint32_t bucket_gen[PATHFIND_HASH_SIZE];
+    int16_t first[PATHFIND_HASH_SIZE];
+    int16_t last[PATHFIND_HASH_SIZE];
+    int16_t next[GXM * GYM];
+    int16_t before[GXM * GYM];
+    // The grid we came from, when searching between sectors.
+    int16_t from[GXM * GYM];
+
+    void new_search()
+    {
+        if (++generation == 0)
+        {
+            memset(reached, 0, sizeof(reached));
+            memset(bucket_gen, 0, sizeof(bucket_gen));
+            generation = 1;
+        }
+    }
+
+    int get_dist(const coord_def& p) const
+    {
+        return reached[p.x][p.y] == generation ? dist[p.x][p.y]
+                                               : INFINITE_DISTANCE;
+    }
+
+    void set_dist(const coord_def& p, int d)
+    {
+        if (reached[p.x][p.y] != generation)
+        {
+            reached[p.x][p.y] = generation;
+            hashed[p.x][p.y] = false;
+        }
+        dist[p.x][p.y] = d;
+    }
+
+    bool bucket_empty(int b) const
+    {
+        return bucket_gen[b] != generation || first[b] < 0;
+    }
+
+    // Add p, whose distance has been set, to the end of bucket b.
+    void push(int b, const coord_def& p)
+    {
+        ASSERT_RANGE(b, 0, PATHFIND_HASH_SIZE);
+        if (bucket_gen[b] != generation)
+        {
+            bucket_gen[b] = generation;
+            first[b] = last[b] = -1;
+        }
+        const int i = _pf_index(p);
+        next[i] = -1;
+        before[i] = last[b];
+        if (last[b] >= 0)
+            next[last[b]] = i;
+        else
+            first[b] = i;
+        last[b] = i;
+        hashed[p.x][p.y] = true;
+    }
+
+    // Remove p from bucket b, if it's in the hash.
+    void remove(int b, const coord_def& p)
+    {
+        if (reached[p.x][p.y] != generation || !hashed[p.x][p.y])
+            return;
+        const int i = _pf_index(p);
+        if (before[i] >= 0)
+            next[before[i]] = next[i];
+        else
+            first[b] = next[i];
+        if (next[i] >= 0)
+            before[next[i]] = before[i];
+        else
+            last[b] = before[i];
+        hashed[p.x][p.y] = false;
+    }
+
+    // Remove and return the last grid in the nonempty bucket b.
+    coord_def pop(int b)
+    {
+        const coord_def p = _pf_pos(last[b]);
+        remove(b, p);
+        return p;
+    }
+};
+COMPILE_CHECK(GXM * GYM <= 32767);
+
+// Workspaces not in use by any monster_pathfind.
+static vector<pathfind_workspace*> free_workspaces;
+
+static pathfind_workspace* _get_workspace()
+{
+    if (free_workspaces.empty())
+    {
+        pathfind_workspace *ws = new pathfind_workspace;
+        ws->generation = 0;
+        memset(ws->reached, 0, sizeof(ws->reached));
+        memset(ws->bucket_gen, 0, sizeof(ws->bucket_gen));
+        return ws;
+    }
+
+    pathfind_workspace *ws = free_workspaces.back();
+    free_workspaces.pop_back();
+    return ws;
+}
+
+// How a monster gets about, for sharing the work of finding paths.
+enum class move_kind
+{
+    walker,
+    flyer,
+    amphibious,
+};
+
+// Monsters that move alike can share the work of finding paths. Whichever
+// monster of a class first needs a shared map fills it in, so the map is
+// only a guide for the others: each still checks every step it takes
+// against its own traversability and traps, and searches on its own when
+// the map doesn't lead it to its target.
+struct move_class
+{
+    move_kind kind;
+    bool opens_doors;
+    bool friendly;
+
+    bool operator==(const move_class &other) const
+    {
+        return kind == other.kind && opens_doors == other.opens_doors
+               && friendly == other.friendly;
+    }
+};
+
+static bool _traverse_in_sight(const monster* mon)
+{
+    return !crawl_state.game_is_arena()
+           && mon->friendly() && mon->is_summoned()
+           && you.see_cell_no_trans(mon->pos());
+}
+
+// Which movement class mon is in. Returns false if mon should search for
+// its own paths instead.
+static bool _move_class(const monster* mon, move_class &cls)
+{
+    // Ghosts and the like vary too much within a type; these two get to
+    // path through their friends; and summons staying in sight of the
+    // player depend on where the player is.
+    if (mon->ghost
+        || mon->type == MONS_THORN_HUNTER
+        || mon->type == MONS_WANDERING_MUSHROOM
+        || _traverse_in_sight(mon))
+    {
+        return false;
+    }
+
+    if (mon->airborne())
+        cls.kind = move_kind::flyer;
+    else if (mons_habitat(*mon) == HT_LAND)
+        cls.kind = move_kind::walker;
+    else if (mons_habitat(*mon) == HT_AMPHIBIOUS)
+        cls.kind = move_kind::amphibious;
+    else
+        return false;
+
+    cls.opens_doors = mons_itemuse(*mon) >= MONUSE_OPEN_DOORS;
+    cls.friendly    = mon->friendly();
+    return true;
+}
+
+// Hostile monsters hunting the same foe share a map of distances to the
+// foe, filled in once per turn for each movement class, rather than each
+// searching for its own path there.
+struct flow_class
+{
+    coord_def target;
+    int range;
+    move_class moves;
+
+    bool operator==(const flow_class &other) const
+    {
+        return target == other.target && range == other.range
+               && moves == other.moves;
+    }
+};
+
+// The distances to target from each grid a monster of the class could
+// pass through, not counting the cost of leaving the grid itself.
+struct flow_field
+{
+    flow_class cls;
+    int16_t dist[GXM][GYM];
+};
+COMPILE_CHECK(INFINITE_DISTANCE <= INT16_MAX);
+
+#define MAX_FLOW_FIELDS 16
+static flow_field flow_fields[MAX_FLOW_FIELDS];
+static int num_flow_fields = 0;
+// The turn and LOS epoch the flow fields were filled in; since they depend
+// on terrain and sight-blocking monsters, they're dropped when those
+// change.
+static int flow_turn = -1;
+static uint32_t flow_epoch = 0;
+
+// Which flow fields mon can use when heading for dest. Returns false if
+// mon should search for its own path instead.
+static bool _flow_class(const monster* mon, const coord_def& dest, int range,
+                        flow_class &cls)
+{
+    // Allies tend to have destinations of their own.
+    if (!range || mon->wont_attack())
+        return false;
+
+    cls.target = dest;
+    cls.range  = range;
+    return _move_class(mon, cls.moves);
+}
+
+static flow_field* _find_flow_field(const flow_class &cls)
+{
+    if (flow_turn != you.num_turns || flow_epoch != get_los_epoch())
+    {
+        num_flow_fields = 0;
+        flow_turn = you.num_turns;
+        flow_epoch = get_los_epoch();
+    }
+
+    for (int i = 0; i < num_flow_fields; ++i)
+        if (flow_fields[i].cls == cls)
+            return &flow_fields[i];
+
+    return nullptr;
+}
+
+// For long journeys, the level is split into sectors, linked by
+// entrances wherever a monster of a given movement class could cross from
+// one sector into the next. The paths between the entrances of each sector
+// are worked out once, so searching across the level only has to look at
+// entrances; the grid by grid path is then found one sector at a time.
+#define SECTORS_X ((GXM + SECTOR_SIZE - 1) / SECTOR_SIZE)
+#define SECTORS_Y ((GYM + SECTOR_SIZE - 1) / SECTOR_SIZE)
+
+struct sector_node
+{
+    coord_def pos;
+    // The entrances of neighbouring sectors we can step to from here.
+    vector<coord_def> across;
+    // The other nodes of the sector reachable without leaving it, by
+    // index, and the cost of getting there.
+    vector<pair<int, int>> paths;
+};
+
+struct sector_graph
+{
+    move_class cls;
+    bool dirty[SECTORS_X][SECTORS_Y];
+    vector<sector_node> nodes[SECTORS_X][SECTORS_Y];
+    // The index of the node at each grid in its sector's nodes, or -1.
+    int16_t node_at[GXM][GYM];
+};
+
+// The sector graphs of the movement classes seen on this level, most
+// recently used first.
+#define MAX_SECTOR_GRAPHS 8
+static vector<sector_graph*> sector_graphs;
+
+static coord_def _sector_of(const coord_def& p)
+{
+    return coord_def(p.x / SECTOR_SIZE, p.y / SECTOR_SIZE);
+}
+
+static bool _sector_valid(const coord_def& s)
+{
+    return s.x >= 0 && s.x < SECTORS_X && s.y >= 0 && s.y < SECTORS_Y;
+}
+
+static coord_def _sector_min(const coord_def& s)
+{
+    return s * SECTOR_SIZE;
+}
+
+static coord_def _sector_max(const coord_def& s)
+{
+    return coord_def(min(s.x * SECTOR_SIZE + SECTOR_SIZE, GXM) - 1,
+                     min(s.y * SECTOR_SIZE + SECTOR_SIZE, GYM) - 1);
+}
+
+static sector_graph* _find_sector_graph(const move_class &cls)
+{
+    for (unsigned int i = 0; i < sector_graphs.size(); ++i)
+    {
+        if (sector_graphs[i]->cls == cls)
+        {
+            sector_graph *graph = sector_graphs[i];
+            sector_graphs.erase(sector_graphs.begin() + i);
+            sector_graphs.insert(sector_graphs.begin(), graph);
+            return graph;
+        }
+    }
+
+    sector_graph *graph;
+    if (sector_graphs.size() < MAX_SECTOR_GRAPHS)
+        graph = new sector_graph;
+    else
+    {
+        graph = sector_graphs.back();
+        sector_graphs.pop_back();
+    }
+    sector_graphs.insert(sector_graphs.begin(), graph);
+
+    graph->cls = cls;
+    for (int x = 0; x < SECTORS_X; ++x)
+        for (int y = 0; y < SECTORS_Y; ++y)
+        {
+            graph->dirty[x][y] = true;
+            graph->nodes[x][y].clear();
+        }
+    for (int x = 0; x < GXM; ++x)
+        for (int y = 0; y < GYM; ++y)
+            graph->node_at[x][y] = -1;
+    return graph;
+}
+
+// Terrain at p has changed, which affects the entrances of its sector and
+// the neighbouring sectors sharing an edge with it.
+void pathfind_terrain_changed(const coord_def& p)
+{
+    const coord_def sec = _sector_of(p);
+    for (sector_graph *graph : sector_graphs)
+        for (int i = -1; i < 4; ++i)
+        {
+            const coord_def s = i < 0 ? sec : sec + Compass[i * 2];
+            if (_sector_valid(s))
+                graph->dirty[s.x][s.y] = true;
+        }
+}
+
+void pathfind_level_changed()
+{
+    for (sector_graph *graph : sector_graphs)
+        for (int x = 0; x < SECTORS_X; ++x)
+            for (int y = 0; y < SECTORS_Y; ++y)
+                graph->dirty[x][y] = true;
+}
+
+// Stationary monsters block paths just like terrain does (see
+// traversable()), but nothing tells us when they turn up, move or die. So
+// before using the sector graphs, compare them with where they were the
+// last time, and treat any difference as a change of terrain.
+static vector<coord_def> immobile_monsters;
+
+static void _update_immobile_monsters()
+{
+    vector<coord_def> now;
+    for (monster_iterator mi; mi; ++mi)
+        if (mi->is_stationary())
+            now.push_back(mi->pos());
+    sort(now.begin(), now.end());
+
+    if (now != immobile_monsters)
+    {
+        vector<coord_def> changed;
+        set_symmetric_difference(now.begin(), now.end(),
+                                 immobile_monsters.begin(),
+                                 immobile_monsters.end(),
+                                 back_inserter(changed));
+        for (const coord_def &p : changed)
+            pathfind_terrain_changed(p);
+        immobile_monsters.swap(now);
+    }
+}
+
 //#define DEBUG_PATHFIND
 monster_pathfind::monster_pathfind()
     : mons(nullptr), start(), target(), pos(), allow_diagonals(true),
-      traverse_unmapped(false), range(0), min_length(0), max_length(0),
-      dist(), prev(), hash()
+      traverse_unmapped(false), traverse_in_sight(false), class_wide(false),
+      range(0), min_length(0), max_length(0), ws(_get_workspace())
 {
+    ws->new_search();
 }
 
 monster_pathfind::~monster_pathfind()
 {
+    free_workspaces.push_back(ws);
 }
 
 void monster_pathfind::set_range(int r)
@@ -82,7 +491,7 @@ void monster_pathfind::set_range(int r)
 
 coord_def monster_pathfind::next_pos(const coord_def &c) const
 {
-    return c + Compass[prev[c.x][c.y]];
+    return c + Compass[ws->prev[c.x][c.y]];
 }
 
 // The main method in the monster_pathfind class.
@@ -97,9 +506,7 @@ bool monster_pathfind::init_pathfind(const monster* mon, coord_def dest,
     pos    = start;
     allow_diagonals   = diag;
     traverse_unmapped = pass_unmapped;
-    traverse_in_sight = (!crawl_state.game_is_arena()
-                         && mon->friendly() &&  mon->is_summoned()
-                         && you.see_cell_no_trans(mon->pos()));
+    traverse_in_sight = _traverse_in_sight(mon);
 
     // Easy enough. :P
     if (start == target)
@@ -128,6 +535,414 @@ bool monster_pathfind::init_pathfind(coord_def src, coord_def dest, bool diag,
     return start_pathfind(msg);
 }
 
+// Like init_pathfind(), but shares the work with other monsters of the
+// same movement class heading for dest this turn, by following a flow
+// field towards it. Falls back to searching for a path of our own if
+// there's no suitable flow field or it doesn't get us to dest.
+// set_range() as for init_pathfind().
+bool monster_pathfind::init_shared_pathfind(const monster* mon, coord_def dest)
+{
+    flow_class cls;
+    if (!_flow_class(mon, dest, range, cls))
+        return init_pathfind(mon, dest);
+
+    mons   = mon;
+    start  = mon->pos();
+    target = dest;
+    pos    = start;
+    allow_diagonals   = true;
+    traverse_unmapped = false;
+    traverse_in_sight = false;
+
+    if (start == target)
+        return true;
+
+    flow_field *field = _find_flow_field(cls);
+    if (!field)
+    {
+        if (num_flow_fields == MAX_FLOW_FIELDS)
+            num_flow_fields = 0;
+        field = &flow_fields[num_flow_fields++];
+        field->cls = cls;
+        fill_flow_field(*field);
+    }
+
+    // Walk down the field to the target, recording the steps taken just
+    // like start_pathfind() would. Each step must take us somewhere the
+    // field says is closer, so the walk always ends, and somewhere we
+    // can go ourselves, traps included.
+    ws->new_search();
+    while (pos != target)
+    {
+        int best_dir = -1;
+        int best_dist = INFINITE_DISTANCE;
+        const int here = field->dist[pos.x][pos.y];
+
+        // Orthogonals first, to reduce zigzagging.
+        for (int i = 0; i < 8; ++i)
+        {
+            const int dir = (i * 2 + i / 4) % 8;
+            const coord_def npos = pos + Compass[dir];
+            if (!in_bounds(npos))
+                continue;
+
+            int distance = npos == target ? 0 : field->dist[npos.x][npos.y];
+            if (distance >= here
+                || npos != target && !traversable(npos))
+            {
+                continue;
+            }
+
+            distance += travel_cost(npos);
+            if (distance < best_dist)
+            {
+                best_dir = dir;
+                best_dist = distance;
+            }
+        }
+
+        if (best_dir < 0)
+            return init_pathfind(mon, dest);
+
+        pos += Compass[best_dir];
+        ws->prev[pos.x][pos.y] = (best_dir + 4) % 8;
+    }
+
+    return true;
+}
+
+// Fill in the distances of a new flow field, by searching outwards from
+// the target. The first monster of a class to want the field does this on
+// behalf of the others, which is fine since it goes by class properties
+// only (see class_wide).
+void monster_pathfind::fill_flow_field(flow_field &field)
+{
+    for (int x = 0; x < GXM; x++)
+        for (int y = 0; y < GYM; y++)
+            field.dist[x][y] = INFINITE_DISTANCE;
+
+    // As in start_pathfind(), no path may run further than range from
+    // the target or cost more than twice that.
+    const int max_dist = range * 2;
+    vector<vector<coord_def>> queue(max_dist + 1);
+    queue[0].push_back(target);
+    field.dist[target.x][target.y] = 0;
+
+    class_wide = true;
+    for (int d = 0; d <= max_dist; d++)
+    {
+        for (unsigned int i = 0; i < queue[d].size(); i++)
+        {
+            const coord_def next = queue[d][i];
+            if (field.dist[next.x][next.y] != d)
+                continue;
+
+            // The cost of moving from any neighbour onto next.
+            pos = next;
+            const int distance = d + travel_cost(next);
+            if (distance > max_dist)
+                continue;
+
+            for (adjacent_iterator ai(next); ai; ++ai)
+            {
+                if (!in_bounds(*ai)
+                    || grid_distance(*ai, target) > range
+                    || distance >= field.dist[ai->x][ai->y]
+                    || !traversable(*ai))
+                {
+                    continue;
+                }
+
+                field.dist[ai->x][ai->y] = distance;
+                queue[distance].push_back(*ai);
+            }
+        }
+    }
+    class_wide = false;
+}
+
+// Like init_pathfind(), but if dest is further than a sector away, plan
+// the journey from sector to sector and only find the actual path through
+// the first one. calc_waypoints() then adds the remaining sector entrances
+// on the way to dest.
+bool monster_pathfind::init_long_pathfind(const monster* mon, coord_def dest)
+{
+    coarse_path.clear();
+
+    move_class cls;
+    const coord_def src_sector = _sector_of(mon->pos());
+    if (grid_distance(mon->pos(), dest) <= SECTOR_SIZE
+        || _sector_of(dest) == src_sector
+        || !_move_class(mon, cls))
+    {
+        return init_pathfind(mon, dest);
+    }
+
+    mons   = mon;
+    start  = mon->pos();
+    target = dest;
+    allow_diagonals   = true;
+    traverse_unmapped = false;
+    traverse_in_sight = false;
+
+    _update_immobile_monsters();
+    sector_graph &graph = *_find_sector_graph(cls);
+    update_sectors(graph);
+
+    vector<coord_def> route;
+    if (!sector_route(graph, route))
+        return init_pathfind(mon, dest);
+
+    // Find the way to the first grid beyond our own sector, and just head
+    // for the sector entrances after that.
+    unsigned int leg = 0;
+    while (_sector_of(route[leg]) == src_sector)
+        ++leg;
+    for (unsigned int i = leg + 1; i < route.size(); ++i)
+        if (_sector_of(route[i]) != _sector_of(route[i - 1]))
+            coarse_path.push_back(route[i]);
+    if (coarse_path.empty() || coarse_path.back() != dest)
+        coarse_path.push_back(dest);
+
+    if (!init_pathfind(mon, route[leg]))
+    {
+        coarse_path.clear();
+        return init_pathfind(mon, dest);
+    }
+    return true;
+}
+
+// Find the costs of the shortest paths between from and every grid of its
+// sector, without leaving the sector. If reverse is set, find the costs of
+// getting from every grid to from instead. Grids that aren't reachable are
+// left at INFINITE_DISTANCE.
+void monster_pathfind::sector_search(const coord_def& from, bool reverse,
+                                     int dist[SECTOR_SIZE][SECTOR_SIZE])
+{
+    const coord_def sec = _sector_of(from);
+    const coord_def low = _sector_min(sec);
+    const coord_def high = _sector_max(sec);
+
+    for (int x = 0; x < SECTOR_SIZE; ++x)
+        for (int y = 0; y < SECTOR_SIZE; ++y)
+            dist[x][y] = INFINITE_DISTANCE;
+
+    typedef pair<int, coord_def> queued_pos;
+    priority_queue<queued_pos, vector<queued_pos>, greater<queued_pos>> queue;
+    dist[from.x - low.x][from.y - low.y] = 0;
+    queue.push(queued_pos(0, from));
+
+    while (!queue.empty())
+    {
+        const queued_pos next = queue.top();
+        queue.pop();
+        pos = next.second;
+        if (next.first != dist[pos.x - low.x][pos.y - low.y])
+            continue;
+
+        for (adjacent_iterator ai(pos); ai; ++ai)
+        {
+            if (ai->x < low.x || ai->x > high.x
+                || ai->y < low.y || ai->y > high.y
+                || !in_bounds(*ai) || !traversable(*ai))
+            {
+                continue;
+            }
+
+            const int distance = next.first
+                                 + travel_cost(reverse ? pos : *ai);
+            int &old_dist = dist[ai->x - low.x][ai->y - low.y];
+            if (distance < old_dist)
+            {
+                old_dist = distance;
+                queue.push(queued_pos(distance, *ai));
+            }
+        }
+    }
+}
+
+// Rebuild the entrances and paths of the sectors whose terrain changed.
+void monster_pathfind::update_sectors(sector_graph &graph)
+{
+    class_wide = true;
+
+    vector<coord_def> rebuilt;
+    for (int sx = 0; sx < SECTORS_X; ++sx)
+        for (int sy = 0; sy < SECTORS_Y; ++sy)
+        {
+            if (!graph.dirty[sx][sy])
+                continue;
+
+            const coord_def sec(sx, sy);
+            const coord_def low = _sector_min(sec);
+            const coord_def high = _sector_max(sec);
+            vector<sector_node> &nodes = graph.nodes[sx][sy];
+            for (const sector_node &node : nodes)
+                graph.node_at[node.pos.x][node.pos.y] = -1;
+            nodes.clear();
+
+            // Each edge shared with another sector gets an entrance in the
+            // middle of every stretch of grids that can be crossed straight
+            // into the other sector. Both sectors find the same entrances.
+            for (int i = 0; i < 4; ++i)
+            {
+                const coord_def dir = Compass[i * 2];
+                if (!_sector_valid(sec + dir))
+                    continue;
+
+                // Walk along the edge, from the corner c onwards.
+                const coord_def c(dir.x > 0 ? high.x : low.x,
+                                  dir.y > 0 ? high.y : low.y);
+                const coord_def along(dir.x ? 0 : 1, dir.y ? 0 : 1);
+                const int len = dir.x ? high.y - low.y + 1
+                                      : high.x - low.x + 1;
+                int run = 0;
+                for (int j = 0; j <= len; ++j)
+                {
+                    const coord_def p = c + along * j;
+                    if (j < len && in_bounds(p) && in_bounds(p + dir)
+                        && traversable(p) && traversable(p + dir))
+                    {
+                        ++run;
+                        continue;
+                    }
+                    if (!run)
+                        continue;
+
+                    const coord_def mid = c + along * (j - (run + 1) / 2);
+                    run = 0;
+                    int16_t &index = graph.node_at[mid.x][mid.y];
+                    if (index < 0)
+                    {
+                        index = nodes.size();
+                        nodes.emplace_back();
+                        nodes.back().pos = mid;
+                    }
+                    nodes[index].across.push_back(mid + dir);
+                }
+            }
+            rebuilt.push_back(sec);
+            graph.dirty[sx][sy] = false;
+        }
+
+    int dist[SECTOR_SIZE][SECTOR_SIZE];
+    for (const coord_def &sec : rebuilt)
+    {
+        const coord_def low = _sector_min(sec);
+        vector<sector_node> &nodes = graph.nodes[sec.x][sec.y];
+        for (sector_node &node : nodes)
+        {
+            sector_search(node.pos, false, dist);
+            for (unsigned int i = 0; i < nodes.size(); ++i)
+            {
+                const coord_def &p = nodes[i].pos;
+                const int d = dist[p.x - low.x][p.y - low.y];
+                if (p != node.pos && d != INFINITE_DISTANCE)
+                    node.paths.emplace_back(i, d);
+            }
+        }
+    }
+
+    class_wide = false;
+}
+
+// Search the sector graph for the shortest route from start to target,
+// and fill route with the grids it passes, from the first sector entrance
+// on.
+bool monster_pathfind::sector_route(const sector_graph &graph,
+                                    vector<coord_def> &route)
+{
+    const coord_def start_sec = _sector_of(start);
+    const coord_def target_sec = _sector_of(target);
+    const coord_def start_low = _sector_min(start_sec);
+    const coord_def target_low = _sector_min(target_sec);
+
+    // The costs from start to the entrances of its sector, and from the
+    // entrances of target's sector to target.
+    int from_start[SECTOR_SIZE][SECTOR_SIZE];
+    int to_target[SECTOR_SIZE][SECTOR_SIZE];
+    class_wide = true;
+    sector_search(start, false, from_start);
+    sector_search(target, true, to_target);
+    class_wide = false;
+
+    ws->new_search();
+    typedef pair<int, int> queued_node;
+    priority_queue<queued_node, vector<queued_node>, greater<queued_node>>
+        queue;
+
+    auto relax = [&](const coord_def& from, const coord_def& to, int cost)
+    {
+        const int distance = ws->get_dist(from) + cost;
+        if (distance >= ws->get_dist(to))
+            return;
+        ws->set_dist(to, distance);
+        ws->from[to.x * GYM + to.y] = from.x * GYM + from.y;
+        queue.push(queued_node(distance + grid_distance(to, target),
+                               to.x * GYM + to.y));
+    };
+
+    ws->set_dist(start, 0);
+    queue.push(queued_node(grid_distance(start, target),
+                           start.x * GYM + start.y));
+    class_wide = true;
+    while (!queue.empty())
+    {
+        const queued_node next = queue.top();
+        queue.pop();
+        pos = coord_def(next.second / GYM, next.second % GYM);
+        if (pos == target)
+            break;
+        if (next.first != ws->get_dist(pos) + grid_distance(pos, target))
+            continue;
+
+        const coord_def sec = _sector_of(pos);
+        const vector<sector_node> &nodes = graph.nodes[sec.x][sec.y];
+        if (pos == start)
+        {
+            for (const sector_node &node : nodes)
+            {
+                const int d = from_start[node.pos.x - start_low.x]
+                                        [node.pos.y - start_low.y];
+                if (d != INFINITE_DISTANCE)
+                    relax(pos, node.pos, d);
+            }
+        }
+
+        const int index = graph.node_at[pos.x][pos.y];
+        if (index < 0)
+            continue;
+
+        const sector_node &node = nodes[index];
+        for (const pair<int, int> &path : node.paths)
+            relax(pos, nodes[path.first].pos, path.second);
+        for (const coord_def &entrance : node.across)
+            if (graph.node_at[entrance.x][entrance.y] >= 0)
+                relax(pos, entrance, travel_cost(entrance));
+        if (sec == target_sec)
+        {
+            const int d = to_target[pos.x - target_low.x]
+                                   [pos.y - target_low.y];
+            if (d != INFINITE_DISTANCE)
+                relax(pos, target, d);
+        }
+    }
+    class_wide = false;
+
+    if (ws->get_dist(target) == INFINITE_DISTANCE)
+        return false;
+
+    route.clear();
+    for (coord_def p = target; p != start;
+         p = coord_def(ws->from[p.x * GYM + p.y] / GYM,
+                       ws->from[p.x * GYM + p.y] % GYM))
+    {
+        route.push_back(p);
+    }
+    reverse(route.begin(), route.end());
+    return true;
+}
+
 bool monster_pathfind::start_pathfind(bool msg)
 {
     // NOTE: We never do any traversable() check for the target square.
@@ -138,11 +953,8 @@ bool monster_pathfind::start_pathfind(bool msg)
     //       a wall.
 
     max_length = min_length = grid_distance(pos, target);
-    for (int i = 0; i < GXM; i++)
-        for (int j = 0; j < GYM; j++)
-            dist[i][j] = INFINITE_DISTANCE;
-
-    dist[pos.x][pos.y] = 0;
+    ws->new_search();
+    ws->set_dist(pos, 0);
 
     bool success = false;
     do
@@ -212,8 +1024,8 @@ bool monster_pathfind::calc_path_to_neighbours()
         if (range && estimated_cost(npos) > range)
             continue;
 
-        distance = dist[pos.x][pos.y] + travel_cost(npos);
-        old_dist = dist[npos.x][npos.y];
+        distance = get_dist(pos) + travel_cost(npos);
+        old_dist = get_dist(npos);
 
         // Also bail out if this would make the path longer than twice the
         // allowed distance from the target. (This factor may need tuning.)
@@ -255,7 +1067,7 @@ bool monster_pathfind::calc_path_to_neighbours()
             }
 
             // Update distance start->pos.
-            dist[npos.x][npos.y] = distance;
+            ws->dist[npos.x][npos.y] = distance;
 
             // Set backtracking information.
             // Converts the Compass direction to its counterpart.
@@ -263,7 +1075,7 @@ bool monster_pathfind::calc_path_to_neighbours()
             //      7  .  3   ==>   3  .  7       e.g. (3 + 4) % 8          = 7
             //      6  5  4         2  1  0            (7 + 4) % 8 = 11 % 8 = 3
 
-            prev[npos.x][npos.y] = (dir + 4) % 8;
+            ws->prev[npos.x][npos.y] = (dir + 4) % 8;
 
             // Are we finished?
             if (npos == target)
@@ -285,16 +1097,14 @@ bool monster_pathfind::get_best_position()
 {
     for (int i = min_length; i <= max_length; i++)
     {
-        if (!hash[i].empty())
+        if (!ws->bucket_empty(i))
         {
             if (i > min_length)
                 min_length = i;
 
-            vector<coord_def> &vec = hash[i];
-            // Pick the last position pushed into the vector as it's most
+            // Pick the last position pushed into the bucket as it's most
             // likely to be close to the target.
-            pos = vec[vec.size()-1];
-            vec.pop_back();
+            pos = ws->pop(i);
 
 #ifdef DEBUG_PATHFIND
             mprf("Returning (%d, %d) as best pos with total dist %d.",
@@ -329,7 +1139,7 @@ vector<coord_def> monster_pathfind::backtrack()
     int dir;
     do
     {
-        dir = prev[pos.x][pos.y];
+        dir = ws->prev[pos.x][pos.y];
         pos = pos + Compass[dir];
         ASSERT_IN_BOUNDS(pos);
 #ifdef DEBUG_PATHFIND
@@ -388,6 +1198,13 @@ vector<coord_def> monster_pathfind::calc_waypoints()
     if (pos != path[path.size() - 1])
         waypoints.push_back(path[path.size() - 1]);
 
+    // And the sector entrances on the way to our real destination, if this
+    // was just the first leg of a longer journey. The first leg may have
+    // ended at one of them, or at the destination itself.
+    for (const coord_def &p : coarse_path)
+        if (waypoints.empty() || waypoints.back() != p)
+            waypoints.push_back(p);
+
     return waypoints;
 }
 
@@ -436,7 +1253,7 @@ bool monster_pathfind::mons_traversable(const coord_def& p)
     if (!mons->is_habitable(p))
         return false;
 
-    return mons_can_traverse(*mons, p, traverse_in_sight);
+    return mons_can_traverse(*mons, p, traverse_in_sight, !class_wide);
 }
 
 int monster_pathfind::travel_cost(coord_def npos)
@@ -492,26 +1309,24 @@ int monster_pathfind::estimated_cost(coord_def p)
     return grid_distance(p, target);
 }
 
+int monster_pathfind::get_dist(const coord_def& p) const
+{
+    return ws->get_dist(p);
+}
+
+// Called before the new distance of npos is set.
 void monster_pathfind::add_new_pos(coord_def npos, int total)
 {
-    hash[total].push_back(npos);
+    ws->set_dist(npos, INFINITE_DISTANCE);
+    ws->push(total, npos);
 }
 
 void monster_pathfind::update_pos(coord_def npos, int total)
 {
     // Find hash position of old distance and delete it,
     // then call_add_new_pos.
-    int old_total = dist[npos.x][npos.y] + estimated_cost(npos);
-
-    vector<coord_def> &vec = hash[old_total];
-    for (unsigned int i = 0; i < vec.size(); i++)
-    {
-        if (vec[i] == npos)
-        {
-            vec.erase(vec.begin() + i);
-            break;
-        }
-    }
+    int old_total = get_dist(npos) + estimated_cost(npos);
+    ws->remove(old_total, npos);
 
-    add_new_pos(npos, total);
+    ws->push(total, npos);
 }
@@ -1,14 +1,24 @@
 #pragma once
 
 class monster;
+struct pathfind_workspace;
+struct flow_field;
+struct sector_graph;
+
+// The width and height of the sectors the level is split into when
+// finding long paths; see init_long_pathfind().
+#define SECTOR_SIZE 10
 
 int mons_tracking_range(const monster* mon);
+void pathfind_terrain_changed(const coord_def& p);
+void pathfind_level_changed();
 
 class monster_pathfind
 {
 public:
     monster_pathfind();
     virtual ~monster_pathfind();
+    DISALLOW_COPY_AND_ASSIGN(monster_pathfind);
 
     // public methods
     void set_range(int r);
@@ -18,6 +28,8 @@ public:
                        bool pass_unmapped = false);
     bool init_pathfind(coord_def src, coord_def dest,
                        bool diag = true, bool msg = false);
+    bool init_shared_pathfind(const monster* mon, coord_def dest);
+    bool init_long_pathfind(const monster* mon, coord_def dest);
     bool start_pathfind(bool msg = false);
     vector<coord_def> backtrack();
     vector<coord_def> calc_waypoints();
@@ -33,6 +45,12 @@ protected:
     void add_new_pos(coord_def pos, int total);
     void update_pos(coord_def pos, int total);
     bool get_best_position();
+    int  get_dist(const coord_def& p) const;
+    void fill_flow_field(flow_field &field);
+    void sector_search(const coord_def& from, bool reverse,
+                       int dist[SECTOR_SIZE][SECTOR_SIZE]);
+    void update_sectors(sector_graph &graph);
+    bool sector_route(const sector_graph &graph, vector<coord_def> &route);
 
     // The monster trying to find a path.
     const monster* mons;
@@ -52,6 +70,11 @@ protected:
     // friendly summoned monster which are not already out of sight)
     bool traverse_in_sight;
 
+    // If true, we're finding paths for all monsters of the same movement
+    // class, so traps are ignored; each monster checks those for itself
+    // when it follows the shared paths.
+    bool class_wide;
+
     // Maximum range to search between start and target. None, if zero.
     int range;
 
@@ -59,10 +82,12 @@ protected:
     int min_length;
     int max_length;
 
-    // The array of distances from start to any already tried point.
-    int dist[GXM][GYM];
-    // An array to store where we came from on a given shortest path.
-    int prev[GXM][GYM];
+    // The distances from start to any already tried point, where we came
+    // from on a given shortest path, and the hash of points to look at.
+    // This is kept in a pool and reused; see mon-pathfind.cc.
+    pathfind_workspace *ws;
 
-    FixedVector<vector<coord_def>, GXM * GYM> hash;
+    // The rest of the way to target after the first leg, when travelling
+    // from sector to sector.
+    vector<coord_def> coarse_path;
 };
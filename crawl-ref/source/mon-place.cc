@@ -857,6 +857,7 @@ monster* get_free_monster()
         if (mons.type == MONS_NO_MONSTER)
         {
             mons.reset();
+            env.mons_used = max(env.mons_used, mons.mindex() + 1);
             return &mons;
         }
 
@@ -1493,8 +1493,9 @@ bool mons_is_unique(monster_type mc)
 bool mons_is_or_was_unique(const monster& mon)
 {
     return mons_is_unique(mon.type)
-           || mon.props.exists(ORIGINAL_TYPE_KEY)
-              && mons_is_unique((monster_type) mon.props[ORIGINAL_TYPE_KEY].get_int());
+           || mon.props.exists(prop_key::original_type)
+              && mons_is_unique((monster_type)
+                     mon.props[prop_key::original_type].get_int());
 }
 
 /**
@@ -2918,7 +2919,6 @@ void define_monster(monster& mons)
 
     // Reset monster enchantments.
     mons.enchantments.clear();
-    mons.ench_cache.reset();
     mons.ench_countdown = 0;
 
     switch (mcls)
@@ -5152,6 +5152,20 @@ void reset_all_monsters()
     env.mid_cache.clear();
 }
 
+/**
+ * Lower env.mons_used past any empty slots at the end of the monster list,
+ * so that iterating over monsters can stop sooner. Slots are only handed
+ * out by get_free_monster(), which raises it again.
+ */
+void trim_monster_slots()
+{
+    while (env.mons_used > 0
+           && menv[env.mons_used - 1].type == MONS_NO_MONSTER)
+    {
+        --env.mons_used;
+    }
+}
+
 bool mons_is_recallable(const actor* caller, const monster& targ)
 {
     // For player, only recall friendly monsters
@@ -515,6 +515,7 @@ bool mons_is_player_shadow(const monster& mon);
 bool mons_has_attacks(const monster& mon);
 
 void reset_all_monsters();
+void trim_monster_slots();
 void debug_mondata();
 void debug_monspells();
 
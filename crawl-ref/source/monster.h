@@ -35,8 +35,6 @@ const int KRAKEN_TENTACLE_RANGE = 3;
 
 #define MAP_KEY "map"
 
-typedef map<enchant_type, mon_enchant> mon_enchant_list;
-
 struct monsterentry;
 
 class monster : public actor
@@ -70,7 +68,6 @@ public:
     unsigned short foe;
     int8_t ench_countdown;
     mon_enchant_list enchantments;
-    FixedBitVector<NUM_ENCHANTMENTS> ench_cache;
     monster_flags_t flags;             // bitfield of boolean flags
     xp_tracking_type xp_tracking;
 
@@ -185,11 +182,10 @@ public:
     // Has ENCH_SHAPESHIFTER or ENCH_GLOWING_SHAPESHIFTER.
     bool is_shapeshifter() const;
 
-#ifdef DEBUG_ENCH_CACHE_DIAGNOSTICS
-    bool has_ench(enchant_type ench) const; // same but validated
-#else
-    bool has_ench(enchant_type ench) const { return ench_cache[ench]; }
-#endif
+    bool has_ench(enchant_type ench) const
+    {
+        return enchantments.contains(ench);
+    }
     bool has_ench(enchant_type ench, enchant_type ench2) const;
     mon_enchant get_ench(enchant_type ench,
                          enchant_type ench2 = ENCH_NONE) const;
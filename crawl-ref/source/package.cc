@@ -36,6 +36,7 @@ Notes:
 #include "errors.h"
 #include "syscalls.h"
 #include "libutil.h" // map_find
+#include "threads.h"
 
 // debugging defines
 #undef  FSCK_VERBOSE
@@ -79,6 +80,72 @@ typedef pair<plen_t, plen_t> bm_p;
 typedef map<plen_t, bm_p> bm_t;
 typedef map<plen_t, plen_t> fb_t;
 
+#define ZB_SIZE 32768
+
+// A chunk given to package::write_chunk_deferred(), being compressed.
+struct deferred_chunk
+{
+    string name;
+    vector<unsigned char> data;
+#ifdef USE_ZLIB
+    vector<Bytef> compressed;
+    // Why compressing failed, if it did.
+    string error;
+    thread_t thread;
+    bool threaded;
+#endif
+};
+
+#ifdef USE_ZLIB
+static string _zlib_error(const char *what, const z_stream &zs)
+{
+    return string(what) + ": " + (zs.msg ? zs.msg : "unknown error");
+}
+
+// deflate doesn't care how its input is split up, so compressing all of
+// the chunk at once gives the same stream as a chunk_writer would.
+// This runs in its own thread, where fail() would take the whole game down
+// rather than throw to the saving code, so errors are left in the chunk
+// for write_deferred() to report.
+static void *_compress_chunk(void *arg)
+{
+    deferred_chunk &ch = *static_cast<deferred_chunk *>(arg);
+    z_stream zs;
+    zs.data_type = Z_BINARY;
+    zs.zalloc    = 0;
+    zs.zfree     = 0;
+    zs.opaque    = Z_NULL;
+    if (deflateInit(&zs, Z_DEFAULT_COMPRESSION))
+    {
+        ch.error = _zlib_error("save file compression failed during init",
+                               zs);
+        return nullptr;
+    }
+
+    ch.compressed.resize(deflateBound(&zs, ch.data.size()));
+    zs.next_in   = ch.data.data();
+    zs.avail_in  = ch.data.size();
+    zs.next_out  = ch.compressed.data();
+    zs.avail_out = ch.compressed.size();
+    if (deflate(&zs, Z_FINISH) != Z_STREAM_END)
+    {
+        ch.error = _zlib_error("save file compression failed", zs);
+        deflateEnd(&zs);
+        return nullptr;
+    }
+    ch.compressed.resize(zs.total_out);
+    if (deflateEnd(&zs) != Z_OK)
+    {
+        ch.error = _zlib_error("save file compression failed during clean-up",
+                               zs);
+        return nullptr;
+    }
+
+    vector<unsigned char>().swap(ch.data);
+    return nullptr;
+}
+#endif
+
 package::package(const char* file, bool writeable, bool empty)
   : n_users(0), dirty(false), aborted(false)
 #ifdef DO_FSYNC
@@ -232,6 +299,7 @@ package::~package()
 void package::commit()
 {
     ASSERT(rw);
+    write_deferred();
     if (!dirty)
         return;
     ASSERT(!aborted);
@@ -279,11 +347,75 @@ void package::seek(plen_t to)
 
 chunk_writer* package::writer(const string &name)
 {
+    write_deferred();
     return new chunk_writer(this, name);
 }
 
+// Keep at most this many chunks waiting to be written.
+#define MAX_DEFERRED_CHUNKS 4
+
+void package::write_chunk_deferred(const string &name,
+                                   vector<unsigned char> &&data)
+{
+    ASSERT(rw);
+    ASSERT(!aborted);
+    ASSERT(name.length() < MAX_CHUNK_NAME_LENGTH);
+    write_deferred(MAX_DEFERRED_CHUNKS - 1);
+
+    deferred.emplace_back(new deferred_chunk);
+    deferred_chunk &ch = *deferred.back();
+    ch.name = name;
+    ch.data = move(data);
+#ifdef USE_ZLIB
+    ch.threaded = !thread_create_joinable(&ch.thread, _compress_chunk, &ch);
+    if (!ch.threaded)
+        _compress_chunk(&ch);
+#endif
+}
+
+// Write out the deferred chunks, oldest first, until only keep are left.
+void package::write_deferred(size_t keep)
+{
+    if (deferred.size() <= keep)
+        return;
+
+    const size_t n = deferred.size() - keep;
+    for (size_t i = 0; i < n; ++i)
+    {
+        deferred_chunk &ch = *deferred[i];
+#ifdef USE_ZLIB
+        if (ch.threaded)
+        {
+            thread_join(ch.thread);
+            ch.threaded = false;
+        }
+        if (aborted)
+            continue;
+        // Compression errors are reported here, where fail() can throw.
+        if (!ch.error.empty())
+            fail("%s", ch.error.c_str());
+
+        // Hand the stream over in the same pieces as a chunk_writer would,
+        // so that the same blocks are allocated.
+        chunk_writer w(this, ch.name, true);
+        for (size_t off = 0; off < ch.compressed.size(); off += ZB_SIZE)
+        {
+            w.raw_write(&ch.compressed[off],
+                        min<size_t>(ZB_SIZE, ch.compressed.size() - off));
+        }
+#else
+        if (aborted)
+            continue;
+        chunk_writer w(this, ch.name);
+        w.write(ch.data.data(), ch.data.size());
+#endif
+    }
+    deferred.erase(deferred.begin(), deferred.begin() + n);
+}
+
 chunk_reader* package::reader(const string &name)
 {
+    write_deferred();
     if (plen_t *ch = map_find(directory, name))
         return new chunk_reader(this, *ch);
     return 0;
@@ -382,6 +514,7 @@ void package::free_chunk(const string &name)
 
 void package::delete_chunk(const string &name)
 {
+    write_deferred();
     free_chunk(name);
     directory.erase(name);
 }
@@ -562,11 +695,17 @@ void package::read_directory(plen_t start, uint8_t version)
 
 bool package::has_chunk(const string &name)
 {
-    return !name.empty() && directory.count(name);
+    if (name.empty())
+        return false;
+    for (const auto &ch : deferred)
+        if (ch->name == name)
+            return true;
+    return directory.count(name);
 }
 
 vector<string> package::list_chunks()
 {
+    write_deferred();
     vector<string> list;
     list.reserve(directory.size());
     for (const auto &entry : directory)
@@ -618,6 +757,7 @@ void package::abort()
     // this point are ignored (assuming we already failed). All writes since
     // the last commit() are lost.
     aborted = true;
+    write_deferred();
 }
 
 void package::unlink()
@@ -631,6 +771,7 @@ void package::unlink()
 // the amount of free space not at the end of file
 plen_t package::get_slack()
 {
+    write_deferred();
     load_traces();
 
     plen_t slack = 0;
@@ -641,6 +782,7 @@ plen_t package::get_slack()
 
 plen_t package::get_chunk_fragmentation(const string &name)
 {
+    write_deferred();
     load_traces();
     ASSERT(directory.count(name)); // not has_chunk(), "" is valid
     plen_t frags = 0;
@@ -657,6 +799,7 @@ plen_t package::get_chunk_fragmentation(const string &name)
 
 plen_t package::get_chunk_compressed_length(const string &name)
 {
+    write_deferred();
     load_traces();
     ASSERT(directory.count(name)); // not has_chunk(), "" is valid
     plen_t len = 0;
@@ -671,8 +814,10 @@ plen_t package::get_chunk_compressed_length(const string &name)
     return len;
 }
 
-chunk_writer::chunk_writer(package *parent, const string &_name)
-    : first_block(0), cur_block(0), block_len(0)
+chunk_writer::chunk_writer(package *parent, const string &_name,
+                           bool _precompressed)
+    : first_block(0), cur_block(0), block_len(0),
+      precompressed(_precompressed)
 {
     ASSERT(parent);
     ASSERT(!parent->aborted);
@@ -687,13 +832,14 @@ chunk_writer::chunk_writer(package *parent, const string &_name)
     name = _name;
 
 #ifdef USE_ZLIB
+    if (precompressed)
+        return;
     zs.data_type = Z_BINARY;
     zs.zalloc    = 0;
     zs.zfree     = 0;
     zs.opaque    = Z_NULL;
     if (deflateInit(&zs, Z_DEFAULT_COMPRESSION))
         fail("save file compression failed during init: %s", zs.msg);
-#define ZB_SIZE 32768
     zs.next_out  = z_buffer = (Bytef*)malloc(ZB_SIZE);
     zs.avail_out = ZB_SIZE;
 #endif
@@ -709,27 +855,33 @@ chunk_writer::~chunk_writer()
     {
 #ifdef USE_ZLIB
         // ignore errors, they're not relevant anymore
-        deflateEnd(&zs);
-        free(z_buffer);
+        if (!precompressed)
+        {
+            deflateEnd(&zs);
+            free(z_buffer);
+        }
 #endif
         return;
     }
 
 #ifdef USE_ZLIB
-    zs.avail_in = 0;
-    int res;
-    do
+    if (!precompressed)
     {
-        res = deflate(&zs, Z_FINISH);
-        if (res != Z_STREAM_END && res != Z_OK && res != Z_BUF_ERROR)
-            fail("save file compression failed: %s", zs.msg);
-        raw_write(z_buffer, zs.next_out - z_buffer);
-        zs.next_out = z_buffer;
-        zs.avail_out = ZB_SIZE;
-    } while (res != Z_STREAM_END);
-    if (deflateEnd(&zs) != Z_OK)
-        fail("save file compression failed during clean-up: %s", zs.msg);
-    free(z_buffer);
+        zs.avail_in = 0;
+        int res;
+        do
+        {
+            res = deflate(&zs, Z_FINISH);
+            if (res != Z_STREAM_END && res != Z_OK && res != Z_BUF_ERROR)
+                fail("save file compression failed: %s", zs.msg);
+            raw_write(z_buffer, zs.next_out - z_buffer);
+            zs.next_out = z_buffer;
+            zs.avail_out = ZB_SIZE;
+        } while (res != Z_STREAM_END);
+        if (deflateEnd(&zs) != Z_OK)
+            fail("save file compression failed during clean-up: %s", zs.msg);
+        free(z_buffer);
+    }
 #endif
     if (cur_block)
         finish_block(0);
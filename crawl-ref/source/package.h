@@ -3,6 +3,7 @@
 #define USE_ZLIB
 
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 #ifdef USE_ZLIB
@@ -18,6 +19,7 @@
 typedef uint32_t plen_t;
 
 class package;
+struct deferred_chunk;
 
 class chunk_writer
 {
@@ -31,10 +33,12 @@ private:
     z_stream zs;
     Bytef *z_buffer;
 #endif
+    bool precompressed;
     void raw_write(const void *data, plen_t len);
     void finish_block(plen_t next);
 public:
-    chunk_writer(package *parent, const string &_name);
+    chunk_writer(package *parent, const string &_name,
+                 bool _precompressed = false);
     ~chunk_writer();
     void write(const void *data, plen_t len);
     friend class package;
@@ -70,6 +74,10 @@ public:
     ~package();
     chunk_writer* writer(const string &name);
     chunk_reader* reader(const string &name);
+    // Write data as the chunk name, compressing it on another thread. The
+    // chunk is written to the file before anything else is read or
+    // written, so that the file ends up just as if writer() were used.
+    void write_chunk_deferred(const string &name, vector<unsigned char> &&data);
     void commit();
     void delete_chunk(const string &name);
     bool has_chunk(const string &name);
@@ -99,6 +107,8 @@ private:
     map<plen_t, pair<plen_t, plen_t> > block_map;
     set<plen_t> new_chunks;
     map<plen_t, uint32_t> reader_count;
+    vector<unique_ptr<deferred_chunk>> deferred;
+    void write_deferred(size_t keep = 0);
     plen_t extend_block(plen_t at, plen_t size, plen_t by);
     plen_t alloc_block(plen_t &size);
     void finish_chunk(const string &name, plen_t at);
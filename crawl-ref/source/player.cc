@@ -3530,8 +3530,8 @@ int slaying_bonus(bool ranged)
     if (you.duration[DUR_HORROR])
         ret -= you.props[HORROR_PENALTY_KEY].get_int();
 
-    if (you.props.exists(WU_JIAN_HEAVENLY_STORM_KEY))
-        ret += you.props[WU_JIAN_HEAVENLY_STORM_KEY].get_int();
+    if (you.props.exists(prop_key::wu_jian_heavenly_storm))
+        ret += you.props[prop_key::wu_jian_heavenly_storm].get_int();
 
     return ret;
 }
@@ -0,0 +1,17 @@
+#pragma once
+
+// Property keys interned for fast lookup in a CrawlHashTable. Only keys
+// that are checked constantly are worth listing; every other key works as a
+// plain string, and either form of a listed key finds the same entry.
+// Keep in sync with prop_key_name() in store.cc; at most 64 entries.
+enum class prop_key
+{
+    artefact_props,         // ARTEFACT_PROPS_KEY
+    artefact_known_props,   // KNOWN_PROPS_KEY
+    original_type,          // ORIGINAL_TYPE_KEY
+    torpor_slowed,          // TORPOR_SLOWED_KEY
+    wu_jian_heavenly_storm, // WU_JIAN_HEAVENLY_STORM_KEY
+    // Always the last.
+    COUNT
+};
+constexpr int NUM_PROP_KEYS = static_cast<int>(prop_key::COUNT);
@@ -28,6 +28,11 @@ crawl_require('dlua/explorer.lua')
 -- When running scripts with fake_pty, all output goes to stderr, so to
 -- redirect this to a file you will need to do something like:
 --   util/fake_pty ./crawl -script seed_explorer.lua -seed 1 > out.txt 2>&1
+--
+-- To scan many seeds for vaults, uniques, artefacts, altars or shops, the
+-- native seed survey is much faster and needs no debug build:
+--   ./crawl -seed-survey 1-1000 -jobs 8
+--   ./crawl -seed-survey-query seed-survey.cat altar:trog unique:sigmund
 
 local basic_usage = [=[
 Usage: seed_explorer.lua -seed <seed> ([<seed> ...]|[-count <n>]) ([-depth <depth>]|[-show <lvl> [<lvl> ...]]) [-cats <cat> [<cat ...]] [-artefacts] [-mon-items]
@@ -0,0 +1,57 @@
+-- Times level generation with and without the vault selection index, and
+-- checks that both pick the same vaults.
+
+local niters = 20
+local seed = 1
+
+local places = { }
+local args = crawl.script_args()
+local i = 1
+while i <= #args do
+  if args[i] == "-iters" then
+    i = i + 1
+    niters = tonumber(args[i])
+  elseif args[i] == "-seed" then
+    i = i + 1
+    seed = tonumber(args[i])
+  else
+    table.insert(places, args[i])
+  end
+  i = i + 1
+end
+
+if #places == 0 or not niters or not seed then
+  script.usage("Usage: vault-index-bench [-iters N] [-seed S] <place> ...")
+end
+
+local function generate(use_index)
+  debug.disable("map_index", not use_index)
+  debug.reset_rng(seed)
+  local vaults = { }
+  local start = crawl.millis()
+  for n = 1, niters do
+    for _, place in ipairs(places) do
+      debug.flush_map_memory()
+      debug.goto_place(place)
+      test.regenerate_level()
+      table.insert(vaults, debug.vault_names())
+    end
+  end
+  return crawl.millis() - start, vaults
+end
+
+local nlevels = niters * #places
+local slow, slow_vaults = generate(false)
+local fast, fast_vaults = generate(true)
+debug.disable("map_index", false)
+
+for n = 1, nlevels do
+  if slow_vaults[n] ~= fast_vaults[n] then
+    error("level " .. n .. " differs: " .. slow_vaults[n]
+          .. " vs. " .. fast_vaults[n])
+  end
+end
+
+crawl.stderr(string.format("%d levels: %.2f ms/level without the index, "
+                           .. "%.2f ms/level with it\n",
+                           nlevels, slow / nlevels, fast / nlevels))
@@ -0,0 +1,605 @@
+/**
+ * @file
+ * @brief Seed surveys: build the whole dungeon for a range of seeds and
+ *        catalogue what each level holds.
+ *
+ * This is the native counterpart of scripts/seed_explorer.lua, for when
+ * thousands of seeds need looking at rather than a handful. Every seed is
+ * set up as a new game would be, and its levels are built in the order
+ * pregeneration builds them, so that they hold what the game would give
+ * that seed. With -jobs, the seeds are split between that many processes.
+ *
+ * The catalogue records each level's vaults, uniques, artefacts, altars and
+ * shops. Names are stored once and referred to by number, and the file ends
+ * with an index from each name to the levels it is found on, which is what
+ * -seed-survey-query searches.
+**/
+
+#include "AppHdr.h"
+
+#include "seed-survey.h"
+
+#ifndef TARGET_OS_WINDOWS
+# include <cerrno>
+# include <sys/wait.h>
+# include <unistd.h>
+#endif
+
+#include "act-iter.h"
+#include "artefact.h"
+#include "branch.h"
+#include "cloud.h"
+#include "coordit.h"
+#include "dbg-util.h"
+#include "dungeon.h"
+#include "env.h"
+#include "files.h"
+#include "initfile.h"
+#include "libutil.h"
+#include "los.h"
+#include "maps.h"
+#include "message.h"
+#include "mon-util.h"
+#include "ng-init.h"
+#include "ng-setup.h"
+#include "options.h"
+#include "player.h"
+#include "religion.h"
+#include "shopping.h"
+#include "state.h"
+#include "stringutil.h"
+#include "syscalls.h"
+#include "tags.h"
+#include "terrain.h"
+
+#define SURVEY_FILE "seed-survey.cat"
+#define SURVEY_MAGIC "CSSC"
+#define SURVEY_VERSION 1
+
+enum survey_category
+{
+    SURVEY_VAULT,
+    SURVEY_UNIQUE,
+    SURVEY_ARTEFACT,
+    SURVEY_ALTAR,
+    SURVEY_SHOP,
+    NUM_SURVEY_CATEGORIES
+};
+
+static const char *survey_category_names[] =
+{
+    "vault", "unique", "artefact", "altar", "shop",
+};
+COMPILE_CHECK(ARRAYSZ(survey_category_names) == NUM_SURVEY_CATEGORIES);
+
+struct survey_level
+{
+    level_id place;
+    vector<int> entries;    // Sorted indices into the name table.
+};
+
+struct survey_seed
+{
+    uint64_t seed;
+    vector<survey_level> levels;
+};
+
+typedef pair<survey_category, string> survey_name;
+
+class survey_catalogue
+{
+public:
+    int intern(survey_category cat, const string &name);
+    survey_seed &add_seed(uint64_t seed);
+    void merge(const survey_catalogue &other);
+
+    void save(writer &outf) const;
+    bool load(reader &inf);
+
+    vector<survey_name> names;
+    vector<survey_seed> seeds;
+    // For each name, the (seed, level) pairs it was found on.
+    vector<vector<pair<int, int>>> postings;
+
+private:
+    map<survey_name, int> name_index;
+};
+
+int survey_catalogue::intern(survey_category cat, const string &name)
+{
+    const survey_name key(cat, name);
+    auto found = name_index.find(key);
+    if (found != name_index.end())
+        return found->second;
+
+    const int id = names.size();
+    names.push_back(key);
+    name_index[key] = id;
+    return id;
+}
+
+survey_seed &survey_catalogue::add_seed(uint64_t seed)
+{
+    seeds.emplace_back();
+    seeds.back().seed = seed;
+    return seeds.back();
+}
+
+// Append another catalogue's seeds, renumbering its names into ours.
+void survey_catalogue::merge(const survey_catalogue &other)
+{
+    vector<int> renumber;
+    for (const survey_name &name : other.names)
+        renumber.push_back(intern(name.first, name.second));
+
+    for (const survey_seed &seed : other.seeds)
+    {
+        survey_seed &ours = add_seed(seed.seed);
+        for (const survey_level &level : seed.levels)
+        {
+            ours.levels.push_back({level.place, {}});
+            for (int id : level.entries)
+                ours.levels.back().entries.push_back(renumber[id]);
+            sort(ours.levels.back().entries.begin(),
+                 ours.levels.back().entries.end());
+        }
+    }
+}
+
+void survey_catalogue::save(writer &outf) const
+{
+    marshallString4(outf, SURVEY_MAGIC);
+    marshallInt(outf, SURVEY_VERSION);
+
+    marshallUnsigned(outf, names.size());
+    for (const survey_name &name : names)
+    {
+        marshallUByte(outf, name.first);
+        marshallString(outf, name.second);
+    }
+
+    vector<vector<pair<int, int>>> index(names.size());
+    marshallUnsigned(outf, seeds.size());
+    for (int s = 0; s < (int)seeds.size(); ++s)
+    {
+        marshallUnsigned(outf, seeds[s].seed);
+        marshallUnsigned(outf, seeds[s].levels.size());
+        for (int l = 0; l < (int)seeds[s].levels.size(); ++l)
+        {
+            const survey_level &level = seeds[s].levels[l];
+            marshall_level_id(outf, level.place);
+            marshallUnsigned(outf, level.entries.size());
+            // Entries are sorted, so store the gaps between them.
+            int last = 0;
+            for (int id : level.entries)
+            {
+                marshallUnsigned(outf, id - last);
+                last = id;
+                index[id].emplace_back(s, l);
+            }
+        }
+    }
+
+    for (const auto &where : index)
+    {
+        marshallUnsigned(outf, where.size());
+        int last = 0;
+        for (const auto &seed_level : where)
+        {
+            marshallUnsigned(outf, seed_level.first - last);
+            marshallUnsigned(outf, seed_level.second);
+            last = seed_level.first;
+        }
+    }
+}
+
+bool survey_catalogue::load(reader &inf)
+{
+    string magic;
+    unmarshallString4(inf, magic);
+    if (magic != SURVEY_MAGIC || unmarshallInt(inf) != SURVEY_VERSION)
+        return false;
+
+    for (int i = unmarshallUnsigned(inf); i > 0; --i)
+    {
+        const survey_category cat = (survey_category)unmarshallUByte(inf);
+        if (cat >= NUM_SURVEY_CATEGORIES)
+            return false;
+        intern(cat, unmarshallString(inf));
+    }
+
+    for (int i = unmarshallUnsigned(inf); i > 0; --i)
+    {
+        survey_seed &seed = add_seed(unmarshallUnsigned(inf));
+        for (int j = unmarshallUnsigned(inf); j > 0; --j)
+        {
+            seed.levels.push_back({unmarshall_level_id(inf), {}});
+            int last = 0;
+            for (int k = unmarshallUnsigned(inf); k > 0; --k)
+            {
+                last += unmarshallUnsigned(inf);
+                if (last >= (int)names.size())
+                    return false;
+                seed.levels.back().entries.push_back(last);
+            }
+        }
+    }
+
+    postings.resize(names.size());
+    for (auto &where : postings)
+    {
+        int last = 0;
+        for (int i = unmarshallUnsigned(inf); i > 0; --i)
+        {
+            last += unmarshallUnsigned(inf);
+            const int level = unmarshallUnsigned(inf);
+            if (last >= (int)seeds.size()
+                || level >= (int)seeds[last].levels.size())
+            {
+                return false;
+            }
+            where.emplace_back(last, level);
+        }
+    }
+    return true;
+}
+
+static void _catalogue_level(survey_catalogue &cat, survey_level &level)
+{
+    set<int> entries;
+
+    for (const string &vault : level_vault_names())
+        entries.insert(cat.intern(SURVEY_VAULT, vault));
+
+    for (monster_iterator mi; mi; ++mi)
+    {
+        if (mons_is_unique(mi->type))
+        {
+            entries.insert(cat.intern(SURVEY_UNIQUE,
+                                      mi->name(DESC_PLAIN, true)));
+        }
+    }
+
+    // Floor items, and the ones monsters carry.
+    for (const item_def &item : env.item)
+    {
+        if (item.defined() && is_artefact(item))
+        {
+            entries.insert(cat.intern(SURVEY_ARTEFACT,
+                                      item.name(DESC_PLAIN, false, true,
+                                                false)));
+        }
+    }
+
+    for (const auto &entry : env.shop)
+    {
+        const shop_struct &shop = entry.second;
+        entries.insert(cat.intern(SURVEY_SHOP, shop_name(shop)));
+        for (const item_def &item : shop.stock)
+        {
+            if (is_artefact(item))
+            {
+                entries.insert(cat.intern(SURVEY_ARTEFACT,
+                                          item.name(DESC_PLAIN, false, true,
+                                                    false)));
+            }
+        }
+    }
+
+    for (rectangle_iterator ri(0); ri; ++ri)
+    {
+        const dungeon_feature_type feat = env.grid(*ri);
+        if (feat_is_altar(feat))
+        {
+            entries.insert(cat.intern(SURVEY_ALTAR,
+                                      god_name(feat_altar_god(feat))));
+        }
+    }
+
+    level.entries.assign(entries.begin(), entries.end());
+}
+
+// Build a level as generate_level() would, but without saving it.
+static bool _survey_build_level(const level_id &lid)
+{
+    you.where_are_you = lid.branch;
+    you.depth = lid.depth;
+    you.position.reset();
+    you.transit_stair =
+          lid.depth == 1
+        ? (lid.branch == BRANCH_DUNGEON ? DNGN_UNSEEN
+                                        : branches[lid.branch].entry_stairs)
+        : DNGN_STONE_STAIRS_DOWN_I;
+    unwind_bool ylev(you.entering_level, true);
+
+    delete_all_clouds();
+    los_changed();
+    env.turns_on_level = -1;
+
+    if (!builder(true))
+    {
+        fprintf(stderr, "Couldn't build %s for seed %" PRIu64 ".\n",
+                lid.describe().c_str(), crawl_state.seed);
+        return false;
+    }
+    update_portal_entrances();
+    return true;
+}
+
+static void _survey_place(survey_catalogue &cat, survey_seed &seed,
+                          const level_id &lid)
+{
+    if (!_survey_build_level(lid))
+        return;
+    seed.levels.push_back({lid, {}});
+    _catalogue_level(cat, seed.levels.back());
+}
+
+// Start afresh as a new game would, so that uniques, unique vaults and
+// unrandarts used by earlier seeds don't carry over.
+static void _survey_new_game()
+{
+    you = player();
+    dlua.callfn("dgn_clear_data", "");
+    you.game_seed = crawl_state.seed;
+    you.deterministic_levelgen = Options.incremental_pregen;
+
+    // As for mapstat.
+    you.wizard = true;
+    you.species = SP_HUMAN;
+}
+
+static void _survey_seed(survey_catalogue &cat, uint64_t seed)
+{
+    // Set up the dungeon as a new game with this seed would.
+    ASSERT(seed);
+    Options.seed = seed;
+    rng::reset();
+    _survey_new_game();
+    dgn_reset_level();
+    dgn_flush_map_memory();
+    initial_dungeon_setup();
+
+    survey_seed &entry = cat.add_seed(seed);
+    for (const level_id &lid : pregen_level_order())
+    {
+        _survey_place(cat, entry, lid);
+        // Portals are built as soon as the level they are on.
+        for (const level_id &portal : portal_levels_from(lid))
+            _survey_place(cat, entry, portal);
+    }
+}
+
+static void _survey_seeds(survey_catalogue &cat, uint64_t first,
+                          uint64_t last)
+{
+    no_messages mx;
+    for (uint64_t seed = first; seed <= last; ++seed)
+    {
+        printf("%" PRIu64 "..", seed);
+        fflush(stdout);
+        _survey_seed(cat, seed);
+        if (seed == UINT64_MAX)
+            break;
+    }
+}
+
+static bool _save_catalogue(const survey_catalogue &cat,
+                            const string &filename)
+{
+    FILE *fp = fopen_u(filename.c_str(), "wb");
+    if (!fp)
+        return false;
+    {
+        writer outf(filename, fp);
+        cat.save(outf);
+    }
+    return !fclose(fp);
+}
+
+static bool _load_catalogue(survey_catalogue &cat, const string &filename)
+{
+    reader inf(filename);
+    if (!inf.valid())
+        return false;
+    inf.set_safe_read(true);
+    try
+    {
+        return cat.load(inf);
+    }
+    catch (const short_read_exception &E)
+    {
+        return false;
+    }
+}
+
+#ifndef TARGET_OS_WINDOWS
+static string _job_catalogue_file(int job)
+{
+    return make_stringf("seed-survey-job%d.tmp", job);
+}
+
+// Survey this job's share of the seeds, in a child process, and save its
+// catalogue for the parent.
+static bool _run_job(int job, int jobs)
+{
+    const uint64_t count = SysEnv.seed_survey_last
+                           - SysEnv.seed_survey_first + 1;
+    const uint64_t first = SysEnv.seed_survey_first + count * job / jobs;
+    const uint64_t last = SysEnv.seed_survey_first
+                          + count * (job + 1) / jobs - 1;
+
+    survey_catalogue cat;
+    _survey_seeds(cat, first, last);
+    return _save_catalogue(cat, _job_catalogue_file(job));
+}
+
+static bool _survey_in_jobs(survey_catalogue &cat)
+{
+    const uint64_t count = SysEnv.seed_survey_last
+                           - SysEnv.seed_survey_first + 1;
+    const int jobs = min<uint64_t>(SysEnv.map_gen_jobs, count);
+    printf("Running %d job(s)...\n", jobs);
+    fflush(stdout);
+    fflush(stderr);
+
+    vector<pid_t> pids;
+    for (int job = 0; job < jobs; ++job)
+    {
+        const pid_t pid = fork();
+        if (pid == -1)
+        {
+            fprintf(stderr, "Couldn't fork: %s\n", strerror(errno));
+            break;
+        }
+        if (!pid)
+            _exit(_run_job(job, jobs) ? 0 : 1);
+        pids.push_back(pid);
+    }
+
+    bool ok = (int)pids.size() == jobs;
+    vector<bool> finished;
+    for (pid_t pid : pids)
+    {
+        int status;
+        finished.push_back(waitpid(pid, &status, 0) != -1
+                           && WIFEXITED(status) && !WEXITSTATUS(status));
+    }
+
+    // Merge in job order, so that the seeds stay in order.
+    for (int job = 0; job < (int)pids.size(); ++job)
+    {
+        const string filename = _job_catalogue_file(job);
+        survey_catalogue part;
+        if (finished[job] && _load_catalogue(part, filename))
+            cat.merge(part);
+        else
+        {
+            fprintf(stderr, "Job %d failed.\n", job);
+            ok = false;
+        }
+        unlink_u(filename.c_str());
+    }
+    return ok;
+}
+#endif
+
+/**
+ * Survey the seeds given by -seed-survey and write their catalogue to
+ * seed-survey.cat.
+ */
+void seed_survey_run()
+{
+    _survey_new_game();
+    initialise_item_descriptions();
+    run_map_global_preludes();
+    run_map_local_preludes();
+
+    printf("Surveying seeds %" PRIu64 " to %" PRIu64 ".\n",
+           SysEnv.seed_survey_first, SysEnv.seed_survey_last);
+    fflush(stdout);
+
+    survey_catalogue cat;
+    bool ok = true;
+#ifndef TARGET_OS_WINDOWS
+    if (SysEnv.map_gen_jobs > 1)
+        ok = _survey_in_jobs(cat);
+    else
+#endif
+        _survey_seeds(cat, SysEnv.seed_survey_first, SysEnv.seed_survey_last);
+
+    printf("\nWriting %u seed(s) to %s...\n", (unsigned int)cat.seeds.size(),
+           SURVEY_FILE);
+    if (!_save_catalogue(cat, SURVEY_FILE))
+        printf("Couldn't write %s.\n", SURVEY_FILE);
+    else
+        printf(ok ? "Seed survey complete.\n" : "Some seeds are missing.\n");
+}
+
+// Does a query term match a name? Terms are case-insensitive substrings,
+// optionally limited to a category with a prefix: "altar:trog".
+static bool _term_matches(const string &term, const survey_name &name)
+{
+    string text = term;
+    const size_t colon = term.find(':');
+    if (colon != string::npos)
+    {
+        const string cat = term.substr(0, colon);
+        if (cat == survey_category_names[name.first])
+            text = term.substr(colon + 1);
+        else if (find(begin(survey_category_names),
+                      end(survey_category_names), cat)
+                 != end(survey_category_names))
+        {
+            return false;
+        }
+    }
+    return lowercase_string(name.second).find(text) != string::npos;
+}
+
+static void _print_level(const survey_catalogue &cat, const survey_seed &seed,
+                         const survey_level &level,
+                         const vector<bool> &highlight)
+{
+    for (int id : level.entries)
+    {
+        if (!highlight.empty() && !highlight[id])
+            continue;
+        printf("%" PRIu64 "\t%s\t%s\t%s\n", seed.seed,
+               level.place.describe().c_str(),
+               survey_category_names[cat.names[id].first],
+               cat.names[id].second.c_str());
+    }
+}
+
+/**
+ * Query a seed survey catalogue: -seed-survey-query <file> [<term>...]
+ *
+ * With no terms, prints the whole catalogue. Otherwise prints the seeds
+ * that match every term, and where on them each term matches. Output is
+ * one tab-separated line per entry: seed, level, category and name.
+ */
+bool seed_survey_query(int argc, char **argv)
+{
+    if (argc < 1)
+    {
+        fprintf(stderr, "Usage: -seed-survey-query <file> [<term>...]\n");
+        return false;
+    }
+
+    survey_catalogue cat;
+    if (!_load_catalogue(cat, argv[0]))
+    {
+        fprintf(stderr, "Couldn't read seed survey catalogue %s.\n", argv[0]);
+        return false;
+    }
+
+    vector<bool> highlight;
+    // Seeds that have matched every term so far.
+    set<int> found;
+    for (int s = 0; s < (int)cat.seeds.size(); ++s)
+        found.insert(s);
+
+    if (argc > 1)
+        highlight.resize(cat.names.size(), false);
+    for (int i = 1; i < argc; ++i)
+    {
+        const string term = lowercase_string(argv[i]);
+        set<int> matched;
+        for (int id = 0; id < (int)cat.names.size(); ++id)
+        {
+            if (!_term_matches(term, cat.names[id]))
+                continue;
+            highlight[id] = true;
+            for (const auto &where : cat.postings[id])
+                if (found.count(where.first))
+                    matched.insert(where.first);
+        }
+        found.swap(matched);
+    }
+
+    for (int s : found)
+        for (const survey_level &level : cat.seeds[s].levels)
+            _print_level(cat, cat.seeds[s], level, highlight);
+    return true;
+}
@@ -0,0 +1,10 @@
+/**
+ * @file
+ * @brief Seed surveys: build the whole dungeon for a range of seeds and
+ *        catalogue what each level holds.
+**/
+
+#pragma once
+
+void seed_survey_run();
+bool seed_survey_query(int argc, char **argv);
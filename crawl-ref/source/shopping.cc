@@ -38,6 +38,7 @@
 #include "state.h"
 #include "stepdown.h"
 #include "stringutil.h"
+#include "terrain.h"
 #ifdef USE_TILE_LOCAL
 #include "tilereg-crt.h"
 #endif
@@ -1457,6 +1458,7 @@ void destroy_shop_at(coord_def p)
     {
         env.shop.erase(p);
         grd(p) = DNGN_ABANDONED_SHOP;
+        set_terrain_changed(p);
         unnotice_feature(level_pos(level_id::current(), p));
     }
 }
@@ -2072,6 +2074,7 @@ void ShoppingList::move_things(const coord_def &_src, const coord_def &_dst)
 {
     if (crawl_state.map_stat_gen
         || crawl_state.obj_stat_gen
+        || crawl_state.seed_survey
         || crawl_state.test)
     {
         return; // Shopping list is unitialized and uneeded.
@@ -285,7 +285,10 @@ void wizard_blink()
     // Allow wizard blink to send player into walls, in case the
     // user wants to alter that grid to something else.
     if (cell_is_solid(beam.target))
+    {
         grd(beam.target) = DNGN_FLOOR;
+        set_terrain_changed(beam.target);
+    }
 
     move_player_to_grid(beam.target, false);
 }
@@ -985,6 +988,8 @@ spret cast_golubrias_passage(const coord_def& where, bool fail)
 
     trap->reveal();
     trap2->reveal();
+    set_terrain_changed(trap->pos);
+    set_terrain_changed(trap2->pos);
 
     return spret::success;
 }
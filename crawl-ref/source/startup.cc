@@ -44,6 +44,7 @@
 #include "notes.h"
 #include "output.h"
 #include "player-save-info.h"
+#include "seed-survey.h"
 #include "shopping.h"
 #include "skills.h"
 #include "spl-book.h"
@@ -155,6 +156,13 @@ static void _initialize()
 
     you.game_seed = crawl_state.seed;
 
+    if (crawl_state.seed_survey)
+    {
+        release_cli_signals();
+        seed_survey_run();
+        end(0, false);
+    }
+
 #ifdef DEBUG_STATISTICS
     if (crawl_state.map_stat_gen)
     {
@@ -10,7 +10,9 @@
 
 #include <algorithm>
 
+#include "artefact.h"
 #include "dlua.h"
+#include "god-abil.h"
 #include "monster.h"
 #include "stringutil.h"
 
@@ -1271,6 +1273,12 @@ bool CrawlHashTable::exists(const string &key) const
 void CrawlHashTable::assert_validity() const
 {
 #ifdef DEBUG
+    for (int i = 0; i < NUM_PROP_KEYS; ++i)
+    {
+        const prop_key pk = static_cast<prop_key>(i);
+        ASSERT(exists(pk) == (find(prop_key_name(pk)) != end()));
+    }
+
     size_t actual_size = 0;
 
     for (const auto &entry : *this)
@@ -1337,7 +1345,80 @@ CrawlStoreValue& CrawlHashTable::get_value(const string &key)
     ASSERT_VALIDITY();
     ACCESS(key);
     // Inserts CrawlStoreValue() if the key was not found.
-    return map::operator[](key);
+    auto iter = lower_bound(key);
+    if (iter == end() || iter->first != key)
+    {
+        iter = emplace_hint(iter, key, CrawlStoreValue());
+        note_key(key, true);
+    }
+    return iter->second;
+}
+
+CrawlHashTable::size_type CrawlHashTable::erase(const string &key)
+{
+    const size_type erased = map::erase(key);
+    if (erased)
+        note_key(key, false);
+    return erased;
+}
+
+CrawlHashTable::iterator CrawlHashTable::erase(const_iterator pos)
+{
+    note_key(pos->first, false);
+    return map::erase(pos);
+}
+
+CrawlHashTable::iterator CrawlHashTable::erase(const_iterator first,
+                                               const_iterator last)
+{
+    for (auto iter = first; iter != last; ++iter)
+        note_key(iter->first, false);
+    return map::erase(first, last);
+}
+
+void CrawlHashTable::clear()
+{
+    map::clear();
+    interned = 0;
+}
+
+void CrawlHashTable::swap(CrawlHashTable &other)
+{
+    map::swap(other);
+    std::swap(interned, other.interned);
+}
+
+void CrawlHashTable::note_key(const string &key, bool present)
+{
+    // Only called when a key comes or goes, so a linear search is fine.
+    for (int i = 0; i < NUM_PROP_KEYS; ++i)
+    {
+        const prop_key pk = static_cast<prop_key>(i);
+        if (key == prop_key_name(pk))
+        {
+            if (present)
+                interned |= key_bit(pk);
+            else
+                interned &= ~key_bit(pk);
+            return;
+        }
+    }
+}
+
+const string &prop_key_name(prop_key key)
+{
+    static const string names[] =
+    {
+        ARTEFACT_PROPS_KEY,
+        KNOWN_PROPS_KEY,
+        ORIGINAL_TYPE_KEY,
+        TORPOR_SLOWED_KEY,
+        WU_JIAN_HEAVENLY_STORM_KEY,
+    };
+    COMPILE_CHECK(ARRAYSZ(names) == NUM_PROP_KEYS);
+    COMPILE_CHECK(NUM_PROP_KEYS <= 64);
+
+    return names[static_cast<int>(key)];
 }
 
 const CrawlStoreValue& CrawlHashTable::get_value(const string &key) const
@@ -22,8 +22,11 @@ class  level_id;
 class  dlua_chunk;
 class monster;
 
+#include "prop-key-type.h"
 #include "tags.h"
 
+const string &prop_key_name(prop_key key);
+
 typedef uint16_t vec_size;
 typedef uint8_t store_flags;
 
@@ -250,6 +253,7 @@ public:
     void read(reader &);
 
     bool exists(const string &key) const;
+    bool exists(prop_key key) const { return interned & key_bit(key); }
 
     void assert_validity() const;
 
@@ -258,10 +262,14 @@ public:
     const CrawlStoreValue& get_value(const string &key) const;
     const CrawlStoreValue& get_value(const char *key) const
     { return get_value(string(key)); }
+    const CrawlStoreValue& get_value(prop_key key) const
+    { return get_value(prop_key_name(key)); }
     const CrawlStoreValue& operator[] (const string &key) const
     { return get_value(key); }
     const CrawlStoreValue& operator[] (const char *key) const
     { return get_value(string(key)); }
+    const CrawlStoreValue& operator[] (prop_key key) const
+    { return get_value(prop_key_name(key)); }
 
     // NOTE: If get_value() or [] is given a key which doesn't exist
     // in the table, an unset/empty CrawlStoreValue will be created
@@ -273,9 +281,31 @@ public:
     CrawlStoreValue& get_value(const string &key);
     CrawlStoreValue& get_value(const char *key)
     { return get_value(string(key)); }
-    using map::operator[];
+    CrawlStoreValue& get_value(prop_key key)
+    { return get_value(prop_key_name(key)); }
+    CrawlStoreValue& operator[] (const string &key)
+    { return get_value(key); }
     CrawlStoreValue& operator[] (const char *key)
     { return get_value(string(key)); }
+    CrawlStoreValue& operator[] (prop_key key)
+    { return get_value(prop_key_name(key)); }
+
+    // These hide the map's own versions, to keep track of interned keys.
+    size_type erase(const string &key);
+    size_type erase(prop_key key) { return erase(prop_key_name(key)); }
+    iterator erase(const_iterator pos);
+    iterator erase(const_iterator first, const_iterator last);
+    void clear();
+    void swap(CrawlHashTable &other);
+
+private:
+    // Which interned keys are present, so that checking for one (usually
+    // in vain) needs neither a string nor a tree walk.
+    uint64_t interned = 0;
+
+    static uint64_t key_bit(prop_key key)
+    { return uint64_t(1) << static_cast<int>(key); }
+    void note_key(const string &key, bool present);
 };
 
 // A CrawlVector is the vector version of CrawlHashTable, except that
@@ -21,6 +21,7 @@
 # include <fcntl.h>
 # include <sys/types.h>
 # include <sys/stat.h>
+# include <sys/mman.h>
 #endif
 
 #include "files.h"
@@ -533,3 +534,55 @@ int open_u(const char *pathname, int flags, mode_t mode)
     return open(OUTS(pathname), flags, mode);
 #endif
 }
+
+// Map a whole file into memory, read-only. On Unix the mapping stays valid
+// if the file is replaced or unlinked later; elsewhere the file is just
+// read into memory.
+const unsigned char *map_file_u(const char *path, size_t &size)
+{
+#ifdef TARGET_OS_WINDOWS
+    FILE *fp = fopen_u(path, "rb");
+    if (!fp)
+        return nullptr;
+    unsigned char *data = nullptr;
+    if (!fseek(fp, 0, SEEK_END))
+    {
+        const long len = ftell(fp);
+        if (len > 0 && !fseek(fp, 0, SEEK_SET))
+        {
+            data = (unsigned char *)malloc(len);
+            if (data && fread(data, 1, len, fp) != (size_t)len)
+            {
+                free(data);
+                data = nullptr;
+            }
+            size = len;
+        }
+    }
+    fclose(fp);
+    return data;
+#else
+    int fd = open_u(path, O_RDONLY, 0);
+    if (fd == -1)
+        return nullptr;
+    struct stat st;
+    void *data = MAP_FAILED;
+    if (!fstat(fd, &st) && st.st_size > 0)
+        data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return nullptr;
+    size = st.st_size;
+    return (const unsigned char *)data;
+#endif
+}
+
+void unmap_file(const unsigned char *data, size_t size)
+{
+#ifdef TARGET_OS_WINDOWS
+    UNUSED(size);
+    free(const_cast<unsigned char *>(data));
+#else
+    munmap(const_cast<unsigned char *>(data), size);
+#endif
+}
@@ -36,3 +36,5 @@ int unlink_u(const char *pathname);
 FILE *fopen_u(const char *path, const char *mode);
 int mkdir_u(const char *pathname, mode_t mode);
 int open_u(const char *pathname, int flags, mode_t mode);
+const unsigned char *map_file_u(const char *path, size_t &size);
+void unmap_file(const unsigned char *data, size_t size);
@@ -240,6 +240,8 @@ enum tag_minor_version
     TAG_MINOR_GHOST_MAGIC,         // Ghost update for positional magic
     TAG_MINOR_MORE_GHOST_MAGIC,    // Update already placed ghosts for positional magic
     TAG_MINOR_DUMMY_AGILITY,       // Convert garbage "agility" potions into stab
+    TAG_MINOR_TRAVEL_COSTS,        // Save per-level travel costs for travel.
+    TAG_MINOR_MAP_BYTECODE,        // Save Lua bytecode with the source of map chunks.
 #endif
     NUM_TAG_MINORS,
     TAG_MINOR_VERSION = NUM_TAG_MINORS - 1
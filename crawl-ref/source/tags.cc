@@ -104,16 +104,16 @@ extern set<pair<string, level_id> > auto_unique_annotations;
 extern abyss_state abyssal_state;
 
 reader::reader(const string &_read_filename, int minorVersion)
-    : _filename(_read_filename), _chunk(0), _pbuf(nullptr), _read_offset(0),
-      _minorVersion(minorVersion), _safe_read(false)
+    : _filename(_read_filename), _chunk(0), _pbuf(nullptr), _pbuf_size(0),
+      _read_offset(0), _minorVersion(minorVersion), _safe_read(false)
 {
     _file       = fopen_u(_filename.c_str(), "rb");
     opened_file = !!_file;
 }
 
 reader::reader(package *save, const string &chunkname, int minorVersion)
-    : _file(0), _chunk(0), opened_file(false), _pbuf(0), _read_offset(0),
-     _minorVersion(minorVersion), _safe_read(false)
+    : _file(0), _chunk(0), opened_file(false), _pbuf(0), _pbuf_size(0),
+      _read_offset(0), _minorVersion(minorVersion), _safe_read(false)
 {
     ASSERT(save);
     _chunk = new chunk_reader(save, chunkname);
@@ -135,6 +135,12 @@ void reader::close()
 
 void reader::advance(size_t offset)
 {
+    if (_pbuf)
+    {
+        read(nullptr, offset);
+        return;
+    }
+
     char junk[128];
 
     while (offset)
@@ -148,7 +154,7 @@ void reader::advance(size_t offset)
 bool reader::valid() const
 {
     return (_file && !feof(_file)) ||
-           (_pbuf && _read_offset < _pbuf->size());
+           (_pbuf && _read_offset < _pbuf_size);
 }
 
 static NORETURN void _short_read(bool safe_read)
@@ -179,9 +185,9 @@ unsigned char reader::readByte()
     }
     else
     {
-        if (_read_offset >= _pbuf->size())
+        if (_read_offset >= _pbuf_size)
             _short_read(_safe_read);
-        return (*_pbuf)[_read_offset++];
+        return _pbuf[_read_offset++];
     }
 }
 
@@ -204,10 +210,10 @@ void reader::read(void *data, size_t size)
     }
     else
     {
-        if (_read_offset+size > _pbuf->size())
+        if (_read_offset+size > _pbuf_size)
             _short_read(_safe_read);
         if (data && size)
-            memcpy(data, &(*_pbuf)[_read_offset], size);
+            memcpy(data, _pbuf + _read_offset, size);
 
         _read_offset += size;
     }
@@ -229,7 +235,7 @@ void reader::fail_if_not_eof(const string &name)
     char dummy;
     if (_chunk ? _chunk->read(&dummy, 1) :
         _file ? (fgetc(_file) != EOF) :
-        _read_offset >= _pbuf->size())
+        _read_offset >= _pbuf_size)
     {
         fail("Incomplete read of \"%s\" - aborting.", name.c_str());
     }
@@ -5443,8 +5449,8 @@ void marshallMonster(writer &th, const monster& m)
     marshallInt(th, m.experience);
 
     marshallShort(th, m.enchantments.size());
-    for (const auto &entry : m.enchantments)
-        marshall_mon_enchant(th, entry.second);
+    for (const mon_enchant &me : m.enchantments)
+        marshall_mon_enchant(th, me);
     marshallByte(th, m.ench_countdown);
 
     marshallShort(th, min(m.hit_points, MAX_MONSTER_HP));
@@ -6333,11 +6339,7 @@ void unmarshallMonster(reader &th, monster& m)
     m.enchantments.clear();
     const int nenchs = unmarshallShort(th);
     for (int i = 0; i < nenchs; ++i)
-    {
-        mon_enchant me = unmarshall_mon_enchant(th);
-        m.enchantments[me.ench] = me;
-        m.ench_cache.set(me.ench, true);
-    }
+        m.enchantments.insert(unmarshall_mon_enchant(th));
     m.ench_countdown = unmarshallByte(th);
 
     m.hit_points     = unmarshallShort(th);
@@ -6748,6 +6750,8 @@ static void tag_read_level_monsters(reader &th)
     count = unmarshallShort(th);
     ASSERT_RANGE(count, 0, MAX_MONSTERS + 1);
 
+    // Any slot may be filled until we're done; see trim_monster_slots().
+    env.mons_used = MAX_MONSTERS;
     for (int i = 0; i < count; i++)
     {
         monster& m = menv[i];
@@ -6826,6 +6830,7 @@ static void tag_read_level_monsters(reader &th)
 #endif
         mgrd(m.pos()) = i;
     }
+    trim_monster_slots();
 #if TAG_MAJOR_VERSION == 34
     // This relies on TAG_YOU (including lost monsters) being unmarshalled
     // on game load before the initial level.
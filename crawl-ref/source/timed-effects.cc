@@ -27,6 +27,7 @@
 #include "message.h"
 #include "mgen-data.h"
 #include "monster.h"
+#include "mon-act.h"
 #include "mon-behv.h"
 #include "mon-death.h"
 #include "mon-pathfind.h"
@@ -652,8 +653,10 @@ static void _catchup_monster_move(monster* mon, int moves)
  *
  * @param mon       The monster under consideration
  * @param turns     The number of offlevel player turns to simulate.
+ * @param max_moves The most grids the monster may end up from where it
+ *                  started.
  */
-static void _catchup_monster_moves(monster* mon, int turns)
+static void _catchup_monster_moves(monster* mon, int turns, int max_moves)
 {
     // Summoned monsters might have disappeared.
     if (!mon->alive())
@@ -704,7 +707,8 @@ static void _catchup_monster_moves(monster* mon, int turns)
 
 
     const int mon_turns = (turns * mon->speed) / 10;
-    const int moves = min(mon_turns, 50);
+    // Settling into place at the end takes one more step.
+    const int moves = min(min(mon_turns, 50), max_moves - 1);
 
     // probably too annoying even for DEBUG_DIAGNOSTICS
     dprf("mon #%d: range %d; "
@@ -719,6 +723,10 @@ static void _catchup_monster_moves(monster* mon, int turns)
     // did the monster forget about the player?
     const bool forgot = _monster_forget(mon, mon_turns);
 
+    // No room to move at all.
+    if (moves < 0)
+        return;
+
     // restore behaviour later if we start fleeing
     unwind_var<beh_type> saved_beh(mon->behaviour);
 
@@ -773,9 +781,9 @@ void monster::timeout_enchantments(int levels)
         return;
 
     const mon_enchant_list ec = enchantments;
-    for (auto &entry : ec)
+    for (const mon_enchant &me : ec)
     {
-        switch (entry.first)
+        switch (me.ench)
         {
         case ENCH_POISON: case ENCH_CORONA:
         case ENCH_STICKY_FLAME: case ENCH_ABJ: case ENCH_SHORT_LIVED:
@@ -795,18 +803,17 @@ void monster::timeout_enchantments(int levels)
         case ENCH_FRIENDLY_BRIBED: case ENCH_CORROSION: case ENCH_GOLD_LUST:
         case ENCH_RESISTANCE: case ENCH_HEXED: case ENCH_IDEALISED:
         case ENCH_BOUND_SOUL: case ENCH_STILL_WINDS: case ENCH_RING_OF_THUNDER:
-            lose_ench_levels(entry.second, levels);
+            lose_ench_levels(me, levels);
             break;
 
         case ENCH_SLOW:
             if (torpor_slowed())
             {
-                lose_ench_levels(entry.second,
-                                 min(levels, entry.second.degree - 1));
+                lose_ench_levels(me, min(levels, me.degree - 1));
             }
             else
             {
-                lose_ench_levels(entry.second, levels);
+                lose_ench_levels(me, levels);
                 if (props.exists(TORPOR_SLOWED_KEY))
                     props.erase(TORPOR_SLOWED_KEY);
             }
@@ -814,7 +821,7 @@ void monster::timeout_enchantments(int levels)
 
         case ENCH_INVIS:
             if (!mons_class_flag(type, M_INVIS))
-                lose_ench_levels(entry.second, levels);
+                lose_ench_levels(me, levels);
             break;
 
         case ENCH_INSANE:
@@ -822,22 +829,22 @@ void monster::timeout_enchantments(int levels)
         case ENCH_INNER_FLAME:
         case ENCH_MERFOLK_AVATAR_SONG:
         case ENCH_INFESTATION:
-            del_ench(entry.first);
+            del_ench(me.ench);
             break;
 
         case ENCH_FATIGUE:
-            del_ench(entry.first);
+            del_ench(me.ench);
             del_ench(ENCH_SLOW);
             break;
 
         case ENCH_TP:
             teleport(true);
-            del_ench(entry.first);
+            del_ench(me.ench);
             break;
 
         case ENCH_CONFUSION:
             if (!mons_class_flag(type, M_CONFUSED))
-                del_ench(entry.first);
+                del_ench(me.ench);
             // That triggered a behaviour_event, which could have made a
             // pacified monster leave the level.
             if (alive() && !is_stationary())
@@ -845,20 +852,20 @@ void monster::timeout_enchantments(int levels)
             break;
 
         case ENCH_HELD:
-            del_ench(entry.first);
+            del_ench(me.ench);
             break;
 
         case ENCH_TIDE:
         {
             const int actdur = speed_to_duration(speed) * levels;
-            lose_ench_duration(entry.first, actdur);
+            lose_ench_duration(me.ench, actdur);
             break;
         }
 
         case ENCH_SLOWLY_DYING:
         {
             const int actdur = speed_to_duration(speed) * levels;
-            if (lose_ench_duration(entry.first, actdur))
+            if (lose_ench_duration(me.ench, actdur))
                 monster_die(*this, KILL_MISC, NON_MONSTER, true);
             break;
         }
@@ -910,6 +917,15 @@ void update_level(int elapsedTime)
         mons_total++;
 #endif
 
+        // Dormant monsters catch up on their time on the level and
+        // off it in one go. The player hasn't been placed yet, so they
+        // move as freely as anything else here.
+        if (mi->flags & MF_DORMANT)
+        {
+            wake_dormant_monster(**mi, INT_MAX);
+            continue;
+        }
+
         if (!update_monster(**mi, turns))
             continue;
     }
@@ -924,12 +940,14 @@ void update_level(int elapsedTime)
 /**
  * Update the monster upon the player's return
  *
- * @param mon   The monster to update.
- * @param turns How many turns (not auts) since the monster left the player
- * @returns     Returns nullptr if monster was destroyed by the update;
- *              Returns the updated monster if it still exists.
+ * @param mon       The monster to update.
+ * @param turns     How many turns (not auts) since the monster left the
+ *                  player
+ * @param max_moves The most grids the monster may move while catching up.
+ * @returns         Returns nullptr if monster was destroyed by the update;
+ *                  Returns the updated monster if it still exists.
  */
-monster* update_monster(monster& mon, int turns)
+monster* update_monster(monster& mon, int turns, int max_moves)
 {
     // Pacified monsters often leave the level now.
     if (mon.pacified() && turns > random2(40) + 21)
@@ -951,7 +969,7 @@ monster* update_monster(monster& mon, int turns)
     if (mon.caught())
         mon.del_ench(ENCH_HELD, true);
 
-    _catchup_monster_moves(&mon, turns);
+    _catchup_monster_moves(&mon, turns, max_moves);
 
     mon.foe_memory = max(mon.foe_memory - turns, 0);
 
@@ -1072,7 +1090,10 @@ void timeout_malign_gateways(int duration)
             {
                 // The marker hangs around until later.
                 if (env.grid(mmark->pos) == DNGN_MALIGN_GATEWAY)
+                {
                     env.grid(mmark->pos) = DNGN_FLOOR;
+                    set_terrain_changed(mmark->pos);
+                }
 
                 env.markers.remove(mmark);
             }
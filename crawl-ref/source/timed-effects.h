@@ -6,7 +6,7 @@
 #pragma once
 
 void update_level(int elapsedTime);
-monster* update_monster(monster& mon, int turns);
+monster* update_monster(monster& mon, int turns, int max_moves = INT_MAX);
 void handle_time();
 
 void timeout_tombs(int duration);
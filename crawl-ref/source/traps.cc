@@ -80,6 +80,7 @@ void trap_def::destroy(bool known)
         StashTrack.update_stash(pos);
     }
     env.trap.erase(pos);
+    set_terrain_changed(pos);
 }
 
 void trap_def::prepare_ammo(int charges)
@@ -0,0 +1,234 @@
+/**
+ * @file
+ * @brief A travel distance field that is repaired as the map changes.
+**/
+
+#include "AppHdr.h"
+
+#include "travel-field.h"
+
+#include <functional>
+#include <queue>
+
+#include "coord.h"
+#include "directn.h"
+
+// Values of via besides the Compass directions: no walk, the walk stops
+// here, or the walk takes links[via - VIA_LINK].
+static const int VIA_NONE   = -1;
+static const int VIA_SOURCE = 8;
+static const int VIA_LINK   = 9;
+
+travel_field::travel_field()
+{
+    clear();
+}
+
+void travel_field::clear()
+{
+    passable.init(false);
+    cost.init(1);
+    source.init(INFINITE_DISTANCE);
+    dist.init(INFINITE_DISTANCE);
+    via.init(VIA_NONE);
+    links.clear();
+    changed.init(false);
+    changes.clear();
+    recomputed = 0;
+}
+
+void travel_field::mark(const coord_def &c)
+{
+    if (!changed(c))
+    {
+        changed(c) = true;
+        changes.push_back(c);
+    }
+}
+
+void travel_field::set_grid(const coord_def &c, bool pass, int grid_cost,
+                            int grid_source)
+{
+    ASSERT(map_bounds(c));
+    ASSERT(grid_cost > 0);
+
+    if (!pass)
+    {
+        grid_cost = 1;
+        grid_source = INFINITE_DISTANCE;
+    }
+
+    if (passable(c) == pass && cost(c) == grid_cost
+        && source(c) == grid_source)
+    {
+        return;
+    }
+
+    passable(c) = pass;
+    cost(c) = grid_cost;
+    source(c) = grid_source;
+    mark(c);
+}
+
+void travel_field::set_links(const vector<pair<coord_def, coord_def>> &to)
+{
+    if (to == links)
+        return;
+
+    // Only the grid a link leaves from can have its walk go through it.
+    for (const pair<coord_def, coord_def> &link : links)
+        mark(link.first);
+    for (const pair<coord_def, coord_def> &link : to)
+    {
+        ASSERT(map_bounds(link.first));
+        ASSERT(map_bounds(link.second));
+        mark(link.first);
+    }
+    links = to;
+}
+
+// The best walk from c that takes a step or link first, and how it goes.
+int travel_field::best_from_neighbours(const coord_def &c, int &how) const
+{
+    int best = INFINITE_DISTANCE;
+    how = VIA_NONE;
+
+    for (int dir = 0; dir < 8; ++dir)
+    {
+        const coord_def n = c + Compass[dir];
+        if (!map_bounds(n) || !passable(n) || dist(n) >= INFINITE_DISTANCE)
+            continue;
+        if (dist(n) + cost(n) < best)
+        {
+            best = dist(n) + cost(n);
+            how = dir;
+        }
+    }
+
+    for (int i = 0, size = links.size(); i < size; ++i)
+    {
+        const coord_def &n = links[i].second;
+        if (links[i].first != c || !passable(n)
+            || dist(n) >= INFINITE_DISTANCE)
+        {
+            continue;
+        }
+        if (dist(n) + cost(n) < best)
+        {
+            best = dist(n) + cost(n);
+            how = VIA_LINK + i;
+        }
+    }
+
+    return best;
+}
+
+void travel_field::repair()
+{
+    recomputed = 0;
+    if (changes.empty())
+        return;
+
+    // Forget the distance of every changed grid, and of every grid whose
+    // walk goes through one. Everything else still has a walk that the
+    // changes didn't touch, though maybe no longer the best.
+    vector<coord_def> lost;
+    lost.swap(changes);
+    for (size_t i = 0; i < lost.size(); ++i)
+    {
+        const coord_def c = lost[i];
+        dist(c) = INFINITE_DISTANCE;
+        via(c) = VIA_NONE;
+
+        for (int dir = 0; dir < 8; ++dir)
+        {
+            const coord_def w = c - Compass[dir];
+            if (map_bounds(w) && !changed(w) && via(w) == dir)
+            {
+                changed(w) = true;
+                lost.push_back(w);
+            }
+        }
+        for (int j = 0, size = links.size(); j < size; ++j)
+        {
+            const coord_def &w = links[j].first;
+            if (links[j].second == c && !changed(w) && via(w) == VIA_LINK + j)
+            {
+                changed(w) = true;
+                lost.push_back(w);
+            }
+        }
+    }
+
+    // Start those grids from what their neighbours still have, then let
+    // better walks spread outwards, Dijkstra style. That includes the
+    // better walks the changes opened up.
+    typedef pair<int, coord_def> queued;
+    priority_queue<queued, vector<queued>, greater<queued>> todo;
+    for (const coord_def &c : lost)
+    {
+        changed(c) = false;
+        if (!passable(c))
+            continue;
+
+        int how;
+        int best = best_from_neighbours(c, how);
+        if (source(c) <= best)
+        {
+            best = source(c);
+            how = VIA_SOURCE;
+        }
+        if (best < INFINITE_DISTANCE)
+        {
+            dist(c) = best;
+            via(c) = how;
+            todo.emplace(best, c);
+        }
+    }
+    recomputed = lost.size();
+
+    while (!todo.empty())
+    {
+        const queued top = todo.top();
+        todo.pop();
+        const coord_def c = top.second;
+        if (top.first != dist(c))
+            continue;
+
+        const int onward = dist(c) + cost(c);
+        for (int dir = 0; dir < 8; ++dir)
+        {
+            const coord_def w = c + Compass[dir];
+            if (map_bounds(w) && passable(w) && onward < dist(w))
+            {
+                dist(w) = onward;
+                via(w) = (dir + 4) % 8;
+                todo.emplace(onward, w);
+                ++recomputed;
+            }
+        }
+        for (int j = 0, size = links.size(); j < size; ++j)
+        {
+            const coord_def &w = links[j].first;
+            if (links[j].second == c && passable(w) && onward < dist(w))
+            {
+                dist(w) = onward;
+                via(w) = VIA_LINK + j;
+                todo.emplace(onward, w);
+                ++recomputed;
+            }
+        }
+    }
+}
+
+coord_def travel_field::next(const coord_def &c) const
+{
+    const int how = via(c);
+    if (how == VIA_NONE)
+        return coord_def();
+    if (how == VIA_SOURCE)
+        return c;
+    if (how >= VIA_LINK)
+        return links[how - VIA_LINK].second;
+    return c + Compass[how];
+}
@@ -0,0 +1,71 @@
+/**
+ * @file
+ * @brief A travel distance field that is repaired as the map changes.
+**/
+
+#pragma once
+
+#include "fixedarray.h"
+
+// The cost to reach some source from every grid of the level, for travel.
+// Grids are passable or not, and cost something to walk onto; sources are
+// passable grids with a cost of their own for ending the walk there.
+//
+//   distance(c) = min(source cost of c,
+//                     min over passable neighbours n of c of
+//                         distance(n) + cost(n))
+//
+// Changing a grid only marks it: repair() then brings the field up to date
+// by recomputing only the grids whose best way went through a changed grid,
+// plus wherever a changed grid now offers a better way.
+class travel_field
+{
+public:
+    travel_field();
+
+    // Forget every grid: all are impassable, and none is a source.
+    void clear();
+
+    // Set what the field knows about c. It takes effect at repair().
+    void set_grid(const coord_def &c, bool passable, int cost,
+                  int source = INFINITE_DISTANCE);
+
+    // Let walks go from each first grid straight onto its second, the way
+    // a transporter takes the player to its landing. The grid left costs
+    // nothing extra, as for a step.
+    void set_links(const vector<pair<coord_def, coord_def>> &links);
+
+    void repair();
+
+    // INFINITE_DISTANCE if no source can be reached from c.
+    int distance(const coord_def &c) const { return dist(c); }
+
+    // Where the best walk from c goes next: c itself if it's best to stop
+    // at c, or the origin if there is no walk.
+    coord_def next(const coord_def &c) const;
+
+    // How many grids the last repair() had to recompute.
+    int repaired() const { return recomputed; }
+
+private:
+    int best_from_neighbours(const coord_def &c, int &how) const;
+    void mark(const coord_def &c);
+
+private:
+    FixedArray<bool, GXM, GYM> passable;
+    FixedArray<int, GXM, GYM> cost;
+    FixedArray<int, GXM, GYM> source;
+
+    FixedArray<int, GXM, GYM> dist;
+    // How dist was reached: a Compass direction, or one of the values in
+    // travel-field.cc.
+    FixedArray<int, GXM, GYM> via;
+
+    vector<pair<coord_def, coord_def>> links;
+
+    // Grids changed since the last repair.
+    FixedArray<bool, GXM, GYM> changed;
+    vector<coord_def> changes;
+
+    int recomputed;
+};
@@ -56,6 +56,7 @@
 #include "terrain.h"
 #include "tiles-build-specific.h"
 #include "traps.h"
+#include "travel-field.h"
 #include "unicode.h"
 #include "unwind.h"
 #include "view.h"
@@ -189,6 +190,9 @@ static bool _is_travelsafe_square(const coord_def& c,
                                   bool ignore_hostile = false,
                                   bool ignore_danger = false,
                                   bool try_fallback = false);
+static void _forget_travel_fields();
+static void _update_explore_field();
+static coord_def _explore_field_target();
 
 // Returns true if there is a known trap at (x,y). Returns false for non-trap
 // squares as also for undiscovered traps.
@@ -638,6 +642,8 @@ static int _slowest_ally_speed()
 
 static void _start_running()
 {
+    _forget_travel_fields();
+
     _userdef_run_startrunning_hook();
     you.running.init_travel_speed();
 
@@ -716,6 +722,16 @@ static void _set_target_square(const coord_def &target)
 
 static void _explore_find_target_square()
 {
+    // Usually the explore field has the answer. Otherwise, search the
+    // whole way: that also finds targets that are unsafe to reach, and
+    // why exploring is done.
+    const coord_def nearest = _explore_field_target();
+    if (!nearest.origin())
+    {
+        _set_target_square(nearest);
+        return;
+    }
+
     bool runed_door_pause = false;
 
     travel_pathfind tp;
@@ -943,6 +959,7 @@ command_type travel()
 
         // Speed up explore by not doing a double-floodfill if we have
         // a valid target.
+        _update_explore_field();
         if (!you.running.pos.x
             || you.running.pos == you.pos()
             || !_is_valid_explore_target(you.running.pos))
@@ -1722,6 +1739,375 @@ bool travel_pathfind::path_examine_point(const coord_def &c)
     return found_target;
 }
 
+// Travel and explore take the player one step at a time towards the same
+// target, and each step used to flood the level from the target again to
+// find the next move. Instead, the distances from the target are kept in a
+// travel_field, which each step repairs where map knowledge changed.
+//
+// Map knowledge mostly changes within sight, so each step looks at the
+// grids around the player for changes. Anything newly seen or mapped
+// elsewhere is passed on by travel_knowledge_changed(). The field is built
+// afresh when a run starts, or if anything it depends on besides map
+// knowledge changes.
+
+// What a travel flood depends on besides the map knowledge of each grid.
+struct travel_flood_key
+{
+    level_id level;
+    coord_def target;
+    bool slime_wall_check;
+    bool likes_water;
+    bool permanent_flight;
+    bool water_walk;
+    vector<pair<coord_def, int>> excludes;
+    vector<pair<coord_def, coord_def>> transporters;
+
+    bool operator==(const travel_flood_key &other) const
+    {
+        return level == other.level
+               && target == other.target
+               && slime_wall_check == other.slime_wall_check
+               && likes_water == other.likes_water
+               && permanent_flight == other.permanent_flight
+               && water_walk == other.water_walk
+               && excludes == other.excludes
+               && transporters == other.transporters;
+    }
+};
+
+struct travel_flood_cache
+{
+    travel_flood_key key;
+    // The distance of each grid from the target.
+    travel_field field;
+    // Grids travel_knowledge_changed() was told about since the last step.
+    vector<coord_def> knowledge_changes;
+};
+static unique_ptr<travel_flood_cache> travel_flood;
+
+// What explore looks for, as travel_pathfind::pathfind() scores it.
+struct explore_field_key
+{
+    // With no target, and never any transporters.
+    travel_flood_key travel;
+    bool greedy;
+    int item_greed;
+    int wall_bias;
+
+    bool operator==(const explore_field_key &other) const
+    {
+        return travel == other.travel
+               && greedy == other.greedy
+               && item_greed == other.item_greed
+               && wall_bias == other.wall_bias;
+    }
+};
+
+struct explore_field_cache
+{
+    explore_field_key key;
+    // The distance of each grid from the nearest explore target, counting
+    // the target's wall bias and item greed penalties.
+    travel_field field;
+    vector<coord_def> knowledge_changes;
+};
+static unique_ptr<explore_field_cache> explore_field;
+
+// Map knowledge may change between runs in ways the kept fields don't
+// hear about, so each run starts afresh.
+static void _forget_travel_fields()
+{
+    travel_flood.reset();
+    explore_field.reset();
+}
+
+void travel_knowledge_changed(const coord_def &c)
+{
+    // Past a level's worth of changes, building afresh is no slower.
+    if (travel_flood)
+    {
+        travel_flood->knowledge_changes.push_back(c);
+        if (travel_flood->knowledge_changes.size() > GXM * GYM)
+            travel_flood.reset();
+    }
+    if (explore_field)
+    {
+        explore_field->knowledge_changes.push_back(c);
+        if (explore_field->knowledge_changes.size() > GXM * GYM)
+            explore_field.reset();
+    }
+}
+
+static travel_flood_key _travel_flood_key()
+{
+    travel_flood_key key;
+    key.level = level_id::current();
+    key.target = you.running.pos;
+    key.slime_wall_check = !actor_slime_wall_immune(&you);
+    key.likes_water = player_likes_water(true);
+    // What the travel code thinks of deep water and lava depends on these.
+    key.permanent_flight = you.permanent_flight();
+    key.water_walk = have_passive(passive_t::water_walk);
+
+    for (const auto &entry : curr_excludes)
+        key.excludes.emplace_back(entry.second.pos, entry.second.radius);
+
+    LevelInfo &li = travel_cache.get_level_info(level_id::current());
+    for (const transporter_info &ti : li.get_transporters())
+        key.transporters.emplace_back(ti.position, ti.destination);
+
+    return key;
+}
+
+// Tell the field what travel_pathfind::pathfind(RMODE_TRAVEL) would think
+// of c: the flood starts from the target whatever it is.
+static void _set_travel_flood_grid(travel_field &field, const coord_def &c,
+                                   const coord_def &target)
+{
+    const bool is_target = c == target;
+    field.set_grid(c, is_target || _is_travelsafe_square(c),
+                   _feature_traverse_cost(env.map_knowledge(c).feat()),
+                   is_target ? 0 : INFINITE_DISTANCE);
+}
+
+// A flood from the target reaches a transporter from its landing.
+static void _set_travel_flood_links(travel_flood_cache &cache)
+{
+    vector<pair<coord_def, coord_def>> links;
+    for (const pair<coord_def, coord_def> &ti : cache.key.transporters)
+    {
+        const coord_def &landing = ti.second;
+        if (in_bounds(ti.first) && in_bounds(landing)
+            && grd(landing) == DNGN_TRANSPORTER_LANDING)
+        {
+            links.push_back(ti);
+        }
+    }
+    cache.field.set_links(links);
+}
+
+static void _update_travel_flood(const coord_def& youpos)
+{
+    const travel_flood_key key = _travel_flood_key();
+    unwind_bool slime_wall_check(g_Slime_Wall_Check, key.slime_wall_check);
+
+    if (!travel_flood || !(travel_flood->key == key))
+    {
+        if (!travel_flood)
+            travel_flood.reset(new travel_flood_cache);
+        travel_flood->key = key;
+        travel_flood->field.clear();
+        travel_flood->knowledge_changes.clear();
+        for (rectangle_iterator ri(0); ri; ++ri)
+            _set_travel_flood_grid(travel_flood->field, *ri, key.target);
+    }
+    else
+    {
+        // Slime walls make their neighbours unsafe.
+        for (const coord_def &c : travel_flood->knowledge_changes)
+            for (adjacent_iterator ai(c, false); ai; ++ai)
+                if (map_bounds(*ai))
+                {
+                    _set_travel_flood_grid(travel_flood->field, *ai,
+                                           key.target);
+                }
+        travel_flood->knowledge_changes.clear();
+
+        for (rectangle_iterator ri(youpos, LOS_MAX_RANGE); ri; ++ri)
+            if (map_bounds(*ri))
+                _set_travel_flood_grid(travel_flood->field, *ri, key.target);
+    }
+
+    _set_travel_flood_links(*travel_flood);
+    travel_flood->field.repair();
+}
+
+// The next travel move from youpos towards you.running.pos, as
+// travel_pathfind::pathfind(RMODE_TRAVEL) would find it. Where several
+// moves are equally short, this may pick a different one.
+static coord_def _travel_flood_move(const coord_def& youpos)
+{
+    const coord_def target = you.running.pos;
+
+    // The same early exits as pathfind().
+    if (!in_bounds(target))
+        return coord_def();
+    if (!_is_travelsafe_square(target, false, false, true)
+        && !is_trap(target))
+    {
+        return coord_def();
+    }
+    if (youpos == target)
+        return target;
+
+    _update_travel_flood(youpos);
+    const travel_field &field = travel_flood->field;
+
+    // Reached by a step, or by a transporter landing the player here.
+    vector<coord_def> moves;
+    for (adjacent_iterator ai(youpos); ai; ++ai)
+        moves.push_back(*ai);
+    for (const pair<coord_def, coord_def> &ti : travel_flood->key.transporters)
+    {
+        const coord_def &landing = ti.second;
+        if (ti.first == youpos && in_bounds(landing)
+            && grd(landing) == DNGN_TRANSPORTER_LANDING)
+        {
+            moves.push_back(landing);
+        }
+    }
+
+    coord_def move;
+    int best = INFINITE_DISTANCE;
+    for (const coord_def &m : moves)
+    {
+        if (!map_bounds(m) || field.distance(m) >= INFINITE_DISTANCE)
+            continue;
+
+        const int dist = field.distance(m)
+                         + _feature_traverse_cost(env.map_knowledge(m).feat());
+        if (dist < best)
+        {
+            best = dist;
+            move = m;
+        }
+    }
+
+    if (move.origin() || !_is_safe_move(move))
+        return coord_def();
+    return move;
+}
+
+static explore_field_key _explore_field_key()
+{
+    explore_field_key key;
+    key.travel = _travel_flood_key();
+    key.travel.target.reset();
+    key.greedy = you.running == RMODE_EXPLORE_GREEDY && can_autopickup();
+    key.item_greed = Options.explore_item_greed;
+    key.wall_bias = Options.explore_wall_bias;
+    return key;
+}
+
+// The smallest penalty explore gives a target at c, or INFINITE_DISTANCE
+// if c isn't one: see travel_pathfind::path_flood() and
+// check_square_greed().
+static int _explore_target_penalty(const explore_field_key &key,
+                                   const LevelStashes *ls,
+                                   const coord_def &c)
+{
+    int best = INFINITE_DISTANCE;
+
+    for (adjacent_iterator ai(c); ai; ++ai)
+    {
+        if (!in_bounds(*ai) || env.map_knowledge(*ai).seen())
+            continue;
+
+        int penalty = 0;
+        if (key.greedy && key.item_greed > 0)
+            penalty += key.item_greed;
+
+        if (key.wall_bias)
+        {
+            penalty += key.wall_bias * 4;
+            for (int dir = 0; dir < 8; dir += 2)
+                if (feat_is_wall(env.map_knowledge(*ai + Compass[dir]).feat()))
+                    penalty -= key.wall_bias;
+        }
+
+        best = min(best, penalty);
+    }
+
+    if (key.greedy && _is_greed_inducing_square(ls, c, true))
+    {
+        int penalty = 0;
+        if (key.item_greed < 0)
+            penalty -= key.item_greed;
+        if (key.wall_bias)
+            penalty += key.wall_bias * 3;
+
+        best = min(best, penalty);
+    }
+
+    return best;
+}
+
+// Explore floods out from the player, whatever grid they're on.
+static void _set_explore_grid(explore_field_cache &cache,
+                              const LevelStashes *ls, const coord_def &c)
+{
+    const bool passable = c == you.pos() || _is_travelsafe_square(c);
+    cache.field.set_grid(c, passable,
+                         _feature_traverse_cost(env.map_knowledge(c).feat()),
+                         passable ? _explore_target_penalty(cache.key, ls, c)
+                                  : INFINITE_DISTANCE);
+}
+
+// Bring the explore field up to date. This runs on every step of explore,
+// to catch changes within sight while they're still within sight.
+static void _update_explore_field()
+{
+    const explore_field_key key = _explore_field_key();
+
+    // The field doesn't follow transporters the way explore does.
+    if (!key.travel.transporters.empty())
+    {
+        explore_field.reset();
+        return;
+    }
+
+    unwind_bool slime_wall_check(g_Slime_Wall_Check,
+                                 key.travel.slime_wall_check);
+    const LevelStashes *ls = key.greedy ? StashTrack.find_current_level()
+                                        : nullptr;
+
+    if (!explore_field || !(explore_field->key == key))
+    {
+        if (!explore_field)
+            explore_field.reset(new explore_field_cache);
+        explore_field->key = key;
+        explore_field->field.clear();
+        explore_field->knowledge_changes.clear();
+        for (rectangle_iterator ri(0); ri; ++ri)
+            _set_explore_grid(*explore_field, ls, *ri);
+    }
+    else
+    {
+        // Whether a grid is a target depends on what's up to two grids
+        // away: its unseen neighbours, and the walls around those.
+        for (const coord_def &c : explore_field->knowledge_changes)
+            for (rectangle_iterator ri(c, 2); ri; ++ri)
+                if (map_bounds(*ri))
+                    _set_explore_grid(*explore_field, ls, *ri);
+        explore_field->knowledge_changes.clear();
+
+        // The player's old grid is in here too.
+        for (rectangle_iterator ri(you.pos(), LOS_MAX_RANGE + 2); ri; ++ri)
+            if (map_bounds(*ri))
+                _set_explore_grid(*explore_field, ls, *ri);
+    }
+
+    explore_field->field.repair();
+}
+
+// The explore target nearest the player, as the first flood of
+// travel_pathfind::pathfind() would find it, or the origin if that flood
+// would find none.
+static coord_def _explore_field_target()
+{
+    if (!explore_field)
+        return coord_def();
+
+    const travel_field &field = explore_field->field;
+    coord_def c = you.pos();
+    if (field.distance(c) >= INFINITE_DISTANCE)
+        return coord_def();
+
+    for (coord_def next = field.next(c); next != c; next = field.next(c))
+        c = next;
+    return c;
+}
+
 /**
  * Run the travel_pathfind algorithm, either from the given position in
  * floodout mode to populate travel_point_distance relative to that starting
@@ -1758,7 +2144,8 @@ void find_travel_pos(const coord_def& youpos,
 
     run_mode_type rmode = (need_move) ? RMODE_TRAVEL : RMODE_NOT_RUNNING;
 
-    coord_def dest = tp.pathfind(rmode, false);
+    coord_def dest = need_move ? _travel_flood_move(youpos)
+                               : tp.pathfind(rmode, false);
     if (dest.origin())
         dest = tp.pathfind(rmode, true);
     coord_def new_dest = dest;
@@ -3004,6 +3391,18 @@ static int _find_transtravel_stair(const level_id &cur,
 
 static bool _loadlev_populate_stair_distances(const level_pos &target)
 {
+    // The travel cache knows how to get around levels the player has left,
+    // so there's no need to load the level unless it's from an old save.
+    LevelInfo &li = travel_cache.get_level_info(target.id);
+    vector<int> dists;
+    if (li.stair_distances_from(target.pos, dists))
+    {
+        curr_stairs = li.get_stairs();
+        for (unsigned int i = 0; i < curr_stairs.size(); ++i)
+            curr_stairs[i].distance = dists[i];
+        return true;
+    }
+
     level_excursion excursion;
     excursion.go_to(target.id);
     _populate_stair_distances(target);
@@ -3405,6 +3804,7 @@ void LevelInfo::update()
         !actor_slime_wall_immune(&you));
     precompute_travel_safety_grid travel_safety_calc;
     update_stair_distances();
+    update_travel_costs();
 
     vector<coord_def> transporter_positions;
     get_transporters(transporter_positions);
@@ -3449,6 +3849,86 @@ void LevelInfo::update_stair_distances()
         set_distance_between_stairs(nstairs - 1, nstairs - 1, 0);
 }
 
+void LevelInfo::update_travel_costs()
+{
+    travel_costs.assign((GXM * GYM + 3) / 4, 0);
+    for (rectangle_iterator ri(1); ri; ++ri)
+    {
+        if (!_is_travelsafe_square(*ri))
+            continue;
+
+        const int cost =
+            _feature_traverse_cost(env.map_knowledge(*ri).feat());
+        const int i = ri->x * GYM + ri->y;
+        travel_costs[i / 4] |= cost << (2 * (i % 4));
+    }
+}
+
+int LevelInfo::travel_cost(const coord_def &p) const
+{
+    const int i = p.x * GYM + p.y;
+    return travel_costs[i / 4] >> (2 * (i % 4)) & 3;
+}
+
+bool LevelInfo::stair_distances_from(const coord_def &pos,
+                                     vector<int> &dists) const
+{
+    if (travel_costs.empty())
+        return false;
+
+    // The same flood as find_travel_pos() from pos: leaving a square takes
+    // as long as crossing it, which is at most three turns, so the squares
+    // still to be examined fit in four buckets by distance.
+    FixedArray<int, GXM, GYM> dist(INFINITE_DISTANCE);
+    vector<coord_def> buckets[4];
+    dist(pos) = 0;
+    buckets[0].push_back(pos);
+    int pending = 1;
+    for (int d = 0; pending; ++d)
+    {
+        vector<coord_def> &bucket = buckets[d % 4];
+        for (const coord_def c : bucket)
+        {
+            --pending;
+            if (dist(c) != d)
+                continue;
+
+            // pos itself need not be safe to stand on.
+            const int nd = d + max(travel_cost(c), 1);
+            auto flood = [&](const coord_def &dc)
+            {
+                if (in_bounds(dc) && travel_cost(dc) && nd < dist(dc))
+                {
+                    dist(dc) = nd;
+                    buckets[nd % 4].push_back(dc);
+                    ++pending;
+                }
+            };
+
+            for (adjacent_iterator ai(c); ai; ++ai)
+                flood(*ai);
+            // As in travel_pathfind, excluded transporters aren't taken.
+            for (const transporter_info &ti : transporters)
+            {
+                if (ti.position == c && ti.destination != INVALID_COORD
+                    && !excludes.is_excluded(c))
+                {
+                    flood(ti.destination);
+                }
+            }
+        }
+        bucket.clear();
+    }
+
+    dists.clear();
+    for (const stair_info &si : stairs)
+    {
+        const int sd = dist(si.position);
+        dists.push_back(sd == INFINITE_DISTANCE ? -1 : sd);
+    }
+    return true;
+}
+
 void LevelInfo::update_transporter(const coord_def& transpos,
                                    const coord_def& dest)
 {
@@ -3821,6 +4301,10 @@ void LevelInfo::save(writer& outf) const
     marshallByte(outf, NUM_DACTION_COUNTERS);
     for (int i = 0; i < NUM_DACTION_COUNTERS; i++)
         marshallShort(outf, daction_counters[i]);
+
+    marshallShort(outf, travel_costs.size());
+    for (uint8_t costs : travel_costs)
+        marshallUByte(outf, costs);
 }
 
 void LevelInfo::load(reader& inf, int minorVersion)
@@ -3872,6 +4356,19 @@ void LevelInfo::load(reader& inf, int minorVersion)
     ASSERT_RANGE(n_count, 0, NUM_DACTION_COUNTERS + 1);
     for (int i = 0; i < n_count; i++)
         daction_counters[i] = unmarshallShort(inf);
+
+    travel_costs.clear();
+#if TAG_MAJOR_VERSION == 34
+    if (minorVersion >= TAG_MINOR_TRAVEL_COSTS)
+    {
+#endif
+    const int cost_count = unmarshallShort(inf);
+    ASSERT(!cost_count || cost_count == (GXM * GYM + 3) / 4);
+    for (int i = 0; i < cost_count; ++i)
+        travel_costs.push_back(unmarshallUByte(inf));
+#if TAG_MAJOR_VERSION == 34
+    }
+#endif
 }
 
 void LevelInfo::fixup()
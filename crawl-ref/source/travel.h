@@ -71,6 +71,9 @@ bool is_unknown_transporter(const coord_def &p);
 void find_travel_pos(const coord_def& youpos, int *move_x, int *move_y,
                      vector<coord_def>* coords = nullptr);
 
+// Map knowledge of c changed: it was seen for the first time, or mapped.
+void travel_knowledge_changed(const coord_def &c);
+
 bool is_stair_exclusion(const coord_def &p);
 
 /* ***********************************************************************
@@ -357,6 +360,12 @@ struct LevelInfo
     // or does not exist in our list of stairs, returns 0.
     int distance_between(const stair_info *s1, const stair_info *s2) const;
 
+    // Returns the travel distance from pos to each stair, in the order of
+    // get_stairs(), using the travel costs saved when the level was last
+    // updated: -1 for stairs that can't be reached. Returns false if no
+    // travel costs were saved for this level.
+    bool stair_distances_from(const coord_def &pos, vector<int> &dists) const;
+
     void update_excludes();
     void update();              // Update LevelInfo to be correct for the
                                 // current level.
@@ -384,6 +393,8 @@ private:
     void correct_stair_list(const vector<coord_def> &s);
     void correct_transporter_list(const vector<coord_def> &s);
     void update_stair_distances();
+    void update_travel_costs();
+    int travel_cost(const coord_def &p) const;
     void sync_all_branch_stairs();
     void sync_branch_stairs(const stair_info *si);
     void set_distance_between_stairs(int a, int b, int dist);
@@ -397,6 +408,12 @@ private:
     exclude_set excludes;
 
     vector<short> stair_distances;  // Dist between stairs
+
+    // The cost of crossing each known square, two bits per square: 0 if it
+    // isn't safe to travel over, else the number of turns it takes to
+    // cross. Lets travel plan routes to a square on another level without
+    // loading it.
+    vector<uint8_t> travel_costs;
     level_id id;
 
     friend class TravelCache;
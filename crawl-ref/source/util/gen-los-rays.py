@@ -0,0 +1,608 @@
+#!/usr/bin/env python
+
+"""Generate los-rays.h, the precomputed ray tables used by los.cc.
+
+This casts the same bundle of rays through one quadrant that los.cc used to
+cast at startup, and writes out the unique full rays, the minimal cellrays
+and the blockray bitmasks.
+
+The geometry mirrors geom2d.cc and ray.cc step for step, using the same
+double precision arithmetic, so that the rays come out exactly as the game
+would compute them. If you change the ray code, change this too.
+
+Usage: gen-los-rays.py defines.h los-rays.h
+"""
+
+from __future__ import print_function
+
+import math
+import re
+import sys
+
+# los.h
+EPSILON_VALUE = 0.00001
+# los.cc
+LOS_INTERCEPT_MULT = 2
+
+
+def los_is_zero(x):
+    """double_is_zero() in los.cc"""
+    return -EPSILON_VALUE < x < EPSILON_VALUE
+
+
+def geom_is_zero(x):
+    """double_is_zero() in geom2d.cc"""
+    return abs(x) < 0.0000001
+
+
+def c_round(x):
+    """C's round(): halfway cases away from zero."""
+    a = abs(x)
+    f = math.floor(a)
+    if a - f >= 0.5:
+        f += 1
+    return math.copysign(f, x)
+
+
+#############################################################################
+# geom2d.cc
+
+class Vector(object):
+    __slots__ = ('x', 'y')
+
+    def __init__(self, x, y):
+        self.x = x
+        self.y = y
+
+    def copy(self):
+        return Vector(self.x, self.y)
+
+
+class Form(object):
+    def __init__(self, a, b):
+        self.a = a
+        self.b = b
+
+    def __call__(self, v):
+        return self.a * v.x + self.b * v.y
+
+
+class LineSeq(object):
+    def __init__(self, a, b, offset, dist):
+        self.f = Form(a, b)
+        self.offset = offset
+        self.dist = dist
+
+    def index(self, v):
+        return (self.f(v) - self.offset) / self.dist
+
+
+def parallel(v, f):
+    return geom_is_zero(f(v))
+
+
+def nextintersect(r, ls):
+    fp = ls.f(r.start)
+    fd = ls.f(r.dir)
+    a = (fp - ls.offset) / ls.dist
+    k = math.ceil(a) if ls.dist * fd > 0 else math.floor(a)
+    if geom_is_zero(k - a):
+        k += 1 if ls.dist * fd > 0 else -1
+    return (k - a) * ls.dist / fd
+
+
+class Ray(object):
+    def __init__(self, x0, y0, xd, yd):
+        self.start = Vector(x0, y0)
+        self.dir = Vector(xd, yd)
+
+    def copy(self):
+        return Ray(self.start.x, self.start.y, self.dir.x, self.dir.y)
+
+    def advance(self, t):
+        self.start = Vector(self.start.x + t * self.dir.x,
+                            self.start.y + t * self.dir.y)
+
+    def to_grid(self, g, half):
+        corner = False
+        if parallel(self.dir, g[0].f):
+            t = nextintersect(self, g[1])
+        elif parallel(self.dir, g[1].f):
+            t = nextintersect(self, g[0])
+        else:
+            r = nextintersect(self, g[0])
+            s = nextintersect(self, g[1])
+            t = min(r, s)
+            corner = geom_is_zero(r - s)
+        self.advance(0.5 * t if half else t)
+        return corner and not half
+
+    def to_next_cell(self, g):
+        if self.to_grid(g, False):
+            return True
+        self.to_grid(g, True)
+        return False
+
+
+#############################################################################
+# ray.cc
+
+DIAMONDS = (LineSeq(1, 1, 0.5, 1), LineSeq(1, -1, -0.5, 1))
+
+
+def iround(d):
+    return int(c_round(d))
+
+
+def ifloor(d):
+    r = iround(d)
+    if los_is_zero(d - r):
+        return r
+    return int(math.floor(d))
+
+
+def double_is_integral(d):
+    return los_is_zero(d - c_round(d))
+
+
+def in_diamond_int(v):
+    d1 = DIAMONDS[0].index(v)
+    d2 = DIAMONDS[1].index(v)
+    return (not double_is_integral(d1) and not double_is_integral(d2)
+            and (ifloor(d1) + ifloor(d2)) % 2 == 0)
+
+
+def is_corner(v):
+    d1 = DIAMONDS[0].index(v)
+    d2 = DIAMONDS[1].index(v)
+    return double_is_integral(d1) and double_is_integral(d2)
+
+
+def floor_vec(v):
+    return (ifloor(v.x), ifloor(v.y))
+
+
+def round_to_corner(r):
+    v = Vector(2.0 * r.start.x, 2.0 * r.start.y)
+    v.x = c_round(v.x)
+    v.y = c_round(v.y)
+    r.start = Vector(0.5 * v.x, 0.5 * v.y)
+
+
+def round_to_grid(r):
+    v = r.start.copy()
+    s = v.x + v.y - 0.5
+    d = v.x - v.y - 0.5
+    deltas = c_round(s) - s
+    deltad = c_round(d) - d
+    if abs(deltas) <= abs(deltad):
+        v.x += 0.5 * deltas
+        v.y += 0.5 * deltas
+    else:
+        v.x += 0.5 * deltad
+        v.y -= 0.5 * deltad
+    r.start = v
+
+
+def ray_to_next_cell(r):
+    c = r.to_next_cell(DIAMONDS)
+    if c:
+        round_to_corner(r)
+    return c
+
+
+def ray_to_grid(r, half):
+    c = r.to_grid(DIAMONDS, half)
+    if not half:
+        round_to_grid(r)
+    c = c or is_corner(r.start)
+    if c:
+        round_to_corner(r)
+    return c
+
+
+class RayDef(object):
+    """ray_def"""
+
+    def __init__(self, r):
+        self.r = r
+        self.on_corner = False
+
+    def copy(self):
+        c = RayDef(self.r.copy())
+        c.on_corner = self.on_corner
+        return c
+
+    def pos(self):
+        return floor_vec(self.r.start)
+
+    def advance(self):
+        r = self.r
+        n = math.sqrt(r.dir.x * r.dir.x + r.dir.y * r.dir.y)
+        r.dir = Vector((1.0 / n) * r.dir.x, (1.0 / n) * r.dir.y)
+        if self.on_corner:
+            self.on_corner = False
+            ray_to_grid(r, True)
+        elif ray_to_next_cell(r):
+            ray_to_grid(r, True)
+            return True
+
+        self.on_corner = ray_to_next_cell(r)
+        return not self.on_corner
+
+
+#############################################################################
+# The precomputation formerly in los.cc
+
+def rdist(c):
+    return max(abs(c[0]), abs(c[1]))
+
+
+def sqabs(c):
+    return c[0] * c[0] + c[1] * c[1]
+
+
+class RayTables(object):
+    def __init__(self, radius):
+        self.radius = radius
+        self.size = radius + 1
+        self.fullrays = []     # (Ray, start, length)
+        self.ray_coords = []
+
+    def footprint(self, r):
+        cs = []
+        ray = RayDef(r.copy())
+        while True:
+            if not ray.advance():
+                return []
+            c = ray.pos()
+            if rdist(c) > self.radius:
+                return cs
+            cs.append(c)
+
+    def register_ray(self, x0, y0, xd, yd):
+        r = Ray(x0, y0, xd, yd)
+        coords = self.footprint(r)
+        if not coords:
+            return
+        for (_, start, length) in self.fullrays:
+            if self.ray_coords[start:start + length] == coords:
+                return
+        self.fullrays.append((r, len(self.ray_coords), len(coords)))
+        self.ray_coords.extend(coords)
+
+    def raycast(self):
+        # register perpendiculars FIRST, to make them top choice
+        # when selecting beams
+        self.register_ray(0.5, 0.5, 0.0, 1.0)
+        self.register_ray(0.5, 0.5, 1.0, 0.0)
+
+        max_angle = 2 * self.radius - 2
+        xyangles = []
+        for xangle in range(1, max_angle + 1):
+            for yangle in range(1, max_angle + 1):
+                if gcd(xangle, yangle) == 1:
+                    xyangles.append((xangle, yangle))
+        xyangles = complexity_sort(xyangles)
+
+        for (xangle, yangle) in xyangles:
+            for intercept in range(1, LOS_INTERCEPT_MULT * yangle):
+                xstart = float(intercept) / (LOS_INTERCEPT_MULT * yangle)
+                ystart = 0.5
+                self.register_ray(xstart, ystart, float(xangle),
+                                  float(yangle))
+                # also draw the identical ray in octant 2
+                self.register_ray(ystart, xstart, float(yangle),
+                                  float(xangle))
+
+    def compare_cellrays(self, a, b):
+        """Is cellray a (-1) a subray or (1) a superray of b, or neither (0)?
+        A cellray is (fullray index, relative end index)."""
+        cura = self.fullrays[a[0]][1]
+        curb = self.fullrays[b[0]][1]
+        enda = cura + a[1]
+        endb = curb + b[1]
+        if self.ray_coords[enda] != self.ray_coords[endb]:
+            return 0
+        maybe_sub = True
+        maybe_super = True
+        while cura < enda and curb < endb and (maybe_sub or maybe_super):
+            pa = self.ray_coords[cura]
+            pb = self.ray_coords[curb]
+            if pa[0] > pb[0] or pa[1] > pb[1]:
+                maybe_super = False
+                curb += 1
+            if pa[0] < pb[0] or pa[1] < pb[1]:
+                maybe_sub = False
+                cura += 1
+            if pa == pb:
+                cura += 1
+                curb += 1
+        if maybe_sub and cura == enda:
+            return -1
+        if maybe_super and curb == endb:
+            return 1
+        return 0
+
+    def imbalance(self, cellray):
+        r, start, _ = self.fullrays[cellray[0]]
+        target = self.ray_coords[start + cellray[1]]
+        ray = RayDef(r.copy())
+        imb = diags = straights = 0
+        while ray.pos() != target:
+            old = ray.pos()
+            ray.advance()
+            new = ray.pos()
+            step = sqabs((new[0] - old[0], new[1] - old[1]))
+            if step == 1:
+                diags = 0
+                straights += 1
+                imb = max(imb, straights)
+            elif step == 2:
+                straights = 0
+                diags += 1
+                imb = max(imb, diags)
+            else:
+                raise ValueError("ray imbalance out of range")
+        return imb
+
+    def find_minimal_cellrays(self):
+        """The minimal cellrays, by end cell and best first, as (fullray
+        index, relative end index)."""
+        minima = {}
+        for (ri, (_, start, length)) in enumerate(self.fullrays):
+            for i in range(length):
+                c = (ri, i)
+                mins = minima.setdefault(self.ray_coords[start + i], [])
+                dup = False
+                j = 0
+                while j < len(mins) and not dup:
+                    cmp = self.compare_cellrays(mins[j], c)
+                    if cmp == -1:
+                        dup = True
+                    elif cmp == 1:
+                        del mins[j]
+                    else:
+                        j += 1
+                if not dup:
+                    mins.append(c)
+
+        # find_ray prefers the least imbalanced rays, and then those
+        # starting diagonally; the sort must be stable like list::sort.
+        result = []
+        self.first_cellray = []
+        for y in range(self.size):
+            for x in range(self.size):
+                self.first_cellray.append(len(result))
+                mins = minima.get((x, y), [])
+                keys = [(self.imbalance(c),
+                         0 if sqabs(self.ray_coords[self.fullrays[c[0]][1]])
+                                == 2 else 1)
+                        for c in mins]
+                order = sorted(range(len(mins)), key=lambda k: keys[k])
+                result.extend(mins[k] for k in order)
+        self.first_cellray.append(len(result))
+        self.cellrays = result
+
+    def create_blockrays(self):
+        # Every cell of a full ray blocks all its longer cellrays.
+        index = {}
+        for (k, (ri, end)) in enumerate(self.cellrays):
+            index[self.fullrays[ri][1] + end] = k
+        self.words = (len(self.cellrays) + 63) // 64
+        self.blockrays = [[0] * self.words
+                          for _ in range(self.size * self.size)]
+        for (_, start, length) in self.fullrays:
+            for i in range(length):
+                x, y = self.ray_coords[start + i]
+                block = self.blockrays[y * self.size + x]
+                for j in range(i + 1, length):
+                    k = index.get(start + j)
+                    if k is not None:
+                        block[k // 64] |= 1 << (k % 64)
+
+
+def gcd(x, y):
+    while y != 0:
+        x, y = y, x % y
+    return x
+
+
+def complexity_sort(xyangles):
+    """Sort (x, y) angle pairs by x*y, leaving ties in the order that
+    libstdc++'s std::sort left them in when los.cc sorted them at startup;
+    the order decides which of several rays with the same footprint is
+    kept, and so where beams go beyond the LOS radius."""
+    a = list(xyangles)
+
+    def lt(p, q):
+        return p[0] * p[1] < q[0] * q[1]
+
+    def insertion_sort(first, last):
+        for i in range(first + 1, last):
+            val = a[i]
+            if lt(val, a[first]):
+                a[first + 1:i + 1] = a[first:i]
+                a[first] = val
+            else:
+                j = i
+                while lt(val, a[j - 1]):
+                    a[j] = a[j - 1]
+                    j -= 1
+                a[j] = val
+
+    def unguarded_insertion_sort(first, last):
+        for i in range(first, last):
+            val = a[i]
+            j = i
+            while lt(val, a[j - 1]):
+                a[j] = a[j - 1]
+                j -= 1
+            a[j] = val
+
+    def move_median_to_first(result, x, y, z):
+        if lt(a[x], a[y]):
+            if lt(a[y], a[z]):
+                m = y
+            elif lt(a[x], a[z]):
+                m = z
+            else:
+                m = x
+        elif lt(a[x], a[z]):
+            m = x
+        elif lt(a[y], a[z]):
+            m = z
+        else:
+            m = y
+        a[result], a[m] = a[m], a[result]
+
+    def unguarded_partition(first, last, pivot):
+        while True:
+            while lt(a[first], a[pivot]):
+                first += 1
+            last -= 1
+            while lt(a[pivot], a[last]):
+                last -= 1
+            if not first < last:
+                return first
+            a[first], a[last] = a[last], a[first]
+            first += 1
+
+    def heap_sort(first, last):
+        # Only reached for pathological inputs; ours isn't one.
+        raise ValueError("introsort depth limit reached")
+
+    def introsort_loop(first, last, depth_limit):
+        while last - first > 16:
+            if depth_limit == 0:
+                heap_sort(first, last)
+                return
+            depth_limit -= 1
+            mid = first + (last - first) // 2
+            move_median_to_first(first, first + 1, mid, last - 1)
+            cut = unguarded_partition(first + 1, last, first)
+            introsort_loop(cut, last, depth_limit)
+            last = cut
+
+    n = len(a)
+    if n > 1:
+        introsort_loop(0, n, 2 * (n.bit_length() - 1))
+        if n > 16:
+            insertion_sort(0, 16)
+            unguarded_insertion_sort(16, n)
+        else:
+            insertion_sort(0, n)
+    return a
+
+
+#############################################################################
+# Output
+
+def read_los_radius(defines_h):
+    with open(defines_h) as f:
+        for line in f:
+            m = re.match(r'\s*#define\s+LOS_RADIUS\s+(\d+)\b', line)
+            if m:
+                return int(m.group(1))
+    raise ValueError("Couldn't find LOS_RADIUS in %s" % defines_h)
+
+
+def write_header(t, out):
+    w = out.write
+    w("// Autogenerated by util/gen-los-rays.py, do not edit.\n")
+    w("//\n")
+    w("// The rays los.cc casts through the first quadrant; see the comments\n")
+    w("// there for the terminology.\n")
+    w("\n")
+    w("#pragma once\n")
+    w("\n")
+    w("#define LOS_RAYS_RANGE %d\n" % t.radius)
+    w("#define LOS_NUM_FULLRAYS %d\n" % len(t.fullrays))
+    w("#define LOS_NUM_CELLRAYS %d\n" % len(t.cellrays))
+    w("#define LOS_RAY_WORDS %d\n" % t.words)
+    w("\n")
+    w("// All unique (in terms of footprint) full rays, as a geom::ray,\n")
+    w("// with their footprint in los_ray_coords[start..start+length-1].\n")
+    w("struct los_fullray\n")
+    w("{\n")
+    w("    double x, y, dx, dy;\n")
+    w("    int start, length;\n")
+    w("};\n")
+    w("\n")
+    w("static const los_fullray los_fullrays[LOS_NUM_FULLRAYS] =\n")
+    w("{\n")
+    for (r, start, length) in t.fullrays:
+        w("    { %r, %r, %r, %r, %d, %d },\n"
+          % (r.start.x, r.start.y, r.dir.x, r.dir.y, start, length))
+    w("};\n")
+    w("\n")
+    w("static const int8_t los_ray_coords[%d][2] =\n" % len(t.ray_coords))
+    w("{\n")
+    for i in range(0, len(t.ray_coords), 8):
+        w("   " + "".join(" { %d, %d }," % c
+                          for c in t.ray_coords[i:i + 8]) + "\n")
+    w("};\n")
+    w("\n")
+    w("// The minimal cellrays, as a full ray and the index of the end cell\n")
+    w("// in its footprint. They are ordered by end cell, best first.\n")
+    w("struct los_cellray\n")
+    w("{\n")
+    w("    int ray, end;\n")
+    w("};\n")
+    w("\n")
+    w("static const los_cellray los_cellrays[LOS_NUM_CELLRAYS] =\n")
+    w("{\n")
+    for i in range(0, len(t.cellrays), 8):
+        w("   " + "".join(" { %d, %d }," % c
+                          for c in t.cellrays[i:i + 8]) + "\n")
+    w("};\n")
+    w("\n")
+    w("// The cellrays ending in the cell (x, y) are\n")
+    w("// los_first_cellray[y*%d + x] .. los_first_cellray[y*%d + x + 1] - 1.\n"
+      % (t.size, t.size))
+    w("static const int los_first_cellray[%d] =\n" % len(t.first_cellray))
+    w("{\n")
+    for i in range(0, len(t.first_cellray), 10):
+        w("   " + "".join(" %d," % n for n in t.first_cellray[i:i + 10])
+          + "\n")
+    w("};\n")
+    w("\n")
+    w("// For each cell (x, y) at index y*%d + x, the cellrays it blocks,\n"
+      % t.size)
+    w("// one bit per cellray.\n")
+    w("static const uint64_t los_blockrays[%d][LOS_RAY_WORDS] =\n"
+      % len(t.blockrays))
+    w("{\n")
+    for block in t.blockrays:
+        w("    {" + ",".join(" 0x%016xULL" % b for b in block) + " },\n")
+    w("};\n")
+    w("\n")
+    w("// Bit reversals of %d-bit rows, for mirroring quadrants.\n" % t.size)
+    w("static const uint16_t los_reversed_rows[%d] =\n" % (1 << t.size))
+    w("{\n")
+    rev = []
+    for row in range(1 << t.size):
+        rev.append(sum(1 << (t.size - 1 - x) for x in range(t.size)
+                       if row & (1 << x)))
+    for i in range(0, len(rev), 8):
+        w("   " + "".join(" 0x%04x," % n for n in rev[i:i + 8]) + "\n")
+    w("};\n")
+
+
+def main():
+    if len(sys.argv) != 3:
+        print("Usage: %s defines.h los-rays.h" % sys.argv[0],
+              file=sys.stderr)
+        sys.exit(1)
+
+    t = RayTables(read_los_radius(sys.argv[1]))
+    t.raycast()
+    t.find_minimal_cellrays()
+    t.create_blockrays()
+
+    with open(sys.argv[2], 'w') as out:
+        write_header(t, out)
+
+
+if __name__ == '__main__':
+    main()
@@ -123,11 +123,11 @@ static void _do_wizard_command(int wiz_command)
 
     // case 'n': break;
     // case 'N': break;
-    // case CONTROL('N'): break;
+    case CONTROL('N'): debug_builder_profile(); break;
 
     case 'o': wizard_create_spec_object(); break;
     case 'O': debug_test_explore(); break;
-    // case CONTROL('O'): break;
+    case CONTROL('O'): debug_los_stats(); break;
 
     case 'p': wizard_transform(); break;
     case 'P': debug_place_map(true); break;
@@ -443,6 +443,7 @@ int list_wizard_commands(bool do_redraw_screen)
                        "<w>{</w>      magic mapping\n"
                        "<w>Ctrl-W</w> change Shoals' tide speed\n"
                        "<w>Ctrl-E</w> dump level builder information\n"
+                       "<w>Ctrl-N</w> level builder time profile\n"
 #ifdef DEBUG
                        // might be present in any save, but only generated
                        // in debug builds; hide this for regular wizmode so as
@@ -498,6 +499,7 @@ int list_wizard_commands(bool do_redraw_screen)
                        "<w>Ctrl-F</w> double scale fsim\n"
                        "<w>Ctrl-I</w> item generation stats\n"
                        "<w>O</w>      measure exploration time\n"
+                       "<w>Ctrl-O</w> show LOS cache statistics\n"
                        "<w>Ctrl-T</w> dungeon (D)Lua interpreter\n"
                        "<w>Ctrl-U</w> client (C)Lua interpreter\n"
                        "<w>Ctrl-X</w> Xom effect stats\n"
@@ -63,15 +63,74 @@ namespace worley
        is 1.0. This makes an easy natural "scale" size of the cellular features. */
 #define DENSITY_ADJUSTMENT  0.398150
 
+    /* The feature points of one cube, with their positions already offset
+       by the cube's integer coordinates. The Poisson table never asks for
+       more than five. */
+    struct cube_points
+    {
+        int32_t xi, yi, zi;
+        int32_t count;
+        uint32_t id[5];
+        double x[5], y[5], z[5];
+    };
+
+    static void _cube_points(int32_t xi, int32_t yi, int32_t zi,
+                             cube_points &cube);
+
     /* the function to merge-sort a "cube" of samples into the current best-found
        list of values. */
-    static void AddSamples(int32_t xi, int32_t yi, int32_t zi, int32_t max_order,
+    template <class cube_source>
+    static void AddSamples(cube_source &cubes,
+            int32_t xi, int32_t yi, int32_t zi, int32_t max_order,
             double at[3], double *F,
             double (*delta)[3], uint32_t *ID);
 
+    /* Generates each cube's points as it's needed. */
+    struct cube_generator
+    {
+        cube_points cube;
+
+        const cube_points &operator()(int32_t xi, int32_t yi, int32_t zi)
+        {
+            _cube_points(xi, yi, zi, cube);
+            return cube;
+        }
+    };
+
+    /* Remembers recently used cubes, so that a batch of nearby samples
+       generates each cube's points only once. */
+    struct cube_cache
+    {
+        static const int size = 64;
+        cube_points cubes[size];
+        bool valid[size];
+
+        cube_cache()
+        {
+            for (int i = 0; i < size; ++i)
+                valid[i] = false;
+        }
+
+        const cube_points &operator()(int32_t xi, int32_t yi, int32_t zi)
+        {
+            const uint32_t slot = ((uint32_t) xi * 73856093U
+                                   ^ (uint32_t) yi * 19349663U
+                                   ^ (uint32_t) zi * 83492791U) % size;
+            cube_points &cube = cubes[slot];
+            if (!valid[slot] || cube.xi != xi || cube.yi != yi
+                || cube.zi != zi)
+            {
+                _cube_points(xi, yi, zi, cube);
+                valid[slot] = true;
+            }
+            return cube;
+        }
+    };
+
     /* The main function! */
+    template <class cube_source>
     static void _worley(double at[3], int32_t max_order,
-            double *F, double (*delta)[3], uint32_t *ID)
+            double *F, double (*delta)[3], uint32_t *ID, cube_source &cubes)
     {
         double x2,y2,z2, mx2, my2, mz2;
         double new_at[3];
@@ -98,7 +157,7 @@ namespace worley
            {
            int32_t ii, jj, kk;
            for (ii=-1; ii<=1; ii++) for (jj=-1; jj<=1; jj++) for (kk=-1; kk<=1; kk++)
-           AddSamples(int_at[0]+ii,int_at[1]+jj,int_at[2]+kk,
+           AddSamples(cubes, int_at[0]+ii,int_at[1]+jj,int_at[2]+kk,
            max_order, new_at, F, delta, ID);
            }
            But this wastes a lot of time working on cubes which are known to be
@@ -107,7 +166,7 @@ namespace worley
            speed of the algorithm. */
 
         /* Test the central cube for closest point(s). */
-        AddSamples(int_at[0], int_at[1], int_at[2], max_order, new_at, F, delta, ID);
+        AddSamples(cubes, int_at[0], int_at[1], int_at[2], max_order, new_at, F, delta, ID);
 
         /* We test if neighbor cubes are even POSSIBLE contributors by examining the
            combinations of the sum of the squared distances from the cube's lower
@@ -124,62 +183,62 @@ namespace worley
 
         /* Test 6 facing neighbors of center cube. These are closest and most
            likely to have a close feature point. */
-        if (x2<F[max_order-1])  AddSamples(int_at[0]-1, int_at[1]  , int_at[2]  ,
+        if (x2<F[max_order-1])  AddSamples(cubes, int_at[0]-1, int_at[1]  , int_at[2]  ,
                 max_order, new_at, F, delta, ID);
-        if (y2<F[max_order-1])  AddSamples(int_at[0]  , int_at[1]-1, int_at[2]  ,
+        if (y2<F[max_order-1])  AddSamples(cubes, int_at[0]  , int_at[1]-1, int_at[2]  ,
                 max_order, new_at, F, delta, ID);
-        if (z2<F[max_order-1])  AddSamples(int_at[0]  , int_at[1]  , int_at[2]-1,
+        if (z2<F[max_order-1])  AddSamples(cubes, int_at[0]  , int_at[1]  , int_at[2]-1,
                 max_order, new_at, F, delta, ID);
 
-        if (mx2<F[max_order-1]) AddSamples(int_at[0]+1, int_at[1]  , int_at[2]  ,
+        if (mx2<F[max_order-1]) AddSamples(cubes, int_at[0]+1, int_at[1]  , int_at[2]  ,
                 max_order, new_at, F, delta, ID);
-        if (my2<F[max_order-1]) AddSamples(int_at[0]  , int_at[1]+1, int_at[2]  ,
+        if (my2<F[max_order-1]) AddSamples(cubes, int_at[0]  , int_at[1]+1, int_at[2]  ,
                 max_order, new_at, F, delta, ID);
-        if (mz2<F[max_order-1]) AddSamples(int_at[0]  , int_at[1]  , int_at[2]+1,
+        if (mz2<F[max_order-1]) AddSamples(cubes, int_at[0]  , int_at[1]  , int_at[2]+1,
                 max_order, new_at, F, delta, ID);
 
         /* Test 12 "edge cube" neighbors if necessary. They're next closest. */
-        if ( x2+ y2<F[max_order-1]) AddSamples(int_at[0]-1, int_at[1]-1, int_at[2]  ,
+        if ( x2+ y2<F[max_order-1]) AddSamples(cubes, int_at[0]-1, int_at[1]-1, int_at[2]  ,
                 max_order, new_at, F, delta, ID);
-        if ( x2+ z2<F[max_order-1]) AddSamples(int_at[0]-1, int_at[1]  , int_at[2]-1,
+        if ( x2+ z2<F[max_order-1]) AddSamples(cubes, int_at[0]-1, int_at[1]  , int_at[2]-1,
                 max_order, new_at, F, delta, ID);
-        if ( y2+ z2<F[max_order-1]) AddSamples(int_at[0]  , int_at[1]-1, int_at[2]-1,
+        if ( y2+ z2<F[max_order-1]) AddSamples(cubes, int_at[0]  , int_at[1]-1, int_at[2]-1,
                 max_order, new_at, F, delta, ID);
-        if (mx2+my2<F[max_order-1]) AddSamples(int_at[0]+1, int_at[1]+1, int_at[2]  ,
+        if (mx2+my2<F[max_order-1]) AddSamples(cubes, int_at[0]+1, int_at[1]+1, int_at[2]  ,
                 max_order, new_at, F, delta, ID);
-        if (mx2+mz2<F[max_order-1]) AddSamples(int_at[0]+1, int_at[1]  , int_at[2]+1,
+        if (mx2+mz2<F[max_order-1]) AddSamples(cubes, int_at[0]+1, int_at[1]  , int_at[2]+1,
                 max_order, new_at, F, delta, ID);
-        if (my2+mz2<F[max_order-1]) AddSamples(int_at[0]  , int_at[1]+1, int_at[2]+1,
+        if (my2+mz2<F[max_order-1]) AddSamples(cubes, int_at[0]  , int_at[1]+1, int_at[2]+1,
                 max_order, new_at, F, delta, ID);
-        if ( x2+my2<F[max_order-1]) AddSamples(int_at[0]-1, int_at[1]+1, int_at[2]  ,
+        if ( x2+my2<F[max_order-1]) AddSamples(cubes, int_at[0]-1, int_at[1]+1, int_at[2]  ,
                 max_order, new_at, F, delta, ID);
-        if ( x2+mz2<F[max_order-1]) AddSamples(int_at[0]-1, int_at[1]  , int_at[2]+1,
+        if ( x2+mz2<F[max_order-1]) AddSamples(cubes, int_at[0]-1, int_at[1]  , int_at[2]+1,
                 max_order, new_at, F, delta, ID);
-        if ( y2+mz2<F[max_order-1]) AddSamples(int_at[0]  , int_at[1]-1, int_at[2]+1,
+        if ( y2+mz2<F[max_order-1]) AddSamples(cubes, int_at[0]  , int_at[1]-1, int_at[2]+1,
                 max_order, new_at, F, delta, ID);
-        if (mx2+ y2<F[max_order-1]) AddSamples(int_at[0]+1, int_at[1]-1, int_at[2]  ,
+        if (mx2+ y2<F[max_order-1]) AddSamples(cubes, int_at[0]+1, int_at[1]-1, int_at[2]  ,
                 max_order, new_at, F, delta, ID);
-        if (mx2+ z2<F[max_order-1]) AddSamples(int_at[0]+1, int_at[1]  , int_at[2]-1,
+        if (mx2+ z2<F[max_order-1]) AddSamples(cubes, int_at[0]+1, int_at[1]  , int_at[2]-1,
                 max_order, new_at, F, delta, ID);
-        if (my2+ z2<F[max_order-1]) AddSamples(int_at[0]  , int_at[1]+1, int_at[2]-1,
+        if (my2+ z2<F[max_order-1]) AddSamples(cubes, int_at[0]  , int_at[1]+1, int_at[2]-1,
                 max_order, new_at, F, delta, ID);
 
         /* Final 8 "corner" cubes */
-        if ( x2+ y2+ z2<F[max_order-1]) AddSamples(int_at[0]-1, int_at[1]-1, int_at[2]-1,
+        if ( x2+ y2+ z2<F[max_order-1]) AddSamples(cubes, int_at[0]-1, int_at[1]-1, int_at[2]-1,
                 max_order, new_at, F, delta, ID);
-        if ( x2+ y2+mz2<F[max_order-1]) AddSamples(int_at[0]-1, int_at[1]-1, int_at[2]+1,
+        if ( x2+ y2+mz2<F[max_order-1]) AddSamples(cubes, int_at[0]-1, int_at[1]-1, int_at[2]+1,
                 max_order, new_at, F, delta, ID);
-        if ( x2+my2+ z2<F[max_order-1]) AddSamples(int_at[0]-1, int_at[1]+1, int_at[2]-1,
+        if ( x2+my2+ z2<F[max_order-1]) AddSamples(cubes, int_at[0]-1, int_at[1]+1, int_at[2]-1,
                 max_order, new_at, F, delta, ID);
-        if ( x2+my2+mz2<F[max_order-1]) AddSamples(int_at[0]-1, int_at[1]+1, int_at[2]+1,
+        if ( x2+my2+mz2<F[max_order-1]) AddSamples(cubes, int_at[0]-1, int_at[1]+1, int_at[2]+1,
                 max_order, new_at, F, delta, ID);
-        if (mx2+ y2+ z2<F[max_order-1]) AddSamples(int_at[0]+1, int_at[1]-1, int_at[2]-1,
+        if (mx2+ y2+ z2<F[max_order-1]) AddSamples(cubes, int_at[0]+1, int_at[1]-1, int_at[2]-1,
                 max_order, new_at, F, delta, ID);
-        if (mx2+ y2+mz2<F[max_order-1]) AddSamples(int_at[0]+1, int_at[1]-1, int_at[2]+1,
+        if (mx2+ y2+mz2<F[max_order-1]) AddSamples(cubes, int_at[0]+1, int_at[1]-1, int_at[2]+1,
                 max_order, new_at, F, delta, ID);
-        if (mx2+my2+ z2<F[max_order-1]) AddSamples(int_at[0]+1, int_at[1]+1, int_at[2]-1,
+        if (mx2+my2+ z2<F[max_order-1]) AddSamples(cubes, int_at[0]+1, int_at[1]+1, int_at[2]-1,
                 max_order, new_at, F, delta, ID);
-        if (mx2+my2+mz2<F[max_order-1]) AddSamples(int_at[0]+1, int_at[1]+1, int_at[2]+1,
+        if (mx2+my2+mz2<F[max_order-1]) AddSamples(cubes, int_at[0]+1, int_at[1]+1, int_at[2]+1,
                 max_order, new_at, F, delta, ID);
 
         /* We're done! Convert everything to right size scale */
@@ -194,13 +253,12 @@ namespace worley
         return;
     }
 
-    static void AddSamples(int32_t xi, int32_t yi, int32_t zi, int32_t max_order,
-            double at[3], double *F,
-            double (*delta)[3], uint32_t *ID)
+    static void _cube_points(int32_t xi, int32_t yi, int32_t zi,
+                             cube_points &cube)
     {
-        double dx, dy, dz, fx, fy, fz, d2;
-        int32_t count, i, j, index;
-        uint32_t seed, this_id;
+        double fx, fy, fz;
+        int32_t count, j;
+        uint32_t seed;
 
         /* Each cube has a random number seed based on the cube's ID number.
            The seed might be better if it were a nonlinear hash like Perlin uses
@@ -213,9 +271,13 @@ namespace worley
 
         seed=1402024253*seed+586950981; /* churn the seed with good Knuth LCG */
 
-        for (j=0; j<count; j++) /* test and insert each point into our solution */
+        cube.xi = xi;
+        cube.yi = yi;
+        cube.zi = zi;
+        cube.count = count;
+        for (j=0; j<count; j++)
         {
-            this_id=seed;
+            cube.id[j]=seed;
             seed=1402024253*seed+586950981; /* churn */
 
             /* compute the 0..1 feature point location's XYZ */
@@ -226,10 +288,31 @@ namespace worley
             fz=(seed+0.5)*(1.0/4294967296.0);
             seed=1402024253*seed+586950981; /* churn */
 
+            cube.x[j]=xi+fx;
+            cube.y[j]=yi+fy;
+            cube.z[j]=zi+fz;
+        }
+    }
+
+    template <class cube_source>
+    static void AddSamples(cube_source &cubes,
+            int32_t xi, int32_t yi, int32_t zi, int32_t max_order,
+            double at[3], double *F,
+            double (*delta)[3], uint32_t *ID)
+    {
+        double dx, dy, dz, d2;
+        int32_t i, j, index;
+        uint32_t this_id;
+        const cube_points &cube = cubes(xi, yi, zi);
+
+        for (j=0; j<cube.count; j++) /* test and insert each point into our solution */
+        {
+            this_id=cube.id[j];
+
             /* delta from feature point to sample location */
-            dx=xi+fx-at[0];
-            dy=yi+fy-at[1];
-            dz=zi+fz-at[2];
+            dx=cube.x[j]-at[0];
+            dy=cube.y[j]-at[1];
+            dz=cube.z[j]-at[2];
 
             /* Distance computation!  Lots of interesting variations are
                possible here!
@@ -281,14 +364,16 @@ cases.]
         return;
     }
 
-    noise_datum noise(double x, double y, double z)
+    template <class cube_source>
+    static noise_datum _noise(double x, double y, double z,
+                              cube_source &cubes)
     {
         double point[3] = {x,y,z};
         double F[2];
         double delta[2][3];
         uint32_t id[2];
 
-        _worley(point, 2, F, delta, id);
+        _worley(point, 2, F, delta, id, cubes);
 
         noise_datum datum;
         datum.distance[0] = F[0];
@@ -300,4 +385,18 @@ cases.]
                 datum.pos[i][j] = delta[i][j];
         return datum;
     }
+
+    noise_datum noise(double x, double y, double z)
+    {
+        cube_generator cubes;
+        return _noise(x, y, z, cubes);
+    }
+
+    void noise(const double *x, const double *y, const double *z, size_t n,
+               noise_datum *out)
+    {
+        cube_cache cubes;
+        for (size_t i = 0; i < n; ++i)
+            out[i] = _noise(x[i], y[i], z[i], cubes);
+    }
 }
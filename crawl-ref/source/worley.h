@@ -68,4 +68,9 @@ struct noise_datum
 };
 
 noise_datum noise(double x, double y, double z);
+// Samples n points at once, giving exactly what noise() gives for each.
+// Nearby points share the feature points of the cubes around them, so
+// batches of neighbouring samples are cheaper.
+void noise(const double *x, const double *y, const double *z, size_t n,
+           noise_datum *out);
 }
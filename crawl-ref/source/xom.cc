@@ -1561,6 +1561,7 @@ static void _xom_place_altars()
             && grd(place) == DNGN_FLOOR)
         {
             grd(place) = DNGN_ALTAR_XOM;
+            set_terrain_changed(place);
             success = true;
         }
     }